@@ -0,0 +1,96 @@
+/**
+ * @brief Throughput benchmark for the log file outputs. Writes the same
+ * messages through the buffered ofstream (Set_log_file) under several flush
+ * policies and through the memory-mapped rotating file
+ * (Set_rotating_log_file), and reports messages per second
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <sno/logger.h>
+#include <sno/stopwatch.h>
+
+namespace
+{
+
+const int NUM_MESSAGES = 500000;
+
+double log_messages()
+{
+  so::Stopwatch sw;
+  sw.Start();
+  for(int i = 0; i < NUM_MESSAGES; i++)
+  {
+    Log_msg(so::Logger::Info) << "message " << i << " value " << 0.5 * i;
+  }
+  so::Logger::Flush();
+  return sw.Stop();
+}
+
+/**
+ * @brief Delete every segment file of a rotating log. Numbering continues
+ * across runs, so the indices in use are found by listing the directory
+ */
+void remove_segments(const std::string& dir, const std::string& name)
+{
+  std::string prefix = name + ".";
+  DIR* d = opendir(dir.c_str());
+  if(!d)
+  {
+    return;
+  }
+  while(struct dirent* entry = readdir(d))
+  {
+    std::string file(entry->d_name);
+    if(file.size() > prefix.size() && !file.compare(0, prefix.size(), prefix)
+       && file.find_first_not_of("0123456789", prefix.size()) == std::string::npos)
+    {
+      remove((dir + "/" + file).c_str());
+    }
+  }
+  closedir(d);
+}
+
+void report(const std::string& name, const double seconds)
+{
+  std::cout << name << ": " << NUM_MESSAGES / seconds << " messages/s, "
+            << seconds / NUM_MESSAGES * 1e9 << " ns/message" << std::endl;
+}
+
+} // Anonymous namespace
+
+int main(int argc, char** argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string file = dir + "/sno_log_file_bench.log";
+  std::string segments_name = "sno_log_file_bench.seg";
+  std::string segments = dir + "/" + segments_name;
+
+  struct Policy
+  {
+    const char* name;
+    so::Logger::Flush_policy policy;
+  };
+  for(const Policy& p : {Policy{"ofstream, flush always", so::Logger::Flush_always},
+                         Policy{"ofstream, flush every 64", so::Logger::Flush_every_n},
+                         Policy{"ofstream, flush explicit", so::Logger::Flush_explicit}})
+  {
+    remove(file.c_str());
+    so::Logger::Set_log_file(file);
+    so::Logger::Set_flush_policy(p.policy);
+    report(p.name, log_messages());
+  }
+
+  so::Logger::Set_flush_policy(so::Logger::Flush_always);
+  remove_segments(dir, segments_name);
+  so::Logger::Set_rotating_log_file(segments, 16 << 20, 2);
+  report("mmap rotating, flush always", log_messages());
+
+  // Close the segments, then clean up
+  so::Logger::Set_log_file(file);
+  remove(file.c_str());
+  remove_segments(dir, segments_name);
+  return 0;
+}
@@ -0,0 +1,320 @@
+/**
+ * @brief Throughput and latency benchmark for so::Basic_logger under
+ * contention. Logs from 1 to 64 threads at once with several message sizes,
+ * with the level enabled and disabled, to stdout, to the log file and to an
+ * alternate file, both writing directly and through the background writer
+ * (Start_async), and to the binary log (Set_binary_file). For each run it
+ * reports messages per second over all threads, the p50/p99/p999/max latency
+ * of a single log statement and, for the file outputs, the bytes written per
+ * message.
+ *
+ * Results are written as JSON to a file so that the stdout runs can be sent
+ * to /dev/null or a terminal:
+ *   logger_bench [dir] [json_file] [messages_per_run] > /dev/null
+ * Progress is printed to stderr.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <sno/logger.h>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+const int THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32, 64};
+
+/**
+ * @brief Message payload sizes, characters
+ */
+const size_t MESSAGE_SIZES[] = {16, 128, 1024};
+
+/**
+ * @brief Settings for one run
+ */
+struct Run
+{
+  std::string output;   ///< stdout, file, alternate_file or binary
+  bool async;           ///< Through the background writer
+  bool enabled;         ///< Level passes the logging mask
+  int threads;
+  size_t message_size;
+  size_t messages;      ///< Over all threads
+};
+
+/**
+ * @brief Measurements of one run
+ */
+struct Result
+{
+  size_t messages;      ///< Actually logged, a multiple of the thread count
+  double seconds;
+  double p50;
+  double p99;
+  double p999;
+  double max;
+  double bytes_per_message; ///< 0 for stdout
+};
+
+/**
+ * @brief Get the size of a file
+ * @return Size in bytes, 0 if the file does not exist
+ */
+double file_size(const std::string& file)
+{
+  struct stat st;
+  return stat(file.c_str(), &st) == 0 ? static_cast<double>(st.st_size) : 0.0;
+}
+
+int64_t to_ns(const Clock::duration d)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+/**
+ * @brief Measure the cost of reading the clock, which is included in every
+ * latency sample
+ * @return Median cost, nanoseconds
+ */
+double timer_overhead()
+{
+  std::vector<int64_t> samples(100000);
+  for(int64_t& sample : samples)
+  {
+    Clock::time_point start = Clock::now();
+    sample = to_ns(Clock::now() - start);
+  }
+  std::nth_element(samples.begin(),
+                   samples.begin() + samples.size() / 2,
+                   samples.end());
+  return static_cast<double>(samples[samples.size() / 2]);
+}
+
+/**
+ * @brief Get a percentile of sorted samples
+ */
+double percentile(const std::vector<int64_t>& sorted, const double p)
+{
+  size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return static_cast<double>(sorted[std::min(i, sorted.size() - 1)]);
+}
+
+/**
+ * @brief Log from every thread at once and time each statement
+ * @param run Settings
+ * @param alternate_file File used when run.output is alternate_file
+ */
+Result measure(const Run& run, const std::string& alternate_file)
+{
+  const std::string payload(run.message_size, 'x');
+  const so::Logger::Log_level level =
+      run.enabled ? so::Logger::Info : so::Logger::Debug_3;
+  const bool alternate = run.output == "alternate_file";
+  const size_t per_thread = std::max<size_t>(run.messages / run.threads, 1);
+
+  if(run.async)
+  {
+    so::Logger::Start_async();
+  }
+
+  std::vector<std::vector<int64_t> > latencies(run.threads);
+  boost::atomic<int> ready(0);
+  boost::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < run.threads; t++)
+  {
+    threads.emplace_back([&, t]()
+    {
+      std::vector<int64_t>& samples = latencies[t];
+      samples.reserve(per_thread);
+      ready.fetch_add(1);
+      while(!go.load(boost::memory_order_acquire))
+      {
+        std::this_thread::yield();
+      }
+      for(size_t i = 0; i < per_thread; i++)
+      {
+        Clock::time_point start = Clock::now();
+        if(alternate)
+        {
+          Log_msg(level, alternate_file) << "message " << i << ' ' << payload;
+        }
+        else
+        {
+          Log_msg(level) << "message " << i << ' ' << payload;
+        }
+        samples.push_back(to_ns(Clock::now() - start));
+      }
+    });
+  }
+  while(ready.load() < run.threads)
+  {
+    std::this_thread::yield();
+  }
+
+  Clock::time_point start = Clock::now();
+  go.store(true, boost::memory_order_release);
+  for(std::thread& thread : threads)
+  {
+    thread.join();
+  }
+  // Messages only count once they have been written
+  so::Logger::Flush();
+  Result result;
+  result.messages = per_thread * run.threads;
+  result.seconds = to_ns(Clock::now() - start) * 1e-9;
+  if(run.async)
+  {
+    so::Logger::Stop_async();
+  }
+
+  std::vector<int64_t> all;
+  all.reserve(per_thread * run.threads);
+  for(const std::vector<int64_t>& samples : latencies)
+  {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  std::sort(all.begin(), all.end());
+  result.p50 = percentile(all, 0.5);
+  result.p99 = percentile(all, 0.99);
+  result.p999 = percentile(all, 0.999);
+  result.max = static_cast<double>(all.back());
+  return result;
+}
+
+/**
+ * @brief Write one run as a JSON object
+ */
+void write_json(std::ostream& out, const Run& run, const Result& result)
+{
+  out << "    {\"output\": \"" << run.output << "\""
+      << ", \"mode\": \"" << (run.async ? "async" : "sync") << "\""
+      << ", \"level\": \"" << (run.enabled ? "enabled" : "disabled") << "\""
+      << ", \"threads\": " << run.threads
+      << ", \"message_size\": " << run.message_size
+      << ", \"messages\": " << result.messages
+      << ", \"seconds\": " << result.seconds
+      << ", \"messages_per_second\": " << result.messages / result.seconds
+      << ", \"p50_ns\": " << result.p50
+      << ", \"p99_ns\": " << result.p99
+      << ", \"p999_ns\": " << result.p999
+      << ", \"max_ns\": " << result.max
+      << ", \"bytes_per_message\": " << result.bytes_per_message << "}";
+}
+
+} // Anonymous namespace
+
+int main(int argc, char** argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string json_file = argc > 2 ? argv[2] : dir + "/sno_logger_bench.json";
+  size_t messages = argc > 3 ? std::stoul(argv[3]) : 100000;
+  std::string log_file = dir + "/sno_logger_bench.log";
+  std::string alternate_file = dir + "/sno_logger_bench_alt.log";
+  std::string binary_file = dir + "/sno_logger_bench.bin";
+
+  std::vector<Run> runs;
+  // The logger writes to stdout until Set_log_file() is called, so the stdout
+  // runs go first
+  for(const char* output : {"stdout", "file", "alternate_file"})
+  {
+    for(bool async : {false, true})
+    {
+      for(int threads : THREAD_COUNTS)
+      {
+        for(size_t size : MESSAGE_SIZES)
+        {
+          runs.push_back(Run{output, async, true, threads, size, messages});
+        }
+      }
+    }
+  }
+  // The binary log has no background writer mode of its own: formatting is
+  // already deferred to the decoder
+  for(int threads : THREAD_COUNTS)
+  {
+    for(size_t size : MESSAGE_SIZES)
+    {
+      runs.push_back(Run{"binary", false, true, threads, size, messages});
+    }
+  }
+  // A disabled statement never reaches an output, so once is enough
+  for(int threads : THREAD_COUNTS)
+  {
+    runs.push_back(Run{"file", false, false, threads, MESSAGE_SIZES[0],
+                       messages * 10});
+  }
+
+  std::ofstream json(json_file);
+  if(!json)
+  {
+    std::cerr << "Could not open " << json_file << std::endl;
+    return 1;
+  }
+  json << "{\n  \"benchmark\": \"so::Logger\",\n"
+       << "  \"hardware_threads\": " << std::thread::hardware_concurrency()
+       << ",\n  \"timer_overhead_ns\": " << timer_overhead()
+       << ",\n  \"results\": [\n";
+
+  so::Logger::Set_logging_level(so::Logger::Info);
+  for(size_t i = 0; i < runs.size(); i++)
+  {
+    const Run& run = runs[i];
+    if(run.output != "stdout" && (i == 0 || runs[i - 1].output == "stdout"))
+    {
+      remove(log_file.c_str());
+      so::Logger::Set_log_file(log_file);
+    }
+    if(run.output == "binary")
+    {
+      so::Logger::Set_binary_file(binary_file);
+    }
+    else if(i > 0 && runs[i - 1].output == "binary")
+    {
+      so::Logger::Close_binary_file();
+    }
+    Result result = measure(run, alternate_file);
+    const std::string& written = run.output == "binary" ? binary_file
+        : run.output == "alternate_file" ? alternate_file : log_file;
+    result.bytes_per_message = run.output == "stdout" || !run.enabled
+        ? 0.0 : file_size(written) / result.messages;
+    // Both files are opened for appending, so emptying them between runs
+    // keeps the disk from filling up without reopening them
+    if(truncate(log_file.c_str(), 0) != 0 && run.output != "stdout")
+    {
+      std::cerr << "Could not empty " << log_file << std::endl;
+    }
+    if(truncate(alternate_file.c_str(), 0) != 0 && run.output == "alternate_file")
+    {
+      std::cerr << "Could not empty " << alternate_file << std::endl;
+    }
+    write_json(json, run, result);
+    json << (i + 1 < runs.size() ? ",\n" : "\n");
+
+    std::cerr << run.output << (run.async ? " async" : " sync")
+              << (run.enabled ? "" : " disabled")
+              << ", " << run.threads << " threads, " << run.message_size
+              << " chars: " << result.messages / result.seconds << " messages/s, p50 "
+              << result.p50 << " ns, p99 " << result.p99 << " ns, p999 "
+              << result.p999 << " ns, " << result.bytes_per_message
+              << " bytes/message" << std::endl;
+  }
+  json << "  ]\n}\n";
+
+  so::Logger::Close_binary_file();
+  remove(log_file.c_str());
+  remove(alternate_file.c_str());
+  remove(binary_file.c_str());
+  return 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * @brief Overhead benchmark for so::Profile_zone. Times empty zones declared
+ * with SO_PROFILE_ZONE, nested zones and zones looked up by name, and reports
+ * the cost per zone. Build with -DSO_PROFILE=0 to see the cost of the
+ * compiled-out macro
+ */
+
+#include <stdint.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sno/profiler.h>
+#include <sno/stopwatch.h>
+
+namespace
+{
+
+const int NUM_ZONES = 1000000;
+
+/**
+ * @brief Print one measurement
+ * @param name Name of the measurement
+ * @param zones Number of zones timed
+ * @param seconds Time taken
+ */
+void report(const std::string& name, const int zones, const double seconds)
+{
+  std::cout << std::left << std::setw(32) << name << std::right
+            << std::setw(10) << std::setprecision(3) << std::fixed
+            << seconds / zones * 1e9 << " ns/zone" << std::endl;
+}
+
+} // Anonymous namespace
+
+int main()
+{
+  // Every event fits, so each zone is fully recorded
+  so::Profiler::Set_buffer_size(4 * NUM_ZONES);
+  so::Stopwatch sw(so::Stopwatch::Tsc);
+
+  sw.Start();
+  for(int i = 0; i < NUM_ZONES; i++)
+  {
+    SO_PROFILE_ZONE("empty");
+  }
+  report("SO_PROFILE_ZONE", NUM_ZONES, sw.Stop());
+
+  sw.Start();
+  for(int i = 0; i < NUM_ZONES / 2; i++)
+  {
+    SO_PROFILE_ZONE("outer");
+    SO_PROFILE_ZONE("inner");
+  }
+  report("SO_PROFILE_ZONE, nested pair", NUM_ZONES, sw.Stop());
+
+  sw.Start();
+  for(int i = 0; i < NUM_ZONES; i++)
+  {
+    so::Profile_zone zone("by name");
+  }
+  report("Profile_zone(name)", NUM_ZONES, sw.Stop());
+
+  std::cout << "SO_PROFILE=" << SO_PROFILE << ", "
+            << so::Profiler::Get_stats().size() << " zones recorded"
+            << std::endl;
+  return 0;
+}
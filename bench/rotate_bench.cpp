@@ -0,0 +1,239 @@
+/**
+ * @brief Throughput benchmark for so::Rotate. Transforms point clouds of
+ * varying size from body to earth frame through each of the available paths
+ * and reports points/s and ns/point. The batch API is measured both on
+ * points stored as [x, y, z] columns (AoS) and on separate x, y and z arrays
+ * (SoA). The threaded case splits the AoS batch API
+ * calls over a pool of threads started once, so that thread creation is not
+ * part of the measurement
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sno/rotate.h>
+#include <sno/stopwatch.h>
+
+namespace
+{
+
+/**
+ * @brief Minimum time to spend repeating each measurement, seconds
+ */
+const double MIN_RUN_TIME = 0.2;
+
+/**
+ * @brief Run a function until at least MIN_RUN_TIME has elapsed and print
+ * the throughput
+ * @param name Name of the measurement
+ * @param points Number of points transformed per call of func
+ * @param func Function to time
+ */
+void run(const std::string& name,
+         const Eigen::Index points,
+         const std::function<void()>& func)
+{
+  size_t calls = 0;
+  so::Stopwatch sw;
+  sw.Start();
+  do
+  {
+    func();
+    calls++;
+  } while(sw.Get_time() < MIN_RUN_TIME);
+  double seconds = sw.Stop();
+  double total = static_cast<double>(calls) * points;
+  std::cout << std::left << std::setw(24) << name
+            << std::right << std::setw(10) << points
+            << std::setw(16) << std::setprecision(4) << total / seconds
+            << " points/s"
+            << std::setw(12) << seconds / total * 1e9 << " ns/point"
+            << std::endl;
+}
+
+/**
+ * @brief Fixed set of threads that run one job split into as many parts as
+ * there are threads
+ */
+class Thread_pool
+{
+public:
+  explicit Thread_pool(const unsigned size)
+    :
+      m_mutex(),
+      m_wake(),
+      m_done(),
+      m_job(nullptr),
+      m_generation(0),
+      m_remaining(0),
+      m_running(true),
+      m_threads()
+  {
+    for(unsigned i = 0; i < size; i++)
+    {
+      m_threads.emplace_back(&Thread_pool::run, this, i);
+    }
+  }
+
+  ~Thread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+    }
+    m_wake.notify_all();
+    for(std::thread& t : m_threads)
+    {
+      t.join();
+    }
+  }
+
+  Thread_pool(const Thread_pool& other) = delete;
+  Thread_pool& operator=(const Thread_pool& other) = delete;
+
+  /**
+   * @brief Get the number of threads
+   */
+  unsigned Get_size() const
+  {
+    return static_cast<unsigned>(m_threads.size());
+  }
+
+  /**
+   * @brief Run job(part) on every thread, part = 0 .. Get_size() - 1, and
+   * wait for all of them
+   */
+  void Run(const std::function<void(unsigned)>& job)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_job = &job;
+    m_remaining = Get_size();
+    m_generation++;
+    m_wake.notify_all();
+    m_done.wait(lock, [this]() { return m_remaining == 0; });
+    m_job = nullptr;
+  }
+
+private:
+  void run(const unsigned part)
+  {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+      m_wake.wait(lock, [&]() { return !m_running || m_generation != seen; });
+      if(!m_running)
+      {
+        return;
+      }
+      seen = m_generation;
+      const std::function<void(unsigned)>& job = *m_job;
+      lock.unlock();
+      job(part);
+      lock.lock();
+      if(--m_remaining == 0)
+      {
+        m_done.notify_one();
+      }
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  const std::function<void(unsigned)>* m_job;
+  uint64_t m_generation;
+  unsigned m_remaining;
+  bool m_running;
+  std::vector<std::thread> m_threads;
+};
+
+} // Anonymous namespace
+
+int main()
+{
+  const Eigen::Vector3d attitude(5, -3, 120);
+  const Eigen::Quaterniond q = so::Rotate::euler_2_quat(attitude);
+  Thread_pool pool(std::max(1u, std::thread::hardware_concurrency()));
+
+  for(Eigen::Index n : {100, 10000, 1000000})
+  {
+    // AoS: [x, y, z] of each point contiguous
+    Eigen::Matrix3Xd aos = Eigen::Matrix3Xd::Random(3, n);
+    Eigen::Matrix3Xd aos_out(3, n);
+    // SoA: all x, then all y, then all z
+    Eigen::Matrix<double, Eigen::Dynamic, 3> soa = aos.transpose();
+    Eigen::Matrix<double, Eigen::Dynamic, 3> soa_out(n, 3);
+    Eigen::Matrix4Xd attitudes = so::Rotate::euler_2_quat(
+          Eigen::Matrix3Xd(attitude.replicate(1, n)));
+
+    run("scalar euler", n, [&]()
+    {
+      for(Eigen::Index i = 0; i < n; i++)
+      {
+        double x = aos(0, i);
+        double y = aos(1, i);
+        double z = aos(2, i);
+        so::Rotate::body_2_earth(x, y, z, attitude(0), attitude(1), attitude(2));
+        aos_out.col(i) << x, y, z;
+      }
+    });
+    run("single point quat", n, [&]()
+    {
+      for(Eigen::Index i = 0; i < n; i++)
+      {
+        aos_out.col(i) = so::Rotate::body_2_earth(Eigen::Vector3d(aos.col(i)), q);
+      }
+    });
+    run("batch per-point quat", n, [&]()
+    {
+      aos_out = so::Rotate::body_2_earth(aos, attitudes);
+    });
+    run("batch AoS", n, [&]()
+    {
+      aos_out = so::Rotate::body_2_earth(aos, q);
+    });
+    run("batch SoA", n, [&]()
+    {
+      so::Rotate::body_2_earth(soa.col(0).data(), soa.col(1).data(),
+                               soa.col(2).data(), static_cast<size_t>(n), q,
+                               soa_out.col(0).data(), soa_out.col(1).data(),
+                               soa_out.col(2).data());
+    });
+    run("batch AoS earth_2_body", n, [&]()
+    {
+      aos_out = so::Rotate::earth_2_body(aos, q);
+    });
+    run("batch SoA earth_2_body", n, [&]()
+    {
+      so::Rotate::earth_2_body(soa.col(0).data(), soa.col(1).data(),
+                               soa.col(2).data(), static_cast<size_t>(n), q,
+                               soa_out.col(0).data(), soa_out.col(1).data(),
+                               soa_out.col(2).data());
+    });
+    // Each thread passes its share of the points to the batch call
+    std::vector<Eigen::Matrix3Xd> parts(pool.Get_size());
+    Eigen::Index chunk = (n + pool.Get_size() - 1) / pool.Get_size();
+    for(unsigned i = 0; i < pool.Get_size(); i++)
+    {
+      Eigen::Index start = std::min<Eigen::Index>(i * chunk, n);
+      parts[i] = aos.middleCols(start, std::min(chunk, n - start));
+    }
+    run("batch AoS threaded", n, [&]()
+    {
+      pool.Run([&](const unsigned part)
+      {
+        Eigen::Index start = std::min<Eigen::Index>(part * chunk, n);
+        aos_out.middleCols(start, parts[part].cols()) =
+            so::Rotate::body_2_earth(parts[part], q);
+      });
+    });
+  }
+  return 0;
+}
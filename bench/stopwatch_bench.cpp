@@ -0,0 +1,90 @@
+/**
+ * @brief Overhead benchmark for so::Stopwatch, so::Basic_fast_stopwatch and
+ * so::Tsc_clock. Times an empty section many times with each stopwatch and
+ * clock source and reports the cost of a Start()/Stop_ns() pair and of a
+ * single clock read
+ */
+
+#include <stdint.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sno/fast_stopwatch.h>
+#include <sno/stopwatch.h>
+#include <sno/tsc_clock.h>
+
+namespace
+{
+
+const int NUM_CALLS = 2000000;
+
+/**
+ * @brief Print one measurement
+ * @param name Name of the measurement
+ * @param total_ns Time for NUM_CALLS calls
+ */
+void report(const std::string& name, const int64_t total_ns)
+{
+  std::cout << std::left << std::setw(40) << name << std::right
+            << std::setw(10) << std::setprecision(3) << std::fixed
+            << static_cast<double>(total_ns) / NUM_CALLS << " ns/call"
+            << std::endl;
+}
+
+/**
+ * @brief Time an empty section with a stopwatch
+ * @param name Name of the measurement
+ * @param sw Stopwatch to use
+ * @param total Stopwatch timing the whole run
+ */
+template<class W>
+void time_empty_section(const std::string& name, W& sw, so::Stopwatch& total)
+{
+  int64_t sum = 0;
+  total.Start();
+  for(int i = 0; i < NUM_CALLS; i++)
+  {
+    sw.Start();
+    sum += sw.Stop_ns();
+  }
+  report("Start/Stop_ns, " + name, total.Stop_ns());
+  std::cout << "  mean measured empty section: "
+            << static_cast<double>(sum) / NUM_CALLS << " ns" << std::endl;
+}
+
+} // Anonymous namespace
+
+int main()
+{
+  std::cout << "TSC " << (so::Tsc_clock::Is_tsc() ? "in use, " : "not available, ")
+            << so::Tsc_clock::Get_ticks_per_second() * 1e-9 << " GHz"
+            << std::endl;
+
+  so::Stopwatch total(so::Stopwatch::Tsc);
+  so::Stopwatch steady(so::Stopwatch::Steady);
+  so::Stopwatch tsc(so::Stopwatch::Tsc);
+  so::Fast_stopwatch fast_steady;
+  so::Fast_tsc_stopwatch fast_tsc;
+  time_empty_section("Stopwatch, Steady", steady, total);
+  time_empty_section("Stopwatch, Tsc", tsc, total);
+  time_empty_section("Fast_stopwatch", fast_steady, total);
+  time_empty_section("Fast_tsc_stopwatch", fast_tsc, total);
+
+  int64_t sum = 0;
+  total.Start();
+  for(int i = 0; i < NUM_CALLS; i++)
+  {
+    sum += so::Tsc_clock::Now();
+  }
+  report("Tsc_clock::Now", total.Stop_ns());
+
+  total.Start();
+  for(int i = 0; i < NUM_CALLS; i++)
+  {
+    sum += so::Tsc_clock::Now_serialized();
+  }
+  report("Tsc_clock::Now_serialized", total.Stop_ns());
+  return sum == 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * @brief Throughput benchmark for so::Strapdown. Integrates synthetic IMU data
+ * in blocks of varying size and reports samples per second
+ */
+
+#include <iostream>
+#include <sno/stopwatch.h>
+#include <sno/strapdown.h>
+
+int main()
+{
+  const double dt = 1.0 / 2000;
+  const Eigen::Index total_samples = 4000000;
+
+  // Gentle coning motion with level specific force
+  Eigen::Matrix3Xd gyro(3, total_samples);
+  Eigen::Matrix3Xd accel(3, total_samples);
+  for(Eigen::Index i = 0; i < total_samples; i++)
+  {
+    double t = i * dt;
+    gyro.col(i) << 0.1 * std::cos(t), 0.1 * std::sin(t), 0.01;
+    accel.col(i) << 0.01, -0.02, -9.80665;
+  }
+
+  for(Eigen::Index block : {1, 10, 100, 1000, 10000})
+  {
+    so::Strapdown strapdown(Eigen::Vector3d::Zero());
+    so::Stopwatch sw;
+    sw.Start();
+    for(Eigen::Index i = 0; i + block <= total_samples; i += block)
+    {
+      strapdown.Integrate(gyro.middleCols(i, block),
+                          accel.middleCols(i, block),
+                          dt);
+    }
+    double seconds = sw.Stop();
+    Eigen::Vector3d attitude = strapdown.Get_attitude();
+    std::cout << "block " << block << ": "
+              << total_samples / seconds << " samples/s, "
+              << seconds / total_samples * 1e9 << " ns/sample"
+              << " (heading " << attitude(2) << ")" << std::endl;
+  }
+  return 0;
+}
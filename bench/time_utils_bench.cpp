@@ -0,0 +1,94 @@
+/**
+ * @brief Throughput benchmark for the so::Time_utils unix time functions.
+ * Reports calls per second for each way of reading the wall clock, with
+ * std::time() for reference, and the cost of converting stamps with
+ * so::Time_utils::Clock_mapper
+ */
+
+#include <stdint.h>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sno/clock_mapper.h>
+#include <sno/stopwatch.h>
+#include <sno/time_utils.h>
+
+namespace
+{
+
+const int NUM_CALLS = 5000000;
+
+/**
+ * @brief Print one measurement
+ * @param name Name of the measurement
+ * @param total_ns Time for NUM_CALLS calls
+ */
+void report(const std::string& name, const int64_t total_ns)
+{
+  std::cout << std::left << std::setw(36) << name << std::right
+            << std::setw(10) << std::setprecision(2) << std::fixed
+            << static_cast<double>(total_ns) / NUM_CALLS << " ns/call"
+            << std::setw(14) << std::setprecision(1)
+            << NUM_CALLS * 1e3 / total_ns << " M calls/s" << std::endl;
+}
+
+/**
+ * @brief Call a clock function NUM_CALLS times and report it
+ * @param name Name of the measurement
+ * @param f Function to call
+ * @param sum Accumulates the results so the calls are not optimised away
+ */
+template<class F>
+void time_calls(const std::string& name, F f, double& sum)
+{
+  so::Stopwatch sw(so::Stopwatch::Tsc);
+  sw.Start();
+  for(int i = 0; i < NUM_CALLS; i++)
+  {
+    sum += f();
+  }
+  report(name, sw.Stop_ns());
+}
+
+} // Anonymous namespace
+
+int main()
+{
+  double sum = 0;
+  time_calls("std::time", []() { return std::time(nullptr); }, sum);
+  time_calls("Unix_time", so::Time_utils::Unix_time, sum);
+  time_calls("Unix_time_us", so::Time_utils::Unix_time_us, sum);
+  time_calls("Unix_time_ns", so::Time_utils::Unix_time_ns, sum);
+  time_calls("Cached_unix_time_ns, stopped",
+             so::Time_utils::Cached_unix_time_ns, sum);
+
+  so::Time_utils::Start_cached_time();
+  time_calls("Cached_unix_time_ns, 100 us period",
+             so::Time_utils::Cached_unix_time_ns, sum);
+  time_calls("Cached_unix_time_us, 100 us period",
+             so::Time_utils::Cached_unix_time_us, sum);
+  so::Time_utils::Stop_cached_time();
+
+  so::Time_utils::Clock_mapper monotonic(so::Time_utils::Clock_mapper::Monotonic);
+  so::Time_utils::Clock_mapper tsc(so::Time_utils::Clock_mapper::Tsc);
+  time_calls("Clock_mapper::Now_unix_ns, Monotonic",
+             [&monotonic]() { return monotonic.Now_unix_ns(); }, sum);
+  time_calls("Clock_mapper::Now_unix_ns, Tsc",
+             [&tsc]() { return tsc.Now_unix_ns(); }, sum);
+
+  // Converting stamps taken earlier, in batches of 64
+  std::vector<int64_t> raw(64), unix_ns(64);
+  for(size_t i = 0; i < raw.size(); i++)
+  {
+    raw[i] = tsc.Now_raw();
+  }
+  time_calls("Clock_mapper::To_unix_ns, 64 stamps",
+             [&]()
+             {
+               tsc.To_unix_ns(raw.data(), unix_ns.data(), raw.size());
+               return unix_ns[0];
+             }, sum);
+  return sum == 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * @brief Implementation of so::Mmap_log_file
+ */
+
+#ifndef SO_MMAP_LOG_FILE_IMPL_H
+#define SO_MMAP_LOG_FILE_IMPL_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace so
+{
+
+class Mmap_log_file_impl
+{
+public:
+  Mmap_log_file_impl(const std::string& path,
+                     const size_t segment_size,
+                     const size_t max_old_segments);
+
+  ~Mmap_log_file_impl();
+
+  char* Get_data() const;
+
+  size_t Get_size() const;
+
+  std::string Get_current_path() const;
+
+  bool Rotate(const size_t used);
+
+  void Close(const size_t used);
+
+private:
+  /**
+   * @brief A mapped segment file
+   */
+  struct Segment
+  {
+    uint64_t index;
+    int fd;
+    char* data;
+  };
+
+  /**
+   * @brief A full segment waiting to be unmapped and trimmed
+   */
+  struct Retired
+  {
+    Segment segment;
+    size_t used;
+  };
+
+  //Variables
+  /**
+   * @brief m_path Base file name
+   */
+  const std::string m_path;
+
+  /**
+   * @brief m_segment_size Bytes per segment
+   */
+  const size_t m_segment_size;
+
+  /**
+   * @brief m_max_old_segments Number of full segments kept
+   */
+  const size_t m_max_old_segments;
+
+  /**
+   * @brief m_current Segment being written. Writer only
+   */
+  Segment m_current;
+
+  /**
+   * @brief m_closed True once Close() has been called. Writer only
+   */
+  bool m_closed;
+
+  /**
+   * @brief m_old Indices of full segments still on disk, oldest first.
+   * Background thread only (until it has been joined)
+   */
+  std::deque<uint64_t> m_old;
+
+  /**
+   * @brief m_mutex Guards the members below
+   */
+  std::mutex m_mutex;
+
+  /**
+   * @brief m_cv Signalled when any of the members below changes
+   */
+  std::condition_variable m_cv;
+
+  /**
+   * @brief m_next Segment prepared for the next Rotate(), if m_next_ready
+   */
+  Segment m_next;
+
+  /**
+   * @brief m_next_ready True if m_next holds a prepared segment
+   */
+  bool m_next_ready;
+
+  /**
+   * @brief m_failed True if preparing a segment failed
+   */
+  bool m_failed;
+
+  /**
+   * @brief m_next_index Index of the next segment to prepare
+   */
+  uint64_t m_next_index;
+
+  /**
+   * @brief m_retired Full segments for the background thread to finish
+   */
+  std::vector<Retired> m_retired;
+
+  /**
+   * @brief m_running False once the background thread should exit
+   */
+  bool m_running;
+
+  /**
+   * @brief m_thread Background thread
+   */
+  std::thread m_thread;
+
+  //Functions
+  /**
+   * @brief Get the file name of a segment
+   */
+  std::string segment_path(const uint64_t index) const;
+
+  /**
+   * @brief Find segments left by earlier runs
+   * @return Their indices in ascending order
+   */
+  std::vector<uint64_t> find_segments() const;
+
+  /**
+   * @brief Create, preallocate and map a segment file
+   * @return False on failure
+   */
+  bool create_segment(const uint64_t index, Segment& segment) const;
+
+  /**
+   * @brief Unmap a segment, trim it to the bytes used and close it
+   */
+  void finish_segment(const Segment& segment, const size_t used) const;
+
+  /**
+   * @brief Finish a full segment and delete the oldest segments beyond
+   * m_max_old_segments
+   */
+  void retire_segment(const Retired& retired);
+
+  /**
+   * @brief Background thread main loop
+   */
+  void run();
+};
+
+} // namespace so
+
+#endif
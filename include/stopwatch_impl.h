@@ -4,7 +4,8 @@
 
 #ifndef SO_STOPWATCH_IMPL_H
 #define SO_STOPWATCH_IMPL_H
-#include <chrono>
+#include <stdint.h>
+#include <sno/stopwatch.h>
 
 namespace so
 {
@@ -12,12 +13,11 @@ namespace so
 class Stopwatch_impl
 {
 public:
-  typedef std::chrono::steady_clock Clock_type;
-
   /**
    * @brief Constructor, a new stopwatch
+   * @param source Clock to read
    */
-  Stopwatch_impl();
+  explicit Stopwatch_impl(const Stopwatch::Clock_source source);
 
   /**
    * @brief Start the stopwatch. Does nothing if the stopwatch is already
@@ -28,20 +28,17 @@ public:
   /**
    * @brief Stop the stopwatch but do not reset the elapsed time. Does nothing
    * if the stopwatch not running
-   * @return Elapsed time, seconds
-   * @throws so::runtime_exception if the number of microseconds in the
-   * current elapsed time cannot be represented by a double
+   * @return Elapsed time, nanoseconds
    */
-  double Stop();
+  int64_t Stop_ns();
 
   /**
    * @brief Take a split
-   * @return Number of seconds since the last split, or since the stopwatch was
-   * started if this is the first split. Returns 0 if the timer isn't running
-   * @throws so::runtime_exception if the number of microseconds in the
-   * current split cannot be represented by a double
+   * @return Number of nanoseconds since the last split, or since the
+   * stopwatch was started if this is the first split. Returns 0 if the timer
+   * isn't running
    */
-  double Split();
+  int64_t Split_ns();
 
   /**
    * @brief Reset the stopwatch
@@ -50,34 +47,68 @@ public:
 
   /**
    * @brief Get the current elapsed time since the stopwatch was started
-   * @return Current elapsed time since the stopwatch was started, seconds
-   * @throws so::runtime_exception if the number of microseconds in the
-   * current elapsed time cannot be represented by a double
+   * @return Current elapsed time since the stopwatch was started, nanoseconds
    */
-  double Get_time();
+  int64_t Get_time_ns();
+
+  /**
+   * @brief Check if the stopwatch is running
+   */
+  bool Is_running() const
+  {
+    return m_running;
+  }
 
 private:
 
   /**
-   * @brief m_start_time Time when the stopwatch started
+   * @brief m_source Clock to read
+   */
+  Stopwatch::Clock_source m_source;
+
+  /**
+   * @brief m_start_time Time when the stopwatch started, clock ticks
    */
-  std::chrono::time_point<Clock_type> m_start_time;
+  int64_t m_start_time;
 
   /**
-   * @brief m_last_split Time when the last split was taken
+   * @brief m_last_split Time when the last split was taken, clock ticks
    */
-  std::chrono::time_point<Clock_type> m_last_split;
+  int64_t m_last_split;
 
   /**
-   * @brief elapsed_time Last runtime of the stopwatch
+   * @brief elapsed_time Last runtime of the stopwatch, clock ticks
    */
-  double m_elapsed_time;
+  int64_t m_elapsed_time;
 
   /**
    * @brief m_running True if the stopwatch is running
    */
   bool m_running;
 
+  /**
+   * @brief Read the clock at the start of a timed section
+   * @return Clock ticks
+   */
+  int64_t now() const;
+
+  /**
+   * @brief Read the clock at the end of a timed section
+   * @return Clock ticks
+   */
+  int64_t now_serialized() const;
+
+  /**
+   * @brief Convert a difference between readings to nanoseconds
+   */
+  int64_t to_ns(const int64_t ticks) const;
+
+  /**
+   * @brief Check whether readings are Tsc_clock ticks. They are nanoseconds
+   * from the installed so::Clock if there is one
+   */
+  bool uses_tsc() const;
+
   /**
    * @brief update_elapsed_time Update the current elapsed time
    */
@@ -0,0 +1,260 @@
+/**
+ * @brief Implementation of so::Transform_graph
+ */
+
+#ifndef SO_TRANSFORM_GRAPH_IMPL_H
+#define SO_TRANSFORM_GRAPH_IMPL_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sno/transform_graph.h>
+
+namespace so
+{
+
+/**
+ * @class Seqlock_transform
+ * @brief A Rigid_transform guarded by a sequence lock. A single writer may
+ * store while any number of readers load; readers never block the writer and
+ * retry if they overlap a store
+ */
+class Seqlock_transform
+{
+public:
+  /**
+   * @brief Constructor, the identity transform at sequence 0
+   */
+  Seqlock_transform();
+
+  /**
+   * @brief Store a new transform. Only one thread may store at a time
+   * @param t New transform
+   * @param stamps Optional values to publish together with the transform
+   * @param num_stamps Number of stamps, must not exceed the size given to
+   * Resize_stamps()
+   */
+  void Store(const Rigid_transform& t,
+             const uint64_t* stamps = nullptr,
+             const size_t num_stamps = 0);
+
+  /**
+   * @brief Load a consistent copy of the transform
+   * @param t Populated with the transform
+   * @param stamps Optional, populated with the stamps stored with the
+   * transform
+   * @return Sequence number the transform was stored under, always even
+   */
+  uint64_t Load(Rigid_transform& t, uint64_t* stamps = nullptr) const;
+
+  /**
+   * @brief Get the current sequence number. Odd while a store is in progress
+   * @return Sequence number
+   */
+  uint64_t Get_sequence() const;
+
+  /**
+   * @brief Allocate space for stamps published with the transform. Not thread
+   * safe
+   * @param num_stamps Number of stamps
+   */
+  void Resize_stamps(const size_t num_stamps);
+
+private:
+  /**
+   * @brief m_seq Sequence number, incremented before and after each store
+   */
+  std::atomic<uint64_t> m_seq;
+
+  /**
+   * @brief m_values Rotation [w, x, y, z] followed by translation [x, y, z]
+   */
+  std::atomic<double> m_values[7];
+
+  /**
+   * @brief m_stamps Values published with the transform
+   */
+  std::unique_ptr<std::atomic<uint64_t>[]> m_stamps;
+
+  /**
+   * @brief m_num_stamps Number of stamps
+   */
+  size_t m_num_stamps;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+class Transform_graph_impl
+{
+public:
+  /**
+   * @brief Constructor, an empty graph
+   */
+  Transform_graph_impl();
+
+  /**
+   * @copydoc Transform_graph::Add_static_edge
+   */
+  void Add_static_edge(const std::string& child,
+                       const std::string& parent,
+                       const Rigid_transform& child_2_parent);
+
+  /**
+   * @copydoc Transform_graph::Add_dynamic_edge
+   */
+  size_t Add_dynamic_edge(const std::string& child, const std::string& parent);
+
+  /**
+   * @copydoc Transform_graph::Add_chain
+   */
+  size_t Add_chain(const std::string& source, const std::string& target);
+
+  /**
+   * @copydoc Transform_graph::Update_edge
+   */
+  void Update_edge(const size_t edge, const Rigid_transform& child_2_parent);
+
+  /**
+   * @copydoc Transform_graph::Lookup
+   */
+  Rigid_transform Lookup(const size_t chain) const;
+
+private:
+  /**
+   * @brief A frame and the edge to its parent
+   */
+  struct Frame
+  {
+    /**
+     * @brief Index of the parent frame, or -1 for a root frame
+     */
+    long parent;
+
+    /**
+     * @brief True if the edge to the parent is static
+     */
+    bool is_static;
+
+    /**
+     * @brief Transform to the parent for a static edge
+     */
+    Rigid_transform static_transform;
+
+    /**
+     * @brief Index into m_dynamic_edges for a dynamic edge
+     */
+    size_t dynamic_edge;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  /**
+   * @brief One step of a chain: either a precomposed run of static edges or
+   * a single dynamic edge, optionally inverted
+   */
+  struct Segment
+  {
+    /**
+     * @brief Dynamic edge, or nullptr for a static run
+     */
+    const Seqlock_transform* edge;
+
+    /**
+     * @brief True to apply the inverse of the dynamic edge
+     */
+    bool inverse;
+
+    /**
+     * @brief Precomposed transform of a static run
+     */
+    Rigid_transform constant;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  /**
+   * @brief A registered source->target composition and its cache
+   */
+  struct Chain
+  {
+    /**
+     * @brief Segments in the order they are applied
+     */
+    std::vector<Segment, Eigen::aligned_allocator<Segment> > segments;
+
+    /**
+     * @brief Number of dynamic segments
+     */
+    size_t num_dynamic;
+
+    /**
+     * @brief Last composition, stamped with the sequence numbers of the
+     * dynamic edges it was computed from
+     */
+    mutable Seqlock_transform cache;
+
+    /**
+     * @brief Set while a reader is refreshing the cache
+     */
+    mutable std::atomic_flag refreshing;
+  };
+
+  /**
+   * @brief m_frame_ids Frame indices by name
+   */
+  std::map<std::string, size_t> m_frame_ids;
+
+  /**
+   * @brief m_frames Frames, indexed by frame id
+   */
+  std::vector<Frame, Eigen::aligned_allocator<Frame> > m_frames;
+
+  /**
+   * @brief m_dynamic_edges Current transforms of the dynamic edges.
+   * Individually allocated so that their addresses are stable
+   */
+  std::vector<std::unique_ptr<Seqlock_transform> > m_dynamic_edges;
+
+  /**
+   * @brief m_chains Registered chains
+   */
+  std::vector<std::unique_ptr<Chain> > m_chains;
+
+  //Functions
+  /**
+   * @brief Get the index of a frame, creating it if it does not exist
+   * @param name Frame name
+   * @return Frame index
+   */
+  size_t get_or_add_frame(const std::string& name);
+
+  /**
+   * @brief Get the index of an existing frame
+   * @param name Frame name
+   * @return Frame index
+   * @throws so::Invalid_argument if the frame does not exist
+   */
+  size_t get_frame(const std::string& name) const;
+
+  /**
+   * @brief Create the child->parent link, checking the tree stays valid
+   * @return Child frame index
+   * @throws so::Invalid_argument if child already has a parent or the edge
+   * would create a cycle
+   */
+  size_t link(const std::string& child, const std::string& parent);
+
+  /**
+   * @brief Compose a chain from the current edge transforms
+   * @param chain Chain to compose
+   * @param stamps Populated with the sequence number of each dynamic edge
+   * @return Source->target transform
+   */
+  Rigid_transform compose(const Chain& chain, uint64_t* stamps) const;
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,296 @@
+/**
+ * @class Binary_log
+ * @brief Deferred-formatting binary log file for so::Basic_logger.
+ *
+ * While a binary log is open, log statements do not format their arguments.
+ * Each call site is registered once, and every message stores only the site
+ * id, level, a timestamp and the raw bytes of its arguments. Messages are
+ * copied into a lock-free buffer owned by the logging thread and a background
+ * thread writes the buffers to the file. Decode() (and the sno_log_decode
+ * tool) turns the file back into text.
+ *
+ * Arithmetic types, characters and strings are stored raw. Any other type is
+ * formatted with its operator<< when logged. Stream manipulators other than
+ * std::endl have no effect on binary messages.
+ *
+ * File layout (native byte order): an 8 byte magic string, then records of
+ * [uint8 type][uint32 record length][payload]. Site records hold
+ * [uint32 id][function signature]; message records hold [uint32 site id]
+ * [uint64 level][int64 Unix time, ns][arguments], each argument being a one
+ * byte tag followed by its value.
+ */
+
+#ifndef SO_BINARY_LOG_H
+#define SO_BINARY_LOG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <iosfwd>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+
+namespace so
+{
+
+class Binary_log
+{
+public:
+  /**
+   * @brief Record types
+   */
+  enum Record_type
+  {
+    Site_record    = 1,
+    Message_record = 2,
+  };
+
+  /**
+   * @brief Argument type tags
+   */
+  enum Tag
+  {
+    Tag_bool    = 0x01,
+    Tag_char    = 0x02,
+    Tag_wchar   = 0x03,
+    Tag_int     = 0x10, ///< | size in bytes
+    Tag_uint    = 0x20, ///< | size in bytes
+    Tag_float   = 0x34,
+    Tag_double  = 0x38,
+    Tag_string  = 0x40, ///< uint32 length, then bytes
+    Tag_wstring = 0x41, ///< uint32 length, then UTF-32 code units
+  };
+
+  /**
+   * @brief Open a binary log file and start the background writer. Closes
+   * any binary log that is already open
+   * @param filename File to write, truncated if it exists
+   * @param thread_buffer_size Size of each logging thread's buffer, bytes.
+   * Threads wait for the writer when their buffer is full
+   * @throws so::Write_error if the file cannot be opened
+   */
+  static void Open(const std::string& filename,
+                   const size_t thread_buffer_size = 1 << 20);
+
+  /**
+   * @brief Write everything buffered and close the file. Called
+   * automatically at exit
+   */
+  static void Close();
+
+  /**
+   * @brief Check whether a binary log is open
+   * @return True if messages should be written in binary
+   */
+  static bool Is_open()
+  {
+    return m_open.load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the number of times a binary log has been opened. Site ids
+   * are only valid for the file they were registered with
+   * @return Current generation
+   */
+  static uint32_t Get_generation()
+  {
+    return m_generation.load(boost::memory_order_acquire);
+  }
+
+  /**
+   * @brief Register a call site with the open file
+   * @param function Signature of the enclosing function
+   * @return Id for message records from this site, never 0
+   */
+  static uint32_t Register_site(const char* function);
+
+  /**
+   * @brief Start a message record
+   * @param out Record buffer, cleared first
+   * @param site Site id from Register_site(), or 0 for a message without a
+   * registered site, in which case the first argument should be the scope
+   * @param level Logging level of the message
+   * @param ns Unix time of the message, nanoseconds
+   */
+  static void Begin_message(std::vector<char>& out,
+                            const uint32_t site,
+                            const uint64_t level,
+                            const int64_t ns);
+
+  /**
+   * @brief Finish a record and hand it to the background writer
+   * @param out Record started with Begin_message()
+   */
+  static void Commit(std::vector<char>& out);
+
+  /**
+   * @brief Block until everything committed before the call is in the file
+   */
+  static void Flush();
+
+  /**
+   * @brief Get the number of records discarded because they were larger than
+   * a thread buffer or were committed while the log was closing or closed
+   * @return Number of dropped records
+   */
+  static uint64_t Get_dropped();
+
+  /**
+   * @brief Convert a binary log to text, one message per line, ordered by
+   * timestamp
+   * @param in Binary log
+   * @param out Destination for the text
+   * @throws so::Read_error if the input is not a binary log or is corrupt
+   */
+  static void Decode(std::istream& in, std::ostream& out);
+
+private:
+  /**
+   * @brief m_open True while a file is open
+   */
+  static boost::atomic<bool> m_open;
+
+  /**
+   * @brief m_generation Incremented each time a file is opened
+   */
+  static boost::atomic<uint32_t> m_generation;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Binary_encoder
+ * @brief Appends tagged arguments to a binary message record. C and T are the
+ * character type and traits used to format types that have no binary
+ * encoding
+ */
+template<typename C, typename T = std::char_traits<C> >
+struct Binary_encoder
+{
+  static void Put(std::vector<char>& out, const bool v)
+  {
+    put_value(out, Binary_log::Tag_bool, static_cast<uint8_t>(v));
+  }
+
+  static void Put(std::vector<char>& out, const char v)
+  {
+    put_value(out, Binary_log::Tag_char, v);
+  }
+
+  static void Put(std::vector<char>& out, const signed char v)
+  {
+    put_value(out, Binary_log::Tag_char, static_cast<char>(v));
+  }
+
+  static void Put(std::vector<char>& out, const unsigned char v)
+  {
+    put_value(out, Binary_log::Tag_char, static_cast<char>(v));
+  }
+
+  static void Put(std::vector<char>& out, const wchar_t v)
+  {
+    put_value(out, Binary_log::Tag_wchar, static_cast<uint32_t>(v));
+  }
+
+  static void Put(std::vector<char>& out, const short v) { put_int(out, v); }
+  static void Put(std::vector<char>& out, const unsigned short v) { put_int(out, v); }
+  static void Put(std::vector<char>& out, const int v) { put_int(out, v); }
+  static void Put(std::vector<char>& out, const unsigned int v) { put_int(out, v); }
+  static void Put(std::vector<char>& out, const long v) { put_int(out, v); }
+  static void Put(std::vector<char>& out, const unsigned long v) { put_int(out, v); }
+  static void Put(std::vector<char>& out, const long long v) { put_int(out, v); }
+  static void Put(std::vector<char>& out, const unsigned long long v) { put_int(out, v); }
+
+  static void Put(std::vector<char>& out, const float v)
+  {
+    put_value(out, Binary_log::Tag_float, v);
+  }
+
+  static void Put(std::vector<char>& out, const double v)
+  {
+    put_value(out, Binary_log::Tag_double, v);
+  }
+
+  static void Put(std::vector<char>& out, const long double v)
+  {
+    put_value(out, Binary_log::Tag_double, static_cast<double>(v));
+  }
+
+  static void Put(std::vector<char>& out, const char* v)
+  {
+    put_string(out, v, strlen(v));
+  }
+
+  static void Put(std::vector<char>& out, const std::string& v)
+  {
+    put_string(out, v.data(), v.size());
+  }
+
+  static void Put(std::vector<char>& out, const wchar_t* v)
+  {
+    put_wstring(out, v, wcslen(v));
+  }
+
+  static void Put(std::vector<char>& out, const std::wstring& v)
+  {
+    put_wstring(out, v.data(), v.size());
+  }
+
+  /**
+   * @brief Any other type is formatted now and stored as a string
+   */
+  template<class R>
+  static void Put(std::vector<char>& out, const R& v)
+  {
+    std::basic_ostringstream<C,T> ss;
+    ss << v;
+    Put(out, ss.str());
+  }
+
+private:
+  template<class V>
+  static void put_raw(std::vector<char>& out, const V& v)
+  {
+    size_t n = out.size();
+    out.resize(n + sizeof(V));
+    memcpy(&out[n], &v, sizeof(V));
+  }
+
+  template<class V>
+  static void put_value(std::vector<char>& out, const uint8_t tag, const V& v)
+  {
+    out.push_back(static_cast<char>(tag));
+    put_raw(out, v);
+  }
+
+  template<class V>
+  static void put_int(std::vector<char>& out, const V v)
+  {
+    uint8_t tag = (std::is_signed<V>::value ? Binary_log::Tag_int
+                                            : Binary_log::Tag_uint)
+        | static_cast<uint8_t>(sizeof(V));
+    put_value(out, tag, v);
+  }
+
+  static void put_string(std::vector<char>& out, const char* s, const size_t n)
+  {
+    put_value(out, Binary_log::Tag_string, static_cast<uint32_t>(n));
+    out.insert(out.end(), s, s + n);
+  }
+
+  static void put_wstring(std::vector<char>& out,
+                          const wchar_t* s,
+                          const size_t n)
+  {
+    put_value(out, Binary_log::Tag_wstring, static_cast<uint32_t>(n));
+    for(size_t i = 0; i < n; i++)
+    {
+      put_raw(out, static_cast<uint32_t>(s[i]));
+    }
+  }
+};
+
+} // namespace so
+
+#endif
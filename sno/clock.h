@@ -0,0 +1,149 @@
+/**
+ * @class Clock
+ * @brief Replaceable source of the current time.
+ *
+ * so::Stopwatch, so::Rate_loop, the so::Time_utils unix time functions, the
+ * logger's timestamps and rate limits and the flight recorder read the real
+ * clocks unless a Clock has been installed with Clock::Set_current(); then
+ * they read it instead. Checking costs one acquire load of a pointer.
+ * so::Basic_fast_stopwatch always reads the real clocks, so that its reads
+ * stay a bare clock read, and Time_utils::Cached_unix_time_ns() keeps its
+ * single load by having the cached clock stand down while a Clock is
+ * installed.
+ *
+ * so::Virtual_clock only moves when told to, which lets recorded data be
+ * replayed as fast as it can be processed with the same timings each run.
+ */
+
+#ifndef SO_CLOCK_H
+#define SO_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+#include <boost/atomic.hpp>
+
+namespace so
+{
+
+class Clock
+{
+public:
+  virtual ~Clock();
+
+  /**
+   * @brief Read the monotonic time, used for intervals
+   * @return Nanoseconds since an arbitrary start point
+   */
+  virtual int64_t Monotonic_ns() const = 0;
+
+  /**
+   * @brief Read the wall clock
+   * @return Nanoseconds since 00:00 on Jan 1 1970
+   */
+  virtual int64_t Unix_ns() const = 0;
+
+  /**
+   * @brief Install a clock for the whole process. Switch clocks while no
+   * stopwatch is running, or its reading will mix the two
+   * @param clock Clock to read, not owned, or nullptr for the real clocks
+   */
+  static void Set_current(Clock* clock);
+
+  /**
+   * @brief Get the installed clock
+   * @return The clock, or nullptr while the real clocks are in use
+   */
+  static Clock* Get_current()
+  {
+    return current().load(boost::memory_order_acquire);
+  }
+
+  /**
+   * @brief Read CLOCK_MONOTONIC, whichever clock is installed
+   * @return Nanoseconds since boot
+   */
+  static int64_t Real_monotonic_ns()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  /**
+   * @brief Read CLOCK_REALTIME, whichever clock is installed
+   * @return Nanoseconds since 00:00 on Jan 1 1970
+   */
+  static int64_t Real_unix_ns()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+private:
+  /**
+   * @brief Installed clock
+   */
+  static boost::atomic<Clock*>& current()
+  {
+    static boost::atomic<Clock*> c(nullptr);
+    return c;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Virtual_clock
+ * @brief A clock that only moves when told to. Usually one replay thread
+ * moves it to the timestamp of each record it reads; any thread may read it
+ */
+class Virtual_clock : public Clock
+{
+public:
+  /**
+   * @brief Constructor
+   * @param start_unix_ns Initial unix time, nanoseconds. The monotonic time
+   * starts at 0
+   */
+  explicit Virtual_clock(const int64_t start_unix_ns = 0);
+
+  int64_t Monotonic_ns() const override
+  {
+    return m_elapsed.load(boost::memory_order_acquire);
+  }
+
+  int64_t Unix_ns() const override
+  {
+    return m_start_unix + m_elapsed.load(boost::memory_order_acquire);
+  }
+
+  /**
+   * @brief Move the clock to a unix time
+   * @param unix_ns Unix time, nanoseconds
+   * @throws so::Invalid_argument if this would move the clock backwards
+   */
+  void Set_unix_ns(const int64_t unix_ns);
+
+  /**
+   * @brief Move the clock forward
+   * @param ns Nanoseconds to add
+   * @throws so::Invalid_argument if ns is negative
+   */
+  void Advance_ns(const int64_t ns);
+
+private:
+  /**
+   * @brief m_start_unix Unix time at monotonic time 0
+   */
+  const int64_t m_start_unix;
+
+  /**
+   * @brief m_elapsed Monotonic time, nanoseconds
+   */
+  boost::atomic<int64_t> m_elapsed;
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,338 @@
+/**
+ * @class Clock_mapper
+ * @brief Converts stamps of a monotonic clock to unix time without reading
+ * the wall clock.
+ *
+ * The mapper keeps a linear model unix_ns = base_unix + (raw - base_raw) *
+ * scale, so that converting a stamp is one multiply-add and a batch of stamps
+ * reads the model once. Update() reads both clocks and adjusts the model;
+ * call it periodically or let Start() do so from a background thread.
+ *
+ * Small differences between the model and the wall clock, such as an NTP
+ * slew or drift of the raw clock, are removed gradually by changing the scale
+ * by at most max_slew_ppm, so converted times stay monotonic. A difference
+ * larger than the step threshold, such as a wall clock step, is applied at
+ * once and resets the rate estimate.
+ *
+ * The model is published with a sequence lock: readers never block, and only
+ * repeat their read if it overlapped an update, which takes a few
+ * nanoseconds.
+ */
+
+#ifndef SO_CLOCK_MAPPER_H
+#define SO_CLOCK_MAPPER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <boost/atomic.hpp>
+#include <sno/clock.h>
+#include <sno/tsc_clock.h>
+
+namespace so
+{
+namespace Time_utils
+{
+
+class Clock_mapper
+{
+public:
+  /**
+   * @brief Clock the raw stamps come from
+   */
+  enum Source
+  {
+    Monotonic, ///< CLOCK_MONOTONIC nanoseconds, as std::chrono::steady_clock
+    Tsc,       ///< so::Tsc_clock ticks
+  };
+
+  /**
+   * @brief Constructor. Reads both clocks once to start the model
+   * @param source Clock of the raw stamps
+   * @param step_threshold_ns Larger differences from the wall clock are
+   * stepped, smaller ones slewed
+   * @param max_slew_ppm Largest change of rate used to slew, parts per
+   * million
+   * @throws so::Invalid_argument if a threshold is not positive
+   */
+  explicit Clock_mapper(const Source source = Monotonic,
+                        const int64_t step_threshold_ns = 1000000,
+                        const double max_slew_ppm = 500.0);
+
+  /**
+   * @brief Destructor, stops the update thread
+   */
+  ~Clock_mapper();
+
+  Clock_mapper(const Clock_mapper& other) = delete;
+  Clock_mapper& operator=(const Clock_mapper& other) = delete;
+
+  /**
+   * @brief Read the raw clock
+   * @return Stamp in the source's units
+   */
+  int64_t Now_raw() const
+  {
+    if(m_source == Tsc)
+    {
+      return Tsc_clock::Now();
+    }
+    return Clock::Real_monotonic_ns();
+  }
+
+  /**
+   * @brief Convert a raw stamp to unix time
+   * @param raw Stamp of the source clock
+   * @return Nanoseconds since 00:00 on Jan 1 1970
+   */
+  int64_t To_unix_ns(const int64_t raw) const
+  {
+    Model m = read_model();
+    return apply(m, raw);
+  }
+
+  /**
+   * @brief Convert a raw stamp to unix time
+   * @param raw Stamp of the source clock
+   * @return Decimal seconds since 00:00 on Jan 1 1970
+   */
+  double To_unix_time(const int64_t raw) const
+  {
+    return To_unix_ns(raw) * 1e-9;
+  }
+
+  /**
+   * @brief Convert a batch of raw stamps to unix time with a single model
+   * @param raw Stamps of the source clock
+   * @param unix_ns Set to nanoseconds since 00:00 on Jan 1 1970. May be the
+   * same array as raw
+   * @param count Number of stamps
+   */
+  void To_unix_ns(const int64_t* raw, int64_t* unix_ns, const size_t count) const
+  {
+    Model m = read_model();
+    for(size_t i = 0; i < count; i++)
+    {
+      unix_ns[i] = apply(m, raw[i]);
+    }
+  }
+
+  /**
+   * @brief Get the current unix time from the model
+   * @return Nanoseconds since 00:00 on Jan 1 1970
+   */
+  int64_t Now_unix_ns() const
+  {
+    return To_unix_ns(Now_raw());
+  }
+
+  /**
+   * @brief Read both clocks and adjust the model
+   */
+  void Update();
+
+  /**
+   * @brief Adjust the model to a pair of readings taken at the same moment,
+   * e.g. from an external time reference
+   * @param raw Stamp of the source clock
+   * @param unix_ns Unix time at raw, nanoseconds
+   */
+  void Update(const int64_t raw, const int64_t unix_ns);
+
+  /**
+   * @brief Call Update() from a background thread. Calling it again only
+   * changes the period
+   * @param period Time between updates
+   */
+  void Start(const std::chrono::milliseconds period =
+                 std::chrono::milliseconds(100));
+
+  /**
+   * @brief Stop the background thread
+   */
+  void Stop();
+
+  /**
+   * @brief Get the number of times the model was stepped
+   */
+  uint64_t Get_step_count() const
+  {
+    return m_steps.load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the difference between the wall clock and the model at the
+   * last update
+   * @return Wall clock minus model, nanoseconds
+   */
+  int64_t Get_last_error_ns() const
+  {
+    return m_last_error.load(boost::memory_order_relaxed);
+  }
+
+private:
+  /**
+   * @brief A snapshot of the model
+   */
+  struct Model
+  {
+    int64_t base_raw;
+    int64_t base_unix;
+    int64_t scale_q32; ///< Nanoseconds per raw unit, 32.32 fixed point
+  };
+
+  //Variables
+  /**
+   * @brief m_source Clock of the raw stamps
+   */
+  const Source m_source;
+
+  /**
+   * @brief m_step_threshold Differences above this are stepped, nanoseconds
+   */
+  const int64_t m_step_threshold;
+
+  /**
+   * @brief m_max_slew Largest relative change of rate used to slew
+   */
+  const double m_max_slew;
+
+  /**
+   * @brief m_sequence Odd while the model is being written
+   */
+  boost::atomic<uint64_t> m_sequence;
+
+  /**
+   * @brief m_base_raw Raw stamp the model starts at
+   */
+  boost::atomic<int64_t> m_base_raw;
+
+  /**
+   * @brief m_base_unix Unix time at m_base_raw, nanoseconds
+   */
+  boost::atomic<int64_t> m_base_unix;
+
+  /**
+   * @brief m_scale_q32 Nanoseconds per raw unit, 32.32 fixed point
+   */
+  boost::atomic<int64_t> m_scale_q32;
+
+  /**
+   * @brief m_steps Number of steps
+   */
+  boost::atomic<uint64_t> m_steps;
+
+  /**
+   * @brief m_last_error Wall clock minus model at the last update
+   */
+  boost::atomic<int64_t> m_last_error;
+
+  /**
+   * @brief m_update_mutex Serialises updates. Guards the variables below
+   */
+  std::mutex m_update_mutex;
+
+  /**
+   * @brief m_rate_q32 Estimated nanoseconds per raw unit without slewing
+   */
+  int64_t m_rate_q32;
+
+  /**
+   * @brief m_ref_raw Raw stamp of the reading the rate is estimated from
+   */
+  int64_t m_ref_raw;
+
+  /**
+   * @brief m_ref_unix Unix time of the reading the rate is estimated from
+   */
+  int64_t m_ref_unix;
+
+  /**
+   * @brief m_last_raw Raw stamp of the last update
+   */
+  int64_t m_last_raw;
+
+  /**
+   * @brief m_thread_mutex Guards the update thread's state
+   */
+  std::mutex m_thread_mutex;
+
+  /**
+   * @brief m_wake Wakes the update thread early when stopping
+   */
+  std::condition_variable m_wake;
+
+  /**
+   * @brief m_thread Update thread
+   */
+  std::thread m_thread;
+
+  /**
+   * @brief m_running True while the update thread should run
+   */
+  bool m_running;
+
+  /**
+   * @brief m_generation Number of times the update thread was started. A
+   * thread left over from before a restart exits when it changes
+   */
+  uint64_t m_generation;
+
+  /**
+   * @brief m_period Time between updates
+   */
+  std::chrono::milliseconds m_period;
+
+  //Functions
+  /**
+   * @brief Read a consistent snapshot of the model
+   */
+  Model read_model() const
+  {
+    Model m;
+    uint64_t before, after;
+    do
+    {
+      before = m_sequence.load(boost::memory_order_acquire);
+      m.base_raw = m_base_raw.load(boost::memory_order_relaxed);
+      m.base_unix = m_base_unix.load(boost::memory_order_relaxed);
+      m.scale_q32 = m_scale_q32.load(boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      after = m_sequence.load(boost::memory_order_relaxed);
+    }
+    while((before & 1) || before != after);
+    return m;
+  }
+
+  /**
+   * @brief Apply a model to a raw stamp
+   */
+  static int64_t apply(const Model& m, const int64_t raw)
+  {
+    return m.base_unix + Mul_q32(raw - m.base_raw, m.scale_q32);
+  }
+
+  /**
+   * @brief Publish a new model
+   */
+  void write_model(const Model& m);
+
+  /**
+   * @brief Read the raw clock and the wall clock at the same moment
+   */
+  void sample(int64_t& raw, int64_t& unix_ns) const;
+
+  /**
+   * @brief Update thread main loop
+   * @param generation Value of m_generation when the thread was started
+   */
+  void run(const uint64_t generation);
+};
+
+} // namespace Time_utils
+} // namespace so
+
+#endif
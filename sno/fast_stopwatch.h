@@ -0,0 +1,227 @@
+/**
+ * @class Basic_fast_stopwatch
+ * @brief Header-only stopwatch with the same interface as so::Stopwatch.
+ *
+ * Everything is inline and the state is a few integers, so a stopwatch can
+ * live on the stack, be created per request or copied freely without
+ * allocating, and Start() and Get_time_ns() compile down to a clock read and
+ * a subtraction. The clock is chosen at compile time; use the Fast_stopwatch
+ * and Fast_tsc_stopwatch typedefs. It always reads the real clock, even with
+ * a so::Clock installed; so::Stopwatch remains for code that needs the
+ * installed clock or a stable ABI.
+ */
+
+#ifndef SO_FAST_STOPWATCH_H
+#define SO_FAST_STOPWATCH_H
+
+#include <stdint.h>
+#include <chrono>
+#include <sno/latency_histogram.h>
+#include <sno/stopwatch.h>
+#include <sno/tsc_clock.h>
+
+namespace so
+{
+
+template<Stopwatch::Clock_source S>
+class Basic_fast_stopwatch
+{
+public:
+  /**
+   * @brief Constructor, a new stopwatch
+   */
+  Basic_fast_stopwatch()
+    :
+      m_start_time(0),
+      m_last_split(0),
+      m_elapsed_time(0),
+      m_running(false)
+  {
+  }
+
+  /**
+   * @brief Start the stopwatch. Does nothing if the stopwatch is already
+   * running
+   */
+  void Start()
+  {
+    if(m_running)
+    {
+      return;
+    }
+    Reset();
+    m_running = true;
+  }
+
+  /**
+   * @brief Stop the stopwatch but do not reset the elapsed time
+   * @return Elapsed time, seconds
+   */
+  double Stop()
+  {
+    return Stop_ns() * 1e-9;
+  }
+
+  /**
+   * @brief Stop the stopwatch but do not reset the elapsed time
+   * @return Elapsed time, nanoseconds
+   */
+  int64_t Stop_ns()
+  {
+    update_elapsed_time();
+    m_running = false;
+    return to_ns(m_elapsed_time);
+  }
+
+  /**
+   * @brief Take a split
+   * @return Number of seconds since the last split, or since the stopwatch was
+   * started if this is the first split. Returns 0 if the timer isn't running
+   */
+  double Split()
+  {
+    return Split_ns() * 1e-9;
+  }
+
+  /**
+   * @brief Take a split
+   * @return Number of nanoseconds since the last split, or since the
+   * stopwatch was started if this is the first split. Returns 0 if the timer
+   * isn't running
+   */
+  int64_t Split_ns()
+  {
+    if(!m_running)
+    {
+      return 0;
+    }
+    int64_t now = now_serialized();
+    int64_t split = now - m_last_split;
+    m_last_split = now;
+    return to_ns(split);
+  }
+
+  /**
+   * @brief Take a split and record it
+   * @param histogram Histogram to record the split in. Nothing is recorded
+   * if the timer isn't running
+   * @return Number of nanoseconds since the last split, as Split_ns()
+   */
+  int64_t Split_ns(Latency_histogram& histogram)
+  {
+    if(!m_running)
+    {
+      return 0;
+    }
+    int64_t split = Split_ns();
+    histogram.Record(split);
+    return split;
+  }
+
+  /**
+   * @brief Reset the stopwatch
+   */
+  void Reset()
+  {
+    m_start_time = now();
+    m_last_split = m_start_time;
+    m_elapsed_time = 0;
+  }
+
+  /**
+   * @brief Get the current elapsed time since the stopwatch was started
+   * @return Current elapsed time since the stopwatch was started, seconds
+   */
+  double Get_time()
+  {
+    return Get_time_ns() * 1e-9;
+  }
+
+  /**
+   * @brief Get the current elapsed time since the stopwatch was started
+   * @return Current elapsed time since the stopwatch was started, nanoseconds
+   */
+  int64_t Get_time_ns()
+  {
+    update_elapsed_time();
+    return to_ns(m_elapsed_time);
+  }
+
+private:
+  /**
+   * @brief m_start_time Time when the stopwatch started, clock ticks
+   */
+  int64_t m_start_time;
+
+  /**
+   * @brief m_last_split Time when the last split was taken, clock ticks
+   */
+  int64_t m_last_split;
+
+  /**
+   * @brief m_elapsed_time Last runtime of the stopwatch, clock ticks
+   */
+  int64_t m_elapsed_time;
+
+  /**
+   * @brief m_running True if the stopwatch is running
+   */
+  bool m_running;
+
+  /**
+   * @brief Read the clock at the start of a timed section
+   */
+  static int64_t now()
+  {
+    if(S == Stopwatch::Tsc)
+    {
+      return Tsc_clock::Now();
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * @brief Read the clock at the end of a timed section
+   */
+  static int64_t now_serialized()
+  {
+    return uses_tsc() ? Tsc_clock::Now_serialized() : now();
+  }
+
+  /**
+   * @brief Convert a difference between readings to nanoseconds
+   */
+  static int64_t to_ns(const int64_t ticks)
+  {
+    return uses_tsc() ? Tsc_clock::To_ns(ticks) : ticks;
+  }
+
+  /**
+   * @brief Check whether readings are Tsc_clock ticks rather than nanoseconds
+   */
+  static bool uses_tsc()
+  {
+    return S == Stopwatch::Tsc;
+  }
+
+  /**
+   * @brief Update the current elapsed time
+   */
+  void update_elapsed_time()
+  {
+    if(m_running)
+    {
+      m_elapsed_time = now_serialized() - m_start_time;
+    }
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Typedefs for the available clocks
+typedef Basic_fast_stopwatch<Stopwatch::Steady> Fast_stopwatch;
+typedef Basic_fast_stopwatch<Stopwatch::Tsc> Fast_tsc_stopwatch;
+
+} // namespace so
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @class Flight_recorder
+ * @brief Keeps the most recent log messages of every thread in memory, to be
+ * written out after a crash or on request.
+ *
+ * Each thread appends to a ring of its own with no locks and no system calls
+ * beyond reading the clock; the oldest messages are overwritten. Rings of
+ * threads that have exited are reused by new threads. Dump() uses only
+ * async-signal-safe calls, so it can run from a fatal signal handler, and
+ * Install_crash_handler() sets one up.
+ *
+ * Messages are stored as 'YYYY-MM-DD HH:MM:SS.nnnnnnnnn text' lines (UTC,
+ * formatted by so::Log_clock like the logger's timestamps). A dump lists each
+ * ring oldest first, under a header naming the thread that owns it. A thread
+ * still logging during a dump may overwrite the oldest part of its ring while
+ * it is being written, so the oldest sixteenth of a full ring is left out of
+ * the dump.
+ */
+
+#ifndef SO_FLIGHT_RECORDER_H
+#define SO_FLIGHT_RECORDER_H
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+namespace so
+{
+
+struct Flight_recorder_state;
+
+class Flight_recorder
+{
+public:
+  /**
+   * @brief Constructor
+   * @param bytes_per_thread Size of each thread's ring, rounded up to a power
+   * of two
+   */
+  explicit Flight_recorder(const size_t bytes_per_thread = 1 << 20);
+
+  /**
+   * @brief Destructor. Removes the crash handler if it dumps this recorder
+   */
+  ~Flight_recorder();
+
+  Flight_recorder(const Flight_recorder& other) = delete;
+  Flight_recorder& operator=(const Flight_recorder& other) = delete;
+
+  /**
+   * @brief Append a message to the calling thread's ring. Lock-free
+   * @param text Message, without a line ending
+   * @param len Number of characters in text
+   */
+  void Record(const char* text, const size_t len);
+
+  /**
+   * @brief Append a wide message, encoded as UTF-8 straight into the ring.
+   * Lock-free, and does not allocate
+   * @param text Message, without a line ending
+   * @param len Number of characters in text
+   */
+  void Record(const wchar_t* text, const size_t len);
+
+  /**
+   * @brief Write every ring to a file descriptor. Async-signal-safe
+   * @param fd Open file descriptor
+   */
+  void Dump(const int fd) const;
+
+  /**
+   * @brief Write every ring to a file
+   * @param filename File to write, truncated if it exists
+   * @throws so::Write_error if the file cannot be opened
+   */
+  void Dump(const std::string& filename) const;
+
+  /**
+   * @brief Dump this recorder to a file when the process receives SIGSEGV,
+   * SIGBUS, SIGFPE, SIGILL or SIGABRT. The previous handlers are restored
+   * and the signal is raised again afterwards. Replaces the crash handler of
+   * any other recorder
+   * @param filename File to write the dump to
+   */
+  void Install_crash_handler(const std::string& filename);
+
+  /**
+   * @brief Restore the signal handlers that were in place before
+   * Install_crash_handler()
+   */
+  static void Remove_crash_handler();
+
+private:
+  /**
+   * @brief m_state Rings. Shared with the threads using them, so that a
+   * thread exiting after the recorder is destroyed never touches freed memory
+   */
+  std::shared_ptr<Flight_recorder_state> m_state;
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @brief WGS-84 geodetic conversions between latitude/longitude/height (LLA),
+ * earth centered earth fixed (ECEF) and local tangent plane (NED/ENU)
+ * coordinates
+ *
+ * LLA coordinates are [latitude, longitude, height], with latitude and
+ * longitude in degrees and height above the ellipsoid in meters. Batch
+ * functions take one point per column.
+ */
+
+#ifndef SO_GEODETIC_H
+#define SO_GEODETIC_H
+
+#include <eigen3/Eigen/Dense>
+
+namespace so
+{
+namespace Geodetic
+{
+/**
+ * @brief WGS-84 semi-major axis, meters
+ */
+const double WGS84_A = 6378137.0;
+
+/**
+ * @brief WGS-84 flattening
+ */
+const double WGS84_F = 1 / 298.257223563;
+
+/**
+ * @brief Convert geodetic coordinates to ECEF
+ * @param lla [latitude, longitude, height]
+ * @return [X, Y, Z] ECEF coordinates, meters
+ */
+Eigen::Vector3d lla_2_ecef(const Eigen::Vector3d& lla);
+
+/**
+ * @brief Convert a set of geodetic coordinates to ECEF
+ * @param lla [latitude, longitude, height], one point per column
+ * @return [X, Y, Z] ECEF coordinates, one point per column
+ */
+Eigen::Matrix3Xd lla_2_ecef(const Eigen::Matrix3Xd& lla);
+
+/**
+ * @brief Convert ECEF coordinates to geodetic coordinates using Bowring's
+ * method. Accurate to well under a millimeter for points within 1000 km of the
+ * earth's surface
+ * @param ecef [X, Y, Z] ECEF coordinates, meters
+ * @return [latitude, longitude, height]
+ */
+Eigen::Vector3d ecef_2_lla(const Eigen::Vector3d& ecef);
+
+/**
+ * @brief Convert a set of ECEF coordinates to geodetic coordinates
+ * @param ecef [X, Y, Z] ECEF coordinates, one point per column
+ * @return [latitude, longitude, height], one point per column
+ */
+Eigen::Matrix3Xd ecef_2_lla(const Eigen::Matrix3Xd& ecef);
+
+/**
+ * @brief Return the matrix that rotates an ECEF vector into the north/east/down
+ * frame at the given location
+ * @param lat Latitude, degrees
+ * @param lon Longitude, degrees
+ * @return ECEF to NED rotation matrix
+ */
+Eigen::Matrix3d ecef_2_ned_matrix(double lat, double lon);
+
+/**
+ * @class Local_frame
+ * @brief Local tangent plane about a fixed reference point. The origin's ECEF
+ * position and the tangent plane rotation are computed once on construction
+ * and reused for every conversion
+ */
+class Local_frame
+{
+public:
+  /**
+   * @brief Constructor, a new local frame
+   * @param origin_lla [latitude, longitude, height] of the frame origin
+   */
+  explicit Local_frame(const Eigen::Vector3d& origin_lla);
+
+  /**
+   * @brief Get the origin of the frame
+   * @return [latitude, longitude, height] of the frame origin
+   */
+  const Eigen::Vector3d& Get_origin() const;
+
+  /**
+   * @brief Convert ECEF coordinates to north/east/down relative to the origin
+   * @param ecef [X, Y, Z] ECEF coordinates, meters
+   * @return [northing, easting, downing], meters
+   */
+  Eigen::Vector3d Ecef_2_ned(const Eigen::Vector3d& ecef) const;
+  Eigen::Matrix3Xd Ecef_2_ned(const Eigen::Matrix3Xd& ecef) const;
+
+  /**
+   * @brief Convert north/east/down relative to the origin to ECEF coordinates
+   * @param ned [northing, easting, downing], meters
+   * @return [X, Y, Z] ECEF coordinates, meters
+   */
+  Eigen::Vector3d Ned_2_ecef(const Eigen::Vector3d& ned) const;
+  Eigen::Matrix3Xd Ned_2_ecef(const Eigen::Matrix3Xd& ned) const;
+
+  /**
+   * @brief Convert ECEF coordinates to east/north/up relative to the origin
+   * @param ecef [X, Y, Z] ECEF coordinates, meters
+   * @return [easting, northing, upping], meters
+   */
+  Eigen::Vector3d Ecef_2_enu(const Eigen::Vector3d& ecef) const;
+  Eigen::Matrix3Xd Ecef_2_enu(const Eigen::Matrix3Xd& ecef) const;
+
+  /**
+   * @brief Convert east/north/up relative to the origin to ECEF coordinates
+   * @param enu [easting, northing, upping], meters
+   * @return [X, Y, Z] ECEF coordinates, meters
+   */
+  Eigen::Vector3d Enu_2_ecef(const Eigen::Vector3d& enu) const;
+  Eigen::Matrix3Xd Enu_2_ecef(const Eigen::Matrix3Xd& enu) const;
+
+  /**
+   * @brief Convert geodetic coordinates to north/east/down relative to the
+   * origin
+   * @param lla [latitude, longitude, height]
+   * @return [northing, easting, downing], meters
+   */
+  Eigen::Vector3d Lla_2_ned(const Eigen::Vector3d& lla) const;
+  Eigen::Matrix3Xd Lla_2_ned(const Eigen::Matrix3Xd& lla) const;
+
+  /**
+   * @brief Convert north/east/down relative to the origin to geodetic
+   * coordinates. Can be used directly on the output of
+   * so::Rotate::body_2_earth() when the origin is the vehicle position
+   * @param ned [northing, easting, downing], meters
+   * @return [latitude, longitude, height]
+   */
+  Eigen::Vector3d Ned_2_lla(const Eigen::Vector3d& ned) const;
+  Eigen::Matrix3Xd Ned_2_lla(const Eigen::Matrix3Xd& ned) const;
+
+private:
+  /**
+   * @brief m_origin_lla Frame origin, [latitude, longitude, height]
+   */
+  Eigen::Vector3d m_origin_lla;
+
+  /**
+   * @brief m_origin_ecef Frame origin, ECEF
+   */
+  Eigen::Vector3d m_origin_ecef;
+
+  /**
+   * @brief m_ecef_2_ned Rotation from ECEF to NED at the origin
+   */
+  Eigen::Matrix3d m_ecef_2_ned;
+
+  /**
+   * @brief m_ecef_2_enu Rotation from ECEF to ENU at the origin
+   */
+  Eigen::Matrix3d m_ecef_2_enu;
+};
+
+} // namespace Geodetic
+} // namespace so
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * @class Latency_histogram
+ * @brief Fixed-memory histogram of durations in nanoseconds, laid out like
+ * HdrHistogram: values are grouped into power of two buckets, each split into
+ * enough linear sub-buckets to keep the requested number of significant
+ * digits. Raw samples are not kept, so the memory is fixed when the histogram
+ * is created (about 36 KiB with the defaults) however many values it records.
+ *
+ * Record() is a bucket index computation and a relaxed atomic increment, so
+ * any number of threads may record into the same histogram without locks.
+ * Threads recording very often are better off with a histogram each, merged
+ * with Merge() when the percentiles are needed, so that they do not contend
+ * on the same counters.
+ *
+ * Percentiles are exact to the requested significant digits: with the default
+ * of 2 a reported value is within 1% of the recorded one.
+ */
+
+#ifndef SO_LATENCY_HISTOGRAM_H
+#define SO_LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <boost/atomic.hpp>
+
+namespace so
+{
+
+class Latency_histogram
+{
+public:
+  /**
+   * @brief Constructor, an empty histogram
+   * @param max_ns Largest value kept to full precision. Larger values are
+   * counted as max_ns, although Get_max() still reports them
+   * @param significant_digits Precision of the counts, 1 to 5
+   * @throws so::Invalid_argument if max_ns is less than 2 or
+   * significant_digits is out of range
+   */
+  explicit Latency_histogram(const int64_t max_ns = 3600000000000LL,
+                             const int significant_digits = 2);
+
+  Latency_histogram(const Latency_histogram& other) = delete;
+  Latency_histogram& operator=(const Latency_histogram& other) = delete;
+
+  /**
+   * @brief Record a duration. Safe to call from any number of threads
+   * @param ns Duration, nanoseconds. Negative values are counted as 0
+   * @param count Number of times to record it
+   */
+  void Record(const int64_t ns, const uint64_t count = 1)
+  {
+    int64_t value = ns < 0 ? 0 : ns;
+    m_counts[index_of(value < m_max_trackable ? value : m_max_trackable)]
+        .fetch_add(count, boost::memory_order_relaxed);
+
+    int64_t min = m_min.load(boost::memory_order_relaxed);
+    while(value < min &&
+          !m_min.compare_exchange_weak(min, value, boost::memory_order_relaxed))
+    {
+    }
+    int64_t max = m_max.load(boost::memory_order_relaxed);
+    while(value > max &&
+          !m_max.compare_exchange_weak(max, value, boost::memory_order_relaxed))
+    {
+    }
+  }
+
+  /**
+   * @brief Add the counts of another histogram to this one. Both may be
+   * recorded into meanwhile
+   * @param other Histogram created with the same arguments
+   * @throws so::Invalid_argument if the histograms have a different layout
+   */
+  void Merge(const Latency_histogram& other);
+
+  /**
+   * @brief Get the value below which a share of the recorded values fall
+   * @param percentile Share of the values, 0 to 100, e.g. 99.9
+   * @return Largest value equivalent to the value at the percentile,
+   * nanoseconds, or 0 if nothing has been recorded
+   */
+  int64_t Get_percentile(const double percentile) const;
+
+  /**
+   * @brief Get the number of recorded values
+   */
+  uint64_t Get_count() const;
+
+  /**
+   * @brief Get the smallest recorded value, nanoseconds, or 0 if nothing has
+   * been recorded
+   */
+  int64_t Get_min() const;
+
+  /**
+   * @brief Get the largest recorded value, nanoseconds, or 0 if nothing has
+   * been recorded
+   */
+  int64_t Get_max() const;
+
+  /**
+   * @brief Get the mean of the recorded values, to the histogram's precision
+   * @return Mean, nanoseconds, or 0 if nothing has been recorded
+   */
+  double Get_mean() const;
+
+  /**
+   * @brief Get the largest value kept to full precision, nanoseconds
+   */
+  int64_t Get_max_trackable() const
+  {
+    return m_max_trackable;
+  }
+
+  /**
+   * @brief Get the number of significant digits kept
+   */
+  int Get_significant_digits() const
+  {
+    return m_significant_digits;
+  }
+
+  /**
+   * @brief Forget all recorded values. Values recorded by other threads
+   * meanwhile may or may not be kept
+   */
+  void Reset();
+
+private:
+  //Variables
+  /**
+   * @brief m_max_trackable Largest value kept to full precision
+   */
+  const int64_t m_max_trackable;
+
+  /**
+   * @brief m_significant_digits Precision of the counts
+   */
+  const int m_significant_digits;
+
+  /**
+   * @brief m_sub_bucket_half_count_magnitude log2 of half the number of
+   * sub-buckets in each bucket
+   */
+  int m_sub_bucket_half_count_magnitude;
+
+  /**
+   * @brief m_sub_bucket_mask Mask of the values that fall in bucket 0
+   */
+  uint64_t m_sub_bucket_mask;
+
+  /**
+   * @brief m_counts_size Number of counters
+   */
+  size_t m_counts_size;
+
+  /**
+   * @brief m_counts Number of values recorded in each sub-bucket
+   */
+  std::unique_ptr<boost::atomic<uint64_t>[]> m_counts;
+
+  /**
+   * @brief m_min Smallest recorded value, INT64_MAX if none
+   */
+  boost::atomic<int64_t> m_min;
+
+  /**
+   * @brief m_max Largest recorded value, -1 if none
+   */
+  boost::atomic<int64_t> m_max;
+
+  //Functions
+  /**
+   * @brief Get the counter of a value
+   * @param value Value, 0 to m_max_trackable
+   */
+  size_t index_of(const int64_t value) const
+  {
+    int bucket = 63 - __builtin_clzll(static_cast<uint64_t>(value) |
+                                      m_sub_bucket_mask) -
+                 m_sub_bucket_half_count_magnitude;
+    int64_t sub_bucket = value >> bucket;
+    return (static_cast<size_t>(bucket + 1) <<
+            m_sub_bucket_half_count_magnitude) +
+           static_cast<size_t>(sub_bucket) -
+           (static_cast<size_t>(1) << m_sub_bucket_half_count_magnitude);
+  }
+
+  /**
+   * @brief Get the range of values counted by a counter
+   * @param index Counter
+   * @param lowest Set to the smallest value of the range
+   * @return Number of values in the range
+   */
+  int64_t range_of(const size_t index, int64_t& lowest) const;
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @class Log_clock
+ * @brief Clock readings and timestamp text for log message prefixes.
+ *
+ * Now() reads one of the clock_gettime() clocks. The coarse clocks only tick
+ * every few milliseconds but cost a fraction of the precise ones, which is
+ * usually the better trade for log lines. Format() keeps the text for the
+ * current second of each thread, so a timestamp costs a comparison and the
+ * conversion of the nanoseconds rather than a call to strftime().
+ *
+ * While a so::Clock is installed, Now() reads it instead: its unix time for
+ * the wall clocks and its monotonic time for the others.
+ */
+
+#ifndef SO_LOG_CLOCK_H
+#define SO_LOG_CLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sno/clock.h>
+
+namespace so
+{
+
+class Log_clock
+{
+public:
+  /**
+   * @brief Clock to read
+   */
+  enum Source
+  {
+    Wall,             ///< Unix time, CLOCK_REALTIME
+    Wall_coarse,      ///< Unix time, CLOCK_REALTIME_COARSE
+    Monotonic,        ///< Time since boot, CLOCK_MONOTONIC
+    Monotonic_coarse, ///< Time since boot, CLOCK_MONOTONIC_COARSE
+  };
+
+  /**
+   * @brief Longest text written by Format()
+   */
+  static const size_t MAX_TEXT = 48;
+
+  /**
+   * @brief Read a clock
+   * @param source Clock to read
+   * @return Nanoseconds since the clock's epoch
+   */
+  static int64_t Now(const Source source)
+  {
+    const Clock* clock = Clock::Get_current();
+    if(clock)
+    {
+      return Is_wall(source) ? clock->Unix_ns() : clock->Monotonic_ns();
+    }
+    static const clockid_t ids[] =
+    {
+      CLOCK_REALTIME,
+      CLOCK_REALTIME_COARSE,
+      CLOCK_MONOTONIC,
+      CLOCK_MONOTONIC_COARSE,
+    };
+    timespec ts;
+    clock_gettime(ids[source], &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  /**
+   * @brief Check whether a clock gives Unix time
+   * @param source Clock
+   * @return True for the wall clocks
+   */
+  static bool Is_wall(const Source source)
+  {
+    return source == Wall || source == Wall_coarse;
+  }
+
+  /**
+   * @brief Format a reading as 'YYYY-MM-DD HH:MM:SS.nnnnnnnnn ' (UTC) for a
+   * wall clock or as 'seconds.nnnnnnnnn ' for a monotonic clock. Fast when
+   * the calling thread formatted a reading from the same second last time
+   * @param source Clock the reading came from
+   * @param ns Reading from Now()
+   * @param out Buffer of at least MAX_TEXT characters
+   * @return Number of characters written
+   */
+  static size_t Format(const Source source, const int64_t ns, char* out);
+};
+
+} // namespace so
+
+#endif
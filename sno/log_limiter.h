@@ -0,0 +1,338 @@
+/**
+ * @class Log_limiter
+ * @brief Decides which messages from one log statement get through when the
+ * statement fires too often. Used by the Log_msg_every_n, Log_msg_first_n and
+ * Log_msg_rate macros, which keep one limiter per statement.
+ *
+ * The check is lock-free: counting modes take one atomic increment, the rate
+ * mode reads the coarse monotonic clock (a few milliseconds resolution, but
+ * several times cheaper than the precise one) and updates one atomic with
+ * compare-and-swap.
+ * The number of messages held back is handed to the next message that gets
+ * through, so a flooding statement reports how much it suppressed each time
+ * it is let through. Limiters made for a call site also join a registry, from
+ * which Drain_suppressed() collects what each one has held back since the
+ * last call; the logger's periodic summary (Basic_logger::
+ * Set_limiter_summary()) uses it to report floods that have stopped.
+ */
+
+#ifndef SO_LOG_LIMITER_H
+#define SO_LOG_LIMITER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <sno/clock.h>
+
+namespace so
+{
+
+class Log_limiter
+{
+public:
+  /**
+   * @brief How messages are selected
+   */
+  enum Mode
+  {
+    Every_n, ///< The 1st, (n+1)th, (2n+1)th... message
+    First_n, ///< The first n messages, then every mth message
+    Rate,    ///< Token bucket: n messages per second, bursts of up to m
+  };
+
+  /**
+   * @brief Constructor
+   * @param mode How messages are selected
+   * @param n Every_n: keep one message in n. First_n: number of messages
+   * kept before thinning out. Rate: messages per second
+   * @param m First_n: keep one message in m after the first n. Rate: largest
+   * burst let through at once. Not used by Every_n
+   */
+  Log_limiter(const Mode mode, const uint64_t n, const uint64_t m = 1)
+    :
+      m_mode(mode),
+      m_n(std::max<uint64_t>(n, mode == First_n ? 0 : 1)),
+      m_m(std::max<uint64_t>(m, 1)),
+      m_interval(mode == Rate ? 1000000000 / static_cast<int64_t>(m_n) : 0),
+      m_tolerance(m_interval * static_cast<int64_t>(m_m - 1)),
+      m_count(0),
+      m_next_time(0),
+      m_suppressed(0),
+      m_noted(0),
+      m_file(nullptr),
+      m_line(0),
+      m_summarized(0)
+  {
+  }
+
+  /**
+   * @brief Constructor for the limiter of a log statement, which joins the
+   * registry read by Drain_suppressed()
+   * @param file Source file of the statement
+   * @param line Line of the statement
+   * @param mode How messages are selected
+   * @param n See the other constructor
+   * @param m See the other constructor
+   */
+  Log_limiter(const char* file,
+              const int line,
+              const Mode mode,
+              const uint64_t n,
+              const uint64_t m = 1)
+    :
+      Log_limiter(mode, n, m)
+  {
+    m_file = file;
+    m_line = line;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.limiters.push_back(this);
+  }
+
+  /**
+   * @brief Destructor, leaves the registry
+   */
+  ~Log_limiter()
+  {
+    if(m_file)
+    {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.limiters.erase(std::remove(r.limiters.begin(), r.limiters.end(), this),
+                       r.limiters.end());
+    }
+  }
+
+  Log_limiter(const Log_limiter& other) = delete;
+  Log_limiter& operator=(const Log_limiter& other) = delete;
+
+  /**
+   * @brief Decide whether a message gets through. Safe to call from any
+   * number of threads
+   * @param suppressed Set to the number of messages held back since the
+   * last message that got through, if this one gets through
+   * @return True if the message should be logged
+   */
+  bool Allow(uint64_t& suppressed)
+  {
+    if(m_mode == Rate)
+    {
+      if(!take_token())
+      {
+        m_suppressed.fetch_add(1, boost::memory_order_relaxed);
+        return false;
+      }
+      // Another thread let through at the same time may have read a later
+      // total and noted it already, so m_noted only moves forward and each
+      // suppressed message is handed to exactly one of them
+      uint64_t total = m_suppressed.load(boost::memory_order_relaxed);
+      uint64_t noted = m_noted.load(boost::memory_order_relaxed);
+      suppressed = 0;
+      while(noted < total)
+      {
+        if(m_noted.compare_exchange_weak(noted,
+                                         total,
+                                         boost::memory_order_relaxed))
+        {
+          suppressed = total - noted;
+          break;
+        }
+      }
+      return true;
+    }
+
+    // The messages held back follow from the count, so counting modes take
+    // a single atomic increment
+    uint64_t count = m_count.fetch_add(1, boost::memory_order_relaxed);
+    if(m_mode == Every_n)
+    {
+      if(count % m_n != 0)
+      {
+        return false;
+      }
+      suppressed = count == 0 ? 0 : m_n - 1;
+      return true;
+    }
+    if(count < m_n)
+    {
+      suppressed = 0;
+      return true;
+    }
+    if((count - m_n) % m_m != m_m - 1)
+    {
+      return false;
+    }
+    // The previous message let through was m_m earlier, or the last of the
+    // first m_n
+    suppressed = std::min(m_m, count + 1 - m_n) - 1;
+    return true;
+  }
+
+  /**
+   * @brief Collect the messages each registered limiter has held back since
+   * the last call. Not meant for hot paths: it takes the registry's lock
+   * @param report Called as report(file, line, count) for each limiter that
+   * held messages back
+   */
+  template<typename F>
+  static void Drain_suppressed(F report)
+  {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for(Log_limiter* limiter : r.limiters)
+    {
+      uint64_t total = limiter->get_suppressed_total();
+      if(total != limiter->m_summarized)
+      {
+        report(limiter->m_file, limiter->m_line, total - limiter->m_summarized);
+        limiter->m_summarized = total;
+      }
+    }
+  }
+
+private:
+  //Variables
+  /**
+   * @brief m_mode How messages are selected
+   */
+  const Mode m_mode;
+
+  /**
+   * @brief m_n First parameter, see the constructor
+   */
+  const uint64_t m_n;
+
+  /**
+   * @brief m_m Second parameter, see the constructor
+   */
+  const uint64_t m_m;
+
+  /**
+   * @brief m_interval Rate: nanoseconds per token
+   */
+  const int64_t m_interval;
+
+  /**
+   * @brief m_tolerance Rate: how far ahead of the clock m_next_time may run,
+   * nanoseconds
+   */
+  const int64_t m_tolerance;
+
+  /**
+   * @brief m_count Every_n and First_n: number of messages seen
+   */
+  boost::atomic<uint64_t> m_count;
+
+  /**
+   * @brief m_next_time Rate: time at which the bucket would be full again,
+   * monotonic clock nanoseconds
+   */
+  boost::atomic<int64_t> m_next_time;
+
+  /**
+   * @brief m_suppressed Rate: messages held back
+   */
+  boost::atomic<uint64_t> m_suppressed;
+
+  /**
+   * @brief m_noted Rate: value of m_suppressed last handed to a message
+   */
+  boost::atomic<uint64_t> m_noted;
+
+  /**
+   * @brief m_file Source file of the statement, nullptr if not registered
+   */
+  const char* m_file;
+
+  /**
+   * @brief m_line Line of the statement
+   */
+  int m_line;
+
+  /**
+   * @brief m_summarized Messages held back already collected by
+   * Drain_suppressed(). Guarded by the registry's lock
+   */
+  uint64_t m_summarized;
+
+  /**
+   * @brief Limiters of log statements
+   */
+  struct Registry
+  {
+    std::mutex mutex;
+    std::vector<Log_limiter*> limiters;
+  };
+
+  //Functions
+  /**
+   * @brief Get the registry. Built by the first registered limiter, so it
+   * outlives all of them
+   */
+  static Registry& registry()
+  {
+    static Registry r;
+    return r;
+  }
+
+  /**
+   * @brief Count the messages held back since construction
+   */
+  uint64_t get_suppressed_total() const
+  {
+    if(m_mode == Rate)
+    {
+      return m_suppressed.load(boost::memory_order_relaxed);
+    }
+    uint64_t count = m_count.load(boost::memory_order_relaxed);
+    if(m_mode == Every_n)
+    {
+      return count - (count + m_n - 1) / m_n;
+    }
+    if(count <= m_n)
+    {
+      return 0;
+    }
+    return count - m_n - (count - m_n) / m_m;
+  }
+
+  /**
+   * @brief Rate: take a token from the bucket if there is one. Generic cell
+   * rate algorithm: the bucket is one timestamp that moves forward by
+   * m_interval for each message let through
+   */
+  bool take_token()
+  {
+    int64_t now;
+    const Clock* clock = Clock::Get_current();
+    if(clock)
+    {
+      now = clock->Monotonic_ns();
+    }
+    else
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+      now = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+    int64_t next = m_next_time.load(boost::memory_order_relaxed);
+    do
+    {
+      if(next - m_tolerance > now)
+      {
+        return false;
+      }
+    }
+    while(!m_next_time.compare_exchange_weak(next,
+                                             std::max(next, now) + m_interval,
+                                             boost::memory_order_relaxed));
+    return true;
+  }
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,333 @@
+/**
+ * @class Log_sink
+ * @brief Output for so::Basic_logger messages. Sinks registered with
+ * Basic_logger::Add_sink() each get their own level mask and their own
+ * background writer, so a slow sink never holds up a fast one.
+ *
+ * Write() and End_batch() are only ever called from the sink's writer thread.
+ * Provided sinks: Stream_sink (e.g. the console), File_sink, Ring_sink (the
+ * most recent messages in memory) and Callback_sink.
+ */
+
+#ifndef SO_LOG_SINK_H
+#define SO_LOG_SINK_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <sno/log_writer.h>
+
+namespace so
+{
+
+/**
+ * @class Log_file_stream
+ * @brief Append-mode file stream with a large buffer of its own, so that a
+ * batch of log lines reaches the file in a single write
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Log_file_stream : public std::basic_ofstream<C,T>
+{
+public:
+  /**
+   * @brief Constructor, opens the file for appending
+   * @param filename File to write to
+   * @param buffer_size Buffer size in characters
+   */
+  Log_file_stream(const std::string& filename, const size_t buffer_size)
+    :
+      std::basic_ofstream<C,T>(),
+      m_data(std::max<size_t>(buffer_size, 1))
+  {
+    // The buffer has to be installed before the file is opened
+    this->rdbuf()->pubsetbuf(m_data.data(), m_data.size());
+    this->open(filename.c_str(), std::ios_base::app);
+  }
+
+  /**
+   * @brief Destructor, writes out the buffer while it still exists
+   */
+  ~Log_file_stream()
+  {
+    this->close();
+  }
+
+private:
+  /**
+   * @brief m_data Storage for the stream buffer
+   */
+  std::vector<C> m_data;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+template<typename C, typename T = std::char_traits<C> >
+class Log_sink
+{
+public:
+  /**
+   * @brief Constructor
+   * @param mask Logging level mask, as for Basic_logger::Set_logging_level().
+   * Defaults to every level
+   */
+  explicit Log_sink(const uint64_t mask = 0xFFFFFFFFFF)
+    :
+      m_mask(mask)
+  {
+  }
+
+  virtual ~Log_sink()
+  {
+  }
+
+  Log_sink(const Log_sink& other) = delete;
+  Log_sink& operator=(const Log_sink& other) = delete;
+
+  /**
+   * @brief Set the level mask of this sink. Messages must also pass the
+   * logger's own mask
+   * @param mask Logging level mask
+   */
+  void Set_logging_level(const uint64_t mask)
+  {
+    m_mask.store(mask, boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Check a message level against this sink's mask
+   * @param level Message level
+   * @return True if the sink takes messages at this level
+   */
+  bool Is_enabled(const uint64_t level) const
+  {
+    return (level & m_mask.load(boost::memory_order_relaxed)) == level;
+  }
+
+  /**
+   * @brief Write a message
+   * @param record Message, without a line ending
+   */
+  virtual void Write(const Log_record<C,T>& record) = 0;
+
+  /**
+   * @brief Called after each batch of messages, e.g. to flush
+   */
+  virtual void End_batch()
+  {
+  }
+
+private:
+  /**
+   * @brief m_mask Logging level mask
+   */
+  boost::atomic<uint64_t> m_mask;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Stream_sink
+ * @brief Writes messages to a stream, e.g. Stream_info<C,T>::Get_default()
+ * for the console. The stream is flushed once per batch
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Stream_sink : public Log_sink<C,T>
+{
+public:
+  /**
+   * @brief Constructor
+   * @param stream Stream to write to. Nothing else should write to it
+   * while the sink is registered
+   * @param mask Logging level mask
+   */
+  explicit Stream_sink(const boost::shared_ptr<std::basic_ostream<C,T> >& stream,
+                       const uint64_t mask = 0xFFFFFFFFFF)
+    :
+      Log_sink<C,T>(mask),
+      m_stream(stream)
+  {
+  }
+
+  void Write(const Log_record<C,T>& record) override
+  {
+    m_stream->write(record.text.data(), record.text.size());
+    m_stream->put(m_stream->widen('\n'));
+  }
+
+  void End_batch() override
+  {
+    m_stream->flush();
+  }
+
+private:
+  /**
+   * @brief m_stream Output stream
+   */
+  boost::shared_ptr<std::basic_ostream<C,T> > m_stream;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class File_sink
+ * @brief Appends messages to a file through a large buffer that is written
+ * out once per batch
+ */
+template<typename C, typename T = std::char_traits<C> >
+class File_sink : public Log_sink<C,T>
+{
+public:
+  /**
+   * @brief Constructor, opens the file
+   * @param filename File to append to
+   * @param mask Logging level mask
+   * @param buffer_size Size of the file buffer in characters
+   */
+  explicit File_sink(const std::string& filename,
+                     const uint64_t mask = 0xFFFFFFFFFF,
+                     const size_t buffer_size = 1 << 20)
+    :
+      Log_sink<C,T>(mask),
+      m_stream(filename, buffer_size)
+  {
+  }
+
+  void Write(const Log_record<C,T>& record) override
+  {
+    m_stream.write(record.text.data(), record.text.size());
+    m_stream.put(m_stream.widen('\n'));
+  }
+
+  void End_batch() override
+  {
+    m_stream.flush();
+  }
+
+private:
+  /**
+   * @brief m_stream Output file
+   */
+  Log_file_stream<C,T> m_stream;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Ring_sink
+ * @brief Keeps the most recent messages in memory
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Ring_sink : public Log_sink<C,T>
+{
+public:
+  /**
+   * @brief Constructor
+   * @param capacity Number of messages kept
+   * @param mask Logging level mask
+   */
+  explicit Ring_sink(const size_t capacity,
+                     const uint64_t mask = 0xFFFFFFFFFF)
+    :
+      Log_sink<C,T>(mask),
+      m_mutex(),
+      m_records(std::max<size_t>(capacity, 1)),
+      m_next(0),
+      m_size(0)
+  {
+  }
+
+  void Write(const Log_record<C,T>& record) override
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_records[m_next] = record.text;
+    m_next = (m_next + 1) % m_records.size();
+    m_size = std::min(m_size + 1, m_records.size());
+  }
+
+  /**
+   * @brief Get the messages in the ring. Safe to call from any thread
+   * @return Messages, oldest first
+   */
+  std::vector<std::basic_string<C,T> > Get_records() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::basic_string<C,T> > records;
+    records.reserve(m_size);
+    size_t first = (m_next + m_records.size() - m_size) % m_records.size();
+    for(size_t i = 0; i < m_size; i++)
+    {
+      records.push_back(m_records[(first + i) % m_records.size()]);
+    }
+    return records;
+  }
+
+private:
+  /**
+   * @brief m_mutex Guards the ring against readers
+   */
+  mutable std::mutex m_mutex;
+
+  /**
+   * @brief m_records Storage, reused as the ring wraps
+   */
+  std::vector<std::basic_string<C,T> > m_records;
+
+  /**
+   * @brief m_next Slot the next message goes into
+   */
+  size_t m_next;
+
+  /**
+   * @brief m_size Number of messages in the ring
+   */
+  size_t m_size;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Callback_sink
+ * @brief Passes every message to a function
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Callback_sink : public Log_sink<C,T>
+{
+public:
+  typedef std::function<void(const Log_record<C,T>&)> Callback;
+
+  /**
+   * @brief Constructor
+   * @param callback Called from the sink's writer thread for each message
+   * @param mask Logging level mask
+   */
+  explicit Callback_sink(const Callback& callback,
+                         const uint64_t mask = 0xFFFFFFFFFF)
+    :
+      Log_sink<C,T>(mask),
+      m_callback(callback)
+  {
+  }
+
+  void Write(const Log_record<C,T>& record) override
+  {
+    m_callback(record);
+  }
+
+private:
+  /**
+   * @brief m_callback Message handler
+   */
+  Callback m_callback;
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,390 @@
+/**
+ * @class Log_writer
+ * @brief Asynchronous backend for so::Basic_logger. Producers push finished
+ * records into a bounded lock-free queue and a background thread drains them
+ * to the output.
+ *
+ * Memory is bounded by the queue capacity and the maximum record size; longer
+ * records are truncated. When the queue is full producers either wait for
+ * space (Block) or discard the record (Drop). Dropped records are counted and
+ * reported through the output as a single line. Destroying the writer, or
+ * calling Stop(), writes every record pushed before the call.
+ */
+
+#ifndef SO_LOG_WRITER_H
+#define SO_LOG_WRITER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <boost/atomic.hpp>
+#include <sno/mpsc_queue.h>
+
+namespace so
+{
+
+/**
+ * @brief A finished log message
+ */
+template<typename C, typename T = std::char_traits<C> >
+struct Log_record
+{
+  /**
+   * @brief Logging level of the message
+   */
+  uint64_t level;
+
+  /**
+   * @brief File to write the message to, empty for the default output
+   */
+  std::string file;
+
+  /**
+   * @brief Formatted message, including the prefix but not the line ending
+   */
+  std::basic_string<C,T> text;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+template<typename C, typename T = std::char_traits<C> >
+class Log_writer
+{
+public:
+  /**
+   * @brief What producers do when the queue is full
+   */
+  enum Full_policy
+  {
+    Block, ///< Wait for the writer thread to make space
+    Drop,  ///< Discard the record and count it
+  };
+
+  /**
+   * @brief Function that writes a single record to the output
+   */
+  typedef std::function<void(const Log_record<C,T>&)> Write_func;
+
+  /**
+   * @brief Function called after each batch of records has been written
+   */
+  typedef std::function<void()> Batch_func;
+
+  /**
+   * @brief Constructor, starts the writer thread
+   * @param write Writes a single record, called from the writer thread only
+   * @param end_batch Called from the writer thread after each batch of
+   * records, e.g. to flush the output
+   * @param capacity Maximum number of queued records
+   * @param policy What to do when the queue is full
+   * @param max_record_size Records longer than this many characters are
+   * truncated
+   */
+  Log_writer(const Write_func& write,
+             const Batch_func& end_batch,
+             const size_t capacity = 8192,
+             const Full_policy policy = Block,
+             const size_t max_record_size = 4096)
+    :
+      m_write(write),
+      m_end_batch(end_batch),
+      m_queue(capacity),
+      m_policy(policy),
+      m_max_record_size(max_record_size),
+      m_running(true),
+      m_in_flight(0),
+      m_sleeping(false),
+      m_flushed(0),
+      m_dropped(0),
+      m_reported_dropped(0),
+      m_wake_mutex(),
+      m_wake(),
+      m_thread()
+  {
+    m_thread = std::thread(&Log_writer::run, this);
+  }
+
+  /**
+   * @brief Destructor, writes all queued records and stops the writer thread
+   */
+  ~Log_writer()
+  {
+    Stop();
+  }
+
+  Log_writer(const Log_writer& other) = delete;
+  Log_writer& operator=(const Log_writer& other) = delete;
+
+  /**
+   * @brief Queue a record. Safe to call from any thread
+   * @param level Logging level of the message
+   * @param file File to write to, empty for the default output
+   * @param text Formatted message
+   * @param len Number of characters in text
+   * @return False if the writer is stopped and the record was not taken.
+   * Records dropped because the queue is full count as taken
+   */
+  bool Push(const uint64_t level,
+            const std::string& file,
+            const C* text,
+            const size_t len)
+  {
+    // The writer thread does not exit while a producer that got past the
+    // running check is still pushing, so a record that is taken is written
+    m_in_flight.fetch_add(1);
+    bool taken = push(level, file, text, len);
+    m_in_flight.fetch_sub(1, boost::memory_order_release);
+    return taken;
+  }
+
+  /**
+   * @brief Block until every record pushed before this call has been written
+   * and the batch function has been called
+   */
+  void Flush()
+  {
+    uint64_t target = m_queue.Get_push_count();
+    while(m_flushed.load(boost::memory_order_acquire) < target)
+    {
+      if(!m_running.load(boost::memory_order_acquire))
+      {
+        // Stop() writes everything that is left
+        return;
+      }
+      wake();
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * @brief Write all queued records and stop the writer thread. Records
+   * pushed after this call are rejected
+   */
+  void Stop()
+  {
+    m_running.store(false);
+    wake();
+    if(m_thread.joinable())
+    {
+      m_thread.join();
+    }
+  }
+
+  /**
+   * @brief Get the number of records dropped because the queue was full
+   * @return Number of dropped records
+   */
+  uint64_t Get_dropped() const
+  {
+    return m_dropped.load(boost::memory_order_relaxed);
+  }
+
+private:
+  //Variables
+  /**
+   * @brief m_write Writes a single record
+   */
+  Write_func m_write;
+
+  /**
+   * @brief m_end_batch Called after each batch
+   */
+  Batch_func m_end_batch;
+
+  /**
+   * @brief m_queue Records waiting to be written
+   */
+  Mpsc_queue<Log_record<C,T> > m_queue;
+
+  /**
+   * @brief m_policy What to do when the queue is full
+   */
+  const Full_policy m_policy;
+
+  /**
+   * @brief m_max_record_size Maximum characters per record
+   */
+  const size_t m_max_record_size;
+
+  /**
+   * @brief m_running False once Stop() has been called
+   */
+  boost::atomic<bool> m_running;
+
+  /**
+   * @brief m_in_flight Number of producers inside Push()
+   */
+  boost::atomic<uint32_t> m_in_flight;
+
+  /**
+   * @brief m_sleeping True while the writer thread is waiting for records
+   */
+  boost::atomic<bool> m_sleeping;
+
+  /**
+   * @brief m_flushed Number of records written and passed through the batch
+   * function
+   */
+  boost::atomic<uint64_t> m_flushed;
+
+  /**
+   * @brief m_dropped Number of records dropped
+   */
+  boost::atomic<uint64_t> m_dropped;
+
+  /**
+   * @brief m_reported_dropped Dropped count at the last report. Writer thread
+   * only
+   */
+  uint64_t m_reported_dropped;
+
+  /**
+   * @brief m_wake_mutex Mutex for m_wake. Never held by producers while they
+   * push
+   */
+  std::mutex m_wake_mutex;
+
+  /**
+   * @brief m_wake Signalled when the writer thread should check the queue
+   */
+  std::condition_variable m_wake;
+
+  /**
+   * @brief m_thread Writer thread
+   */
+  std::thread m_thread;
+
+  //Functions
+  /**
+   * @brief Queue a record, see Push(). The caller counts itself in
+   * m_in_flight first: either it sees m_running cleared here, or the writer
+   * thread sees it in flight and waits for its record
+   */
+  bool push(const uint64_t level,
+            const std::string& file,
+            const C* text,
+            const size_t len)
+  {
+    if(!m_running.load())
+    {
+      return false;
+    }
+    size_t n = std::min(len, m_max_record_size);
+    auto fill = [&](Log_record<C,T>& record)
+    {
+      record.level = level;
+      record.file = file;
+      record.text.assign(text, n);
+    };
+    while(!m_queue.Try_push(fill))
+    {
+      if(m_policy == Drop)
+      {
+        m_dropped.fetch_add(1, boost::memory_order_relaxed);
+        return true;
+      }
+      if(!m_running.load(boost::memory_order_acquire))
+      {
+        return false;
+      }
+      wake();
+      std::this_thread::yield();
+    }
+    if(m_sleeping.load(boost::memory_order_relaxed))
+    {
+      wake();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Wake the writer thread
+   */
+  void wake()
+  {
+    m_wake.notify_one();
+  }
+
+  /**
+   * @brief Write all queued records
+   * @return Number of records written
+   */
+  size_t drain()
+  {
+    size_t n = 0;
+    while(m_queue.Try_pop([this](const Log_record<C,T>& record)
+                          {
+                            m_write(record);
+                          }))
+    {
+      n++;
+    }
+
+    uint64_t dropped = m_dropped.load(boost::memory_order_relaxed);
+    if(dropped != m_reported_dropped)
+    {
+      std::basic_ostringstream<C,T> ss;
+      ss << "WARNING--[so::Log_writer] " << dropped - m_reported_dropped
+         << " log messages dropped, queue full";
+      Log_record<C,T> record{0, std::string(), ss.str()};
+      m_write(record);
+      m_reported_dropped = dropped;
+      n++;
+    }
+    return n;
+  }
+
+  /**
+   * @brief Writer thread main loop
+   */
+  void run()
+  {
+    while(true)
+    {
+      size_t n = drain();
+      uint64_t written = m_queue.Get_pop_count();
+      if(n > 0)
+      {
+        m_end_batch();
+      }
+      m_flushed.store(written, boost::memory_order_release);
+      if(n > 0)
+      {
+        continue;
+      }
+      if(!m_running.load())
+      {
+        // Stop() was called. Finish once no producer is still pushing and a
+        // final pass finds nothing left; a producer that claimed a cell may
+        // not have filled it yet
+        if(m_in_flight.load() == 0
+           && m_queue.Get_pop_count() == m_queue.Get_push_count())
+        {
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+
+      // Nothing to do. Producers only notify while m_sleeping is set, and the
+      // timeout bounds the latency of a missed notification
+      m_sleeping.store(true);
+      if(m_queue.Get_pop_count() == m_queue.Get_push_count())
+      {
+        std::unique_lock<std::mutex> lock(m_wake_mutex);
+        m_wake.wait_for(lock, std::chrono::milliseconds(10));
+      }
+      m_sleeping.store(false);
+    }
+  }
+};
+
+} // namespace so
+
+#endif
@@ -9,9 +9,19 @@
 #ifndef SO_BASIC_LOGGER_H
 #define SO_BASIC_LOGGER_H
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+#include <vector>
 
 #include <boost/atomic.hpp>
 #include <boost/shared_ptr.hpp>
@@ -19,6 +29,15 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/current_function.hpp>
 
+#include <sno/binary_log.h>
+#include <sno/flight_recorder.h>
+#include <sno/log_clock.h>
+#include <sno/log_limiter.h>
+#include <sno/log_sink.h>
+#include <sno/log_writer.h>
+#include <sno/mmap_log_file.h>
+#include <sno/swap_ptr.h>
+
 namespace so
 {
 
@@ -35,6 +54,256 @@ struct Stream_info
 
 //////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @class Log_buffer
+ * @brief Growable stream buffer that log messages are formatted into before
+ * they are written out. Each thread reuses one buffer, so formatting does not
+ * allocate once the buffer has grown to the size of the longest message
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Log_buffer : public std::basic_streambuf<C,T>
+{
+public:
+  typedef typename T::int_type int_type;
+
+  /**
+   * @brief Constructor, a new empty buffer
+   */
+  Log_buffer()
+    :
+      m_data(256),
+      m_stream(this),
+      m_bytes(),
+      m_in_use(false)
+  {
+    Clear();
+  }
+
+  Log_buffer(const Log_buffer& other) = delete;
+  Log_buffer& operator=(const Log_buffer& other) = delete;
+
+  /**
+   * @brief Get the stream that formats into this buffer
+   * @return Output stream
+   */
+  std::basic_ostream<C,T>& Get_stream()
+  {
+    return m_stream;
+  }
+
+  /**
+   * @brief Get the formatted characters
+   * @return Pointer to the first character
+   */
+  const C* Data() const
+  {
+    return this->pbase();
+  }
+
+  /**
+   * @brief Get the number of formatted characters
+   * @return Number of characters
+   */
+  size_t Size() const
+  {
+    return this->pptr() - this->pbase();
+  }
+
+  /**
+   * @brief Get the storage for binary log records
+   * @return Record bytes
+   */
+  std::vector<char>& Get_bytes()
+  {
+    return m_bytes;
+  }
+
+  /**
+   * @brief Discard the contents and reset the stream's formatting state so
+   * that manipulators used in one message do not leak into the next
+   */
+  void Clear()
+  {
+    this->setp(m_data.data(), m_data.data() + m_data.size());
+    m_stream.clear();
+    m_stream.flags(std::ios_base::dec | std::ios_base::skipws);
+    m_stream.precision(6);
+    m_stream.width(0);
+    m_stream.fill(m_stream.widen(' '));
+  }
+
+  /**
+   * @brief Mark the buffer as in use. Call Clear() before formatting into it
+   * @return False if it was already in use, e.g. by a message being
+   * formatted further up the stack
+   */
+  bool Acquire()
+  {
+    if(m_in_use)
+    {
+      return false;
+    }
+    m_in_use = true;
+    return true;
+  }
+
+  /**
+   * @brief Mark the buffer as free
+   */
+  void Release()
+  {
+    m_in_use = false;
+  }
+
+protected:
+  int_type overflow(int_type c) override
+  {
+    if(T::eq_int_type(c, T::eof()))
+    {
+      return T::not_eof(c);
+    }
+    grow(1);
+    *this->pptr() = T::to_char_type(c);
+    this->pbump(1);
+    return c;
+  }
+
+  std::streamsize xsputn(const C* s, std::streamsize n) override
+  {
+    if(this->epptr() - this->pptr() < n)
+    {
+      grow(n);
+    }
+    T::copy(this->pptr(), s, n);
+    this->pbump(static_cast<int>(n));
+    return n;
+  }
+
+private:
+  /**
+   * @brief m_data Storage for the formatted characters
+   */
+  std::vector<C> m_data;
+
+  /**
+   * @brief m_stream Stream that formats into m_data
+   */
+  std::basic_ostream<C,T> m_stream;
+
+  /**
+   * @brief m_bytes Binary record being built, see so::Binary_log
+   */
+  std::vector<char> m_bytes;
+
+  /**
+   * @brief m_in_use True while a message is being formatted
+   */
+  bool m_in_use;
+
+  /**
+   * @brief Make room for at least n more characters
+   */
+  void grow(const std::streamsize n)
+  {
+    size_t used = Size();
+    m_data.resize(std::max(m_data.size() * 2, used + n));
+    this->setp(m_data.data(), m_data.data() + m_data.size());
+    this->pbump(static_cast<int>(used));
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Log_site
+ * @brief Per call site data for log messages. The Log_msg macros create one
+ * static Log_site for each statement, so the scope is parsed out of the
+ * function signature once rather than on every message
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Log_site
+{
+public:
+  /**
+   * @brief Constructor, a new call site
+   * @param function Signature of the enclosing function, as given by
+   * BOOST_CURRENT_FUNCTION
+   */
+  explicit Log_site(const char* function)
+    :
+      m_function(function),
+      m_prefix(),
+      m_binary_id(0)
+  {
+    //Get the scope
+    std::string curr_func(function);
+    size_t args_start = curr_func.find_last_of('(');
+    std::string func_no_args = curr_func.substr(0,args_start);
+    size_t scope_start = func_no_args.find_last_of(' ') + 1;
+    std::string func = func_no_args.substr(scope_start);
+
+    // Inserting the narrow string widens it for wide character sites
+    std::basic_ostringstream<C,T> ss;
+    ss << "[" << func.c_str() << "] ";
+    m_prefix = ss.str();
+  }
+
+  /**
+   * @brief Get the signature of the enclosing function
+   * @return Function signature
+   */
+  const char* Get_function() const
+  {
+    return m_function;
+  }
+
+  /**
+   * @brief Get the scope part of the message prefix
+   * @return '[class::function] '
+   */
+  const std::basic_string<C,T>& Get_prefix() const
+  {
+    return m_prefix;
+  }
+
+  /**
+   * @brief Get the id of this site in the open binary log, registering the
+   * site on first use
+   * @return Site id for so::Binary_log message records
+   */
+  uint32_t Get_binary_id() const
+  {
+    uint64_t generation = Binary_log::Get_generation();
+    uint64_t id = m_binary_id.load(boost::memory_order_relaxed);
+    if((id >> 32) != generation)
+    {
+      // Two threads may both register the site; the decoder accepts either id
+      id = (generation << 32) | Binary_log::Register_site(m_function);
+      m_binary_id.store(id, boost::memory_order_relaxed);
+    }
+    return static_cast<uint32_t>(id);
+  }
+
+private:
+  /**
+   * @brief m_function Signature of the enclosing function
+   */
+  const char* m_function;
+
+  /**
+   * @brief m_prefix Scope part of the message prefix
+   */
+  std::basic_string<C,T> m_prefix;
+
+  /**
+   * @brief m_binary_id Binary log generation in the high 32 bits and the
+   * site's id in that log in the low 32 bits
+   */
+  mutable boost::atomic<uint64_t> m_binary_id;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
 template<typename C = char, typename T = std::char_traits<C> >
 class Basic_logger
 {
@@ -61,6 +330,25 @@ public:
     Fatal     = 0x00000000FF, ///< All Fatal or higher messages
   };
 
+  /**
+   * @brief When an output stream is flushed. Each stream, the main one and
+   * every alternate file, counts its own messages. Messages always go out
+   * when the stream's buffer fills up, on Flush() and at exit
+   */
+  enum Flush_policy
+  {
+    Flush_always,      ///< After every message
+    Flush_every_n,     ///< After every n messages
+    Flush_interval,    ///< At most the interval after a message is written
+    Flush_on_severity, ///< After each Warning, Severe or Fatal message
+    Flush_explicit,    ///< Only when the buffer is full or on Flush()
+  };
+
+  /**
+   * @brief Call site type for this logger
+   */
+  typedef Log_site<C,T> Site;
+
   //Functions
   /**
    * @brief Errlog Log errors
@@ -69,11 +357,44 @@ public:
    */
   Basic_logger(const std::string scope, const Log_level level)
     :
-      m_alt_stream(),
+      m_buffer(nullptr),
+      m_owned_buffer(),
+      m_file(),
+      m_msg_level(level),
+      m_enabled(Is_enabled(level)),
+      m_to_outputs(passes(level, m_logging_mask)),
+      m_binary(false),
+      m_text(false)
+  {
+    if(m_enabled)
+    {
+      write_prefix(Site(scope.c_str()), false);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Errlog Log errors from a call site whose prefix has already been
+   * computed. Used by the Log_msg macros
+   * @param site Call site of the current error log message
+   * @param level Logging level of this message
+   */
+  Basic_logger(const Site& site, const Log_level level)
+    :
+      m_buffer(nullptr),
+      m_owned_buffer(),
+      m_file(),
       m_msg_level(level),
-      m_lock(m_mutex)
+      m_enabled(Is_enabled(level)),
+      m_to_outputs(passes(level, m_logging_mask)),
+      m_binary(false),
+      m_text(false)
   {
-    *m_out_stream << get_msg_prefix(scope);
+    if(m_enabled)
+    {
+      write_prefix(site, true);
+    }
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -89,30 +410,105 @@ public:
                const Log_level level,
                const std::string file)
     :
-      m_alt_stream(new std::ofstream(file, std::ios_base::app)),
+      m_buffer(nullptr),
+      m_owned_buffer(),
+      m_file(file),
+      m_msg_level(level),
+      m_enabled(Is_enabled(level)),
+      m_to_outputs(passes(level, m_logging_mask)),
+      m_binary(false),
+      m_text(false)
+  {
+    if(m_enabled)
+    {
+      write_prefix(Site(scope.c_str()), false);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Errlog Log errors from a call site to a particular file. Used by
+   * the Log_msg macros
+   * @param site Call site of the current error log message
+   * @param level Logging level of this message
+   * @param file Filename to write to
+   */
+  Basic_logger(const Site& site,
+               const Log_level level,
+               const std::string file)
+    :
+      m_buffer(nullptr),
+      m_owned_buffer(),
+      m_file(file),
       m_msg_level(level),
-      m_lock(m_mutex)
+      m_enabled(Is_enabled(level)),
+      m_to_outputs(passes(level, m_logging_mask)),
+      m_binary(false),
+      m_text(false)
   {
-    *m_alt_stream << get_msg_prefix(scope);
+    if(m_enabled)
+    {
+      write_prefix(site, true);
+    }
   }
 
+  Basic_logger(const Basic_logger& other) = delete;
+  Basic_logger& operator=(const Basic_logger& other) = delete;
+
   //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * Destructor
+   * Destructor. Hands the finished message to the binary log and the
+   * registered sinks, or to the asynchronous writer, otherwise writes it out
+   * directly
    */
   ~Basic_logger()
   {
-    //TODO: always flushing the streams could get expensive. Provide a separate
-    // Basic_logger::Flush() function?
-    if(m_alt_stream)
+    if(!m_enabled)
+    {
+      return;
+    }
+    if(m_binary)
+    {
+      Binary_log::Commit(m_buffer->Get_bytes());
+    }
+    else if(passes(m_msg_level, m_recorder_mask))
+    {
+      typename Swap_ptr<const std::shared_ptr<Flight_recorder> >::Reader
+          recorder(recorder_state().current);
+      if(recorder.Get())
+      {
+        (*recorder.Get())->Record(m_buffer->Data(), m_buffer->Size());
+      }
+    }
+    if(!m_to_outputs || !m_text)
+    {
+      m_buffer->Release();
+      return;
+    }
+    if(m_file.empty() && write_to_sinks())
+    {
+      m_buffer->Release();
+      return;
+    }
+    if(m_binary)
     {
-      *m_alt_stream << std::endl;
+      // The binary log takes the place of the main output stream
+      m_buffer->Release();
+      return;
     }
-    else if(m_out_stream)
     {
-      *m_out_stream << std::endl;
+      typename Swap_ptr<Log_writer<C,T> >::Reader writer(async_state().current);
+      if(!writer.Get() || !writer.Get()->Push(m_msg_level, m_file,
+                                              m_buffer->Data(),
+                                              m_buffer->Size()))
+      {
+        boost::mutex::scoped_lock lock(m_mutex);
+        write_unlocked(m_file, m_msg_level, m_buffer->Data(), m_buffer->Size());
+      }
     }
+    m_buffer->Release();
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -123,146 +519,1182 @@ public:
    */
   static void Set_logging_level(const uint64_t mag)
   {
-    boost::mutex::scoped_lock lock(m_mutex);
-    m_logging_mask = mag;
+    m_logging_mask.store(mag, boost::memory_order_relaxed);
+    update_enabled_mask();
   }
 
   //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * @brief Set_log_file Set the log file to write to
-   * @param filename Filename to write to
+   * @brief Check a message level against the union of the logging mask and
+   * the flight recorder's mask. One relaxed atomic load, so it is cheap
+   * enough to guard every log statement (the Log_msg macros do this)
+   * @param level Message level
+   * @return True if messages at this level should be written or recorded
    */
-  static void Set_log_file(std::string filename)
+  static bool Is_enabled(const uint64_t level)
   {
-    boost::mutex::scoped_lock lock(m_mutex);
-    m_out_stream = boost::make_shared<std::ofstream>(filename,
-                                                     std::ios_base::app);
+    return passes(level, m_enabled_mask);
   }
 
   //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * Stream insertion operator.
+   * @brief Keep recent messages in a flight recorder, see
+   * so::Flight_recorder. Messages are recorded on the logging thread, whether
+   * or not they pass the logging mask, so a recorder can hold Debug messages
+   * while only Warning messages are written out. Messages written to the
+   * binary log are not recorded. The logger lets go of a replaced recorder
+   * once no thread is still recording into it
+   * @param recorder Recorder to use, or nullptr to stop recording
+   * @param mask Logging level mask for recorded messages
    */
-  template<class R>
-  Basic_logger& operator<<(const R obj)
+  static void Set_flight_recorder(const std::shared_ptr<Flight_recorder>& recorder,
+                                  const uint64_t mask = Debug)
   {
-    if( (m_msg_level & m_logging_mask) == m_msg_level )
-    {
-      if(m_alt_stream)
-      {
-        *m_alt_stream << obj;
-      }
-      else if(m_out_stream)
-      {
-        *m_out_stream << obj;
-      }
-    }
-    return *this;
+    Recorder_state& state = recorder_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.current.Reset(std::unique_ptr<const std::shared_ptr<Flight_recorder> >(
+                          recorder ? new std::shared_ptr<Flight_recorder>(recorder)
+                                   : nullptr));
+    m_recorder_mask.store(recorder ? mask : 0, boost::memory_order_relaxed);
+    update_enabled_mask();
   }
 
   //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * Stream insertion operator.
+   * @brief Start each message with the time it was logged, see
+   * so::Log_clock::Format(). Off by default. Binary log messages always store
+   * the raw Unix time, read from the chosen clock if it is a wall clock
+   * @param enabled True to add timestamps
+   * @param source Clock to read. The coarse clocks only tick every few
+   * milliseconds but are several times cheaper
    */
-  Basic_logger& operator<<(typename Stream_info<C,T>::StrFunc func)
+  static void Set_timestamp(const bool enabled,
+                            const Log_clock::Source source = Log_clock::Wall)
   {
-    if( (m_msg_level & m_logging_mask) == m_msg_level )
-    {
-      if(m_alt_stream)
-      {
-        func(*m_alt_stream);
-      }
-      else if(m_out_stream)
-      {
-        func(*m_out_stream);
-      }
-    }
-    return *this;
+    m_timestamp_clock.store(enabled ? source : -1, boost::memory_order_relaxed);
   }
 
   //////////////////////////////////////////////////////////////////////////////
 
-private:
-  //Variables
   /**
-   * @brief m_mutex
+   * @brief Set_log_file Set the log file to write to
+   * @param filename Filename to write to
+   * @param buffer_size Size of the file buffer, in characters. When and how
+   * often the buffer is written out is set by Set_flush_policy()
    */
-  static boost::mutex m_mutex;
+  static void Set_log_file(std::string filename,
+                           const size_t buffer_size = 1 << 20)
+  {
+    boost::shared_ptr<std::basic_ostream<C,T> > out =
+        boost::make_shared<Log_file_stream<C,T> >(filename, buffer_size);
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_out_stream = out;
+    flush_state().out = Flush_counter();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * @briefm_loggin_mask  Error logging level mask
+   * @brief Write to a log made of fixed-size memory-mapped segment files,
+   * path.0, path.1, ..., keeping only the newest ones. See so::Mmap_log_file.
+   * Messages are copied straight into the mapped pages, so flushing is free
+   * @param path Base name of the segment files
+   * @param segment_size Size of each segment file in bytes
+   * @param max_old_segments Number of full segments kept besides the one
+   * being written
+   * @throws so::Write_error if the first segment cannot be created
    */
-  static uint64_t m_logging_mask;
+  static void Set_rotating_log_file(const std::string& path,
+                                    const size_t segment_size = 64 << 20,
+                                    const size_t max_old_segments = 8)
+  {
+    boost::shared_ptr<std::basic_ostream<C,T> > out =
+        boost::make_shared<Mmap_log_stream<C,T> >(path,
+                                                  segment_size,
+                                                  max_old_segments);
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_out_stream = out;
+    flush_state().out = Flush_counter();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * @brief m_out_stream Main stream for error logging. Defaults to std::cout
-   * or std::wcout, but can be set to a file
-   * Implemented as a shared pointer so that a new stream can be created when
-   * users call Set_log_file()
+   * @brief Set when the output streams are flushed. The default,
+   * Flush_always, flushes after every message. Flush_interval runs a
+   * background thread that flushes streams left with unwritten messages
+   * @param policy Flush policy
+   * @param every_n Number of messages between flushes for Flush_every_n
+   * @param interval Longest time a message stays buffered for Flush_interval
    */
-  static boost::shared_ptr<std::basic_ostream<C,T> > m_out_stream;
+  static void Set_flush_policy(
+      const Flush_policy policy,
+      const size_t every_n = 64,
+      const std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+  {
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      Flush_state& state = flush_state();
+      state.policy = policy;
+      state.every_n = std::max<size_t>(every_n, 1);
+      state.interval = interval;
+    }
+    // The timer takes m_mutex to flush, so it is started and stopped without it
+    if(policy == Flush_interval)
+    {
+      flush_timer().Start(interval);
+    }
+    else
+    {
+      flush_timer().Stop();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * @brief m_local_stream Alternate stream for writing to a particular file
-   * Implemented as a shared pointer because a null alternate stream indicates
-   * the default should be used
+   * @brief Periodically write one message listing, for each rate limited
+   * statement (Log_msg_every_n, Log_msg_first_n, Log_msg_rate), how many
+   * messages it held back since the last summary. Nothing is written while
+   * nothing is held back. A flood that stops is reported this way even though
+   * no later message from its statement carries the count
+   * @param interval Time between summaries, 0 to stop them
+   * @param level Logging level of the summary
    */
-  boost::shared_ptr<std::basic_ostream<C,T> > m_alt_stream;
+  static void Set_limiter_summary(
+      const std::chrono::milliseconds interval = std::chrono::milliseconds(10000),
+      const Log_level level = Warning)
+  {
+    m_summary_level.store(level, boost::memory_order_relaxed);
+    if(interval.count() > 0)
+    {
+      summary_timer().Start(interval);
+    }
+    else
+    {
+      summary_timer().Stop();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * @brief m_msg_level Logging level of the current message
+   * @brief Write log messages from a background thread. Messages are
+   * formatted by the logging thread and queued; the logging thread never
+   * waits on the output stream. Replaces any running writer
+   * @param capacity Maximum number of queued messages
+   * @param policy Whether to wait or to drop the message when the queue is
+   * full
+   * @param max_record_size Messages longer than this are truncated
    */
-  uint64_t m_msg_level;
+  static void Start_async(
+      const size_t capacity = 8192,
+      const typename Log_writer<C,T>::Full_policy policy = Log_writer<C,T>::Block,
+      const size_t max_record_size = 4096)
+  {
+    Async_state& state = async_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    // The old writer finishes its queue before the new one takes messages
+    state.current.Reset(nullptr);
+    state.current.Reset(std::unique_ptr<Log_writer<C,T> >(
+                          new Log_writer<C,T>(&Basic_logger::write_record,
+                                              []() {},
+                                              capacity,
+                                              policy,
+                                              max_record_size)));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * @brief m_lock Scoped lock, locked when Errlog is instantiated
+   * @brief Write out every queued message, stop the background writer and
+   * return to writing messages directly. Called automatically at exit
    */
-  boost::unique_lock<boost::mutex> m_lock;
+  static void Stop_async()
+  {
+    Async_state& state = async_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.current.Reset(nullptr);
+  }
 
-  //Functions
+  //////////////////////////////////////////////////////////////////////////////
 
   /**
-   * @brief get_msg_prefix Get the start of the log message. The message prefix
-   *  takes the form 'LEVEL--[class::function] '
-   * @param curr_func Current function string
-   * @return String representing the prefix for this log message
+   * @brief Block until every message logged before the call has been written
    */
-  std::string get_msg_prefix(std::string curr_func)
+  static void Flush()
   {
-    std::string err_prefix;
-    //Write the logging level
-    if(m_logging_mask >= 0x0100000000)
+    Binary_log::Flush();
     {
-      err_prefix = "DEBUG--";
+      typename Swap_ptr<const Sink_list>::Reader sinks(sink_state().current);
+      if(sinks.Get())
+      {
+        for(const std::shared_ptr<Sink_entry>& entry : *sinks.Get())
+        {
+          entry->writer->Flush();
+        }
+      }
     }
-    else if(m_logging_mask >= 0x0001000000)
     {
-      err_prefix = "INFO--";
+      typename Swap_ptr<Log_writer<C,T> >::Reader writer(async_state().current);
+      if(writer.Get())
+      {
+        writer.Get()->Flush();
+      }
     }
-    else if(m_logging_mask >= 0x0000010000)
+    boost::mutex::scoped_lock lock(m_mutex);
+    if(m_out_stream)
+    {
+      m_out_stream->flush();
+    }
+    flush_state().out = Flush_counter();
+    for(auto& file : file_cache())
+    {
+      file.second.stream->flush();
+      file.second.counter = Flush_counter();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Write messages to a binary log file instead of formatting them. See
+   * so::Binary_log. The binary log takes the place of the main output stream:
+   * registered sinks still receive every message as text, which is then
+   * formatted as well as encoded, and messages for an alternate file are
+   * still written as text
+   * @param filename File to write, truncated if it exists
+   * @param thread_buffer_size Size of each logging thread's buffer, bytes
+   */
+  static void Set_binary_file(const std::string& filename,
+                              const size_t thread_buffer_size = 1 << 20)
+  {
+    Binary_log::Open(filename, thread_buffer_size);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Close the binary log file and go back to formatting messages
+   */
+  static void Close_binary_file()
+  {
+    Binary_log::Close();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Get the level part of the message prefix
+   * @param level Logging level of the message
+   * @return 'LEVEL--'
+   */
+  static const std::basic_string<C,T>& Get_level_prefix(const uint64_t level)
+  {
+    static const std::basic_string<C,T> prefixes[] =
+    {
+      widen("DEBUG--"),
+      widen("INFO--"),
+      widen("WARNING--"),
+      widen("SEVERE--"),
+      widen("FATAL--"),
+    };
+    if(level >= 0x0100000000)
     {
-      err_prefix = "WARNING--";
+      return prefixes[0];
     }
-    else if(m_logging_mask >= 0x0000000100)
+    else if(level >= 0x0001000000)
     {
-      err_prefix = "SEVERE--";
+      return prefixes[1];
     }
-    else //if(m_logging_mask >= 0x0000000001)
+    else if(level >= 0x0000010000)
     {
-      err_prefix = "FATAL--";
+      return prefixes[2];
     }
+    else if(level >= 0x0000000100)
+    {
+      return prefixes[3];
+    }
+    return prefixes[4];
+  }
 
-    //Get the scope
-    size_t args_start = curr_func.find_last_of('(');
-    std::string func_no_args = curr_func.substr(0,args_start);
-    size_t scope_start = func_no_args.find_last_of(' ') + 1;
-    std::string func = func_no_args.substr(scope_start);
-    err_prefix = err_prefix + "[" + func + "] ";
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Get the number of messages dropped by the background writer
+   * because its queue was full
+   * @return Number of dropped messages, 0 if not running asynchronously
+   */
+  static uint64_t Get_dropped_count()
+  {
+    typename Swap_ptr<Log_writer<C,T> >::Reader writer(async_state().current);
+    return writer.Get() ? writer.Get()->Get_dropped() : 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Register an output. While any sinks are registered, messages go to
+   * every sink whose mask accepts them instead of to the main output stream;
+   * messages for an alternate file are unaffected. Sinks also receive the
+   * messages written to a binary log. Each sink has its own queue and writer
+   * thread. Use the Drop policy for a sink that may fall
+   * behind (e.g. the console) so that it cannot hold up the logging thread
+   * @param sink Sink to add
+   * @param capacity Maximum number of messages queued for the sink
+   * @param policy Whether to wait or to drop the message when the sink's
+   * queue is full
+   * @param max_record_size Messages longer than this are truncated
+   */
+  static void Add_sink(
+      const std::shared_ptr<Log_sink<C,T> >& sink,
+      const size_t capacity = 8192,
+      const typename Log_writer<C,T>::Full_policy policy = Log_writer<C,T>::Block,
+      const size_t max_record_size = 4096)
+  {
+    std::shared_ptr<Sink_entry> entry(new Sink_entry());
+    entry->sink = sink;
+    Log_sink<C,T>* s = sink.get();
+    entry->writer.reset(new Log_writer<C,T>(
+                          [s](const Log_record<C,T>& record) { s->Write(record); },
+                          [s]() { s->End_batch(); },
+                          capacity,
+                          policy,
+                          max_record_size));
+
+    Sink_state& state = sink_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const Sink_list* current = state.current.Get();
+    std::unique_ptr<Sink_list> list(current ? new Sink_list(*current)
+                                            : new Sink_list());
+    list->push_back(entry);
+    state.current.Reset(std::unique_ptr<const Sink_list>(std::move(list)));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Unregister an output after writing the messages queued for it.
+   * Waits for threads still delivering to the old sink list, so it must not
+   * be called from a sink
+   * @param sink Sink to remove
+   */
+  static void Remove_sink(const std::shared_ptr<Log_sink<C,T> >& sink)
+  {
+    Sink_state& state = sink_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const Sink_list* current = state.current.Get();
+    if(!current)
+    {
+      return;
+    }
+    std::unique_ptr<Sink_list> list(new Sink_list());
+    Sink_list removed;
+    for(const std::shared_ptr<Sink_entry>& entry : *current)
+    {
+      (entry->sink == sink ? removed : *list).push_back(entry);
+    }
+    if(list->empty())
+    {
+      list.reset();
+    }
+    state.current.Reset(std::unique_ptr<const Sink_list>(std::move(list)));
+    for(const std::shared_ptr<Sink_entry>& entry : removed)
+    {
+      entry->Stop();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Unregister every output and go back to the main output stream
+   */
+  static void Remove_all_sinks()
+  {
+    Sink_state& state = sink_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const Sink_list* current = state.current.Get();
+    Sink_list removed(current ? *current : Sink_list());
+    state.current.Reset(nullptr);
+    for(const std::shared_ptr<Sink_entry>& entry : removed)
+    {
+      entry->Stop();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Stream insertion operator.
+   */
+  template<class R>
+  Basic_logger& operator<<(const R& obj)
+  {
+    if(m_binary)
+    {
+      Binary_encoder<C,T>::Put(m_buffer->Get_bytes(), obj);
+    }
+    if(m_text)
+    {
+      m_buffer->Get_stream() << obj;
+    }
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Stream insertion operator.
+   */
+  Basic_logger& operator<<(typename Stream_info<C,T>::StrFunc func)
+  {
+    if(m_binary)
+    {
+      // Binary messages keep line breaks but ignore other manipulators
+      if(func == static_cast<typename Stream_info<C,T>::StrFunc>(std::endl))
+      {
+        Binary_encoder<C,T>::Put(m_buffer->Get_bytes(),
+                                 m_buffer->Get_stream().widen('\n'));
+      }
+    }
+    if(m_text)
+    {
+      func(m_buffer->Get_stream());
+    }
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @brief Start the message with the number of messages from the same
+   * statement that its limiter held back. Used by the rate limited Log_msg
+   * macros
+   * @param count Number of messages suppressed, nothing is written if 0
+   */
+  Basic_logger& Note_suppressed(const uint64_t count)
+  {
+    if(count)
+    {
+      *this << "[" << count << " suppressed] ";
+    }
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+
+private:
+  /**
+   * @brief Background writer state. A replaced writer is deleted, writing out
+   * its queue, once no thread can still be pushing to it
+   */
+  struct Async_state
+  {
+    Async_state()
+      :
+        current(),
+        mutex()
+    {
+      // The writers drain into these at exit, so they must be constructed
+      // first to be destroyed last
+      file_cache();
+      flush_state();
+    }
+
+    /**
+     * Destroying current writes out anything still queued
+     */
+    Swap_ptr<Log_writer<C,T> > current;
+    std::mutex mutex;
+  };
+
+  /**
+   * @brief A registered sink and its writer. The writer is destroyed first,
+   * writing out whatever is queued for the sink
+   */
+  struct Sink_entry
+  {
+    /**
+     * @brief Stop the writer after it has written what is queued
+     */
+    void Stop()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      writer->Stop();
+    }
+
+    /**
+     * @brief Write a message straight to the sink, for a message the stopped
+     * writer did not take
+     */
+    void Write_direct(const uint64_t level,
+                      const std::string& file,
+                      const C* text,
+                      const size_t len)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      sink->Write(Log_record<C,T>{level, file,
+                                  std::basic_string<C,T>(text, len)});
+      sink->End_batch();
+    }
+
+    std::shared_ptr<Log_sink<C,T> > sink;
+    std::unique_ptr<Log_writer<C,T> > writer;
+
+    /**
+     * Held while the writer stops and for direct writes, so that the sink is
+     * never written from two threads
+     */
+    std::mutex mutex;
+  };
+
+  typedef std::vector<std::shared_ptr<Sink_entry> > Sink_list;
+
+  /**
+   * @brief Registered sinks. The list is replaced, never modified, when sinks
+   * are added or removed; an old list is deleted once no thread can still be
+   * walking it. Destroying the state writes out anything still queued
+   */
+  struct Sink_state
+  {
+    Swap_ptr<const Sink_list> current;
+    std::mutex mutex;
+  };
+
+  /**
+   * @brief Flight recorder. A replaced recorder is released once no thread
+   * can still be recording into it
+   */
+  struct Recorder_state
+  {
+    Swap_ptr<const std::shared_ptr<Flight_recorder> > current;
+    std::mutex mutex;
+  };
+
+  /**
+   * @brief Messages written to one stream since it was last flushed
+   */
+  struct Flush_counter
+  {
+    Flush_counter()
+      :
+        unflushed(0),
+        last_flush(std::chrono::steady_clock::now())
+    {
+    }
+
+    size_t unflushed;
+    std::chrono::steady_clock::time_point last_flush;
+  };
+
+  /**
+   * @brief An open alternate file
+   */
+  struct Cached_file
+  {
+    std::unique_ptr<Log_file_stream<C,T> > stream;
+    Flush_counter counter;
+  };
+
+  /**
+   * @brief Open alternate files by name. Guarded by m_mutex
+   */
+  typedef std::map<std::string, Cached_file> File_cache;
+
+  /**
+   * @brief Maximum number of alternate files kept open
+   */
+  static const size_t MAX_CACHED_FILES = 64;
+
+  /**
+   * @brief Flush policy, and the progress of m_out_stream. Guarded by m_mutex
+   */
+  struct Flush_state
+  {
+    Flush_state()
+      :
+        policy(Flush_always),
+        every_n(64),
+        interval(1000),
+        out()
+    {
+    }
+
+    Flush_policy policy;
+    size_t every_n;
+    std::chrono::milliseconds interval;
+    Flush_counter out;
+  };
+
+  /**
+   * @brief Background thread that runs a task every interval: flushing, for
+   * Flush_interval, streams whose messages have waited for the interval with
+   * no later message to flush them, or writing the limiter summary
+   */
+  struct Log_timer
+  {
+    /**
+     * @brief Constructor
+     * @param task Run every interval, without any lock held
+     */
+    explicit Log_timer(void (*task)())
+      :
+        task(task),
+        mutex(),
+        wake(),
+        thread(),
+        running(false),
+        interval(1000)
+    {
+      // The tasks write to these, so they must be constructed first to be
+      // destroyed last
+      file_cache();
+      flush_state();
+      async_state();
+      sink_state();
+    }
+
+    ~Log_timer()
+    {
+      Stop();
+    }
+
+    /**
+     * @brief Start the thread, or change its interval if it is running
+     */
+    void Start(const std::chrono::milliseconds new_interval)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      interval = new_interval;
+      if(running)
+      {
+        wake.notify_all();
+        return;
+      }
+      running = true;
+      thread = std::thread(&Log_timer::run, this);
+    }
+
+    /**
+     * @brief Stop the thread and wait for it. The join happens outside the
+     * lock, which the thread needs to finish
+     */
+    void Stop()
+    {
+      std::thread finished;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        finished.swap(thread);
+      }
+      wake.notify_all();
+      if(finished.joinable())
+      {
+        finished.join();
+      }
+    }
+
+    /**
+     * @brief Thread body. The task runs with mutex released, so that it is
+     * never held while the task waits for m_mutex
+     */
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while(running)
+      {
+        wake.wait_for(lock, interval);
+        if(!running)
+        {
+          break;
+        }
+        lock.unlock();
+        task();
+        lock.lock();
+      }
+    }
+
+    void (*const task)();
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    bool running;
+    std::chrono::milliseconds interval;
+  };
+
+  //Variables
+  /**
+   * @brief m_mutex Serializes writes to the output streams
+   */
+  static boost::mutex m_mutex;
+
+  /**
+   * @briefm_loggin_mask  Error logging level mask
+   */
+  static boost::atomic<uint64_t> m_logging_mask;
+
+  /**
+   * @brief m_recorder_mask Flight recorder level mask, 0 if not recording
+   */
+  static boost::atomic<uint64_t> m_recorder_mask;
+
+  /**
+   * @brief m_enabled_mask Union of m_logging_mask and m_recorder_mask
+   */
+  static boost::atomic<uint64_t> m_enabled_mask;
+
+  /**
+   * @brief m_summary_level Logging level of the limiter summary
+   */
+  static boost::atomic<uint64_t> m_summary_level;
+
+  /**
+   * @brief m_timestamp_clock Log_clock::Source for message timestamps, -1
+   * for none
+   */
+  static boost::atomic<int> m_timestamp_clock;
+
+  /**
+   * @brief m_out_stream Main stream for error logging. Defaults to std::cout
+   * or std::wcout, but can be set to a file
+   * Implemented as a shared pointer so that a new stream can be created when
+   * users call Set_log_file()
+   */
+  static boost::shared_ptr<std::basic_ostream<C,T> > m_out_stream;
+
+  /**
+   * @brief m_buffer Buffer the message is formatted into
+   */
+  Log_buffer<C,T>* m_buffer;
+
+  /**
+   * @brief m_owned_buffer Buffer owned by this message, only used when the
+   * thread's buffer is already busy (a message logged while formatting another)
+   */
+  std::unique_ptr<Log_buffer<C,T> > m_owned_buffer;
+
+  /**
+   * @brief m_file Alternate file for this message, empty for m_out_stream
+   */
+  std::string m_file;
+
+  /**
+   * @brief m_msg_level Logging level of the current message
+   */
+  uint64_t m_msg_level;
+
+  /**
+   * @brief m_enabled True if the message level passes the logging mask
+   */
+  bool m_enabled;
+
+  /**
+   * @brief m_to_outputs True if the message level passes the logging mask,
+   * false if the message is only for the flight recorder
+   */
+  bool m_to_outputs;
+
+  /**
+   * @brief m_binary True if the message is being written to the binary log
+   */
+  bool m_binary;
+
+  /**
+   * @brief m_text True if the message is being formatted as text, which a
+   * binary log message only is for the registered sinks
+   */
+  bool m_text;
+
+  //Functions
+  /**
+   * @brief Get the background writer state
+   */
+  static Async_state& async_state()
+  {
+    static Async_state state;
+    return state;
+  }
+
+  /**
+   * @brief Check a message level against a mask
+   */
+  static bool passes(const uint64_t level, const boost::atomic<uint64_t>& mask)
+  {
+    return (level & mask.load(boost::memory_order_relaxed)) == level;
+  }
+
+  /**
+   * @brief Recompute m_enabled_mask after either mask has changed. The last
+   * caller to take the lock has seen both new masks
+   */
+  static void update_enabled_mask()
+  {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    m_enabled_mask.store(m_logging_mask.load(boost::memory_order_relaxed) |
+                         m_recorder_mask.load(boost::memory_order_relaxed),
+                         boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the flight recorder state
+   */
+  static Recorder_state& recorder_state()
+  {
+    static Recorder_state state;
+    return state;
+  }
+
+  /**
+   * @brief Get the registered sinks
+   */
+  static Sink_state& sink_state()
+  {
+    static Sink_state state;
+    return state;
+  }
+
+  /**
+   * @brief Get the open alternate files
+   */
+  static File_cache& file_cache()
+  {
+    static File_cache cache;
+    return cache;
+  }
 
-    return err_prefix;
+  /**
+   * @brief Get an alternate file from the cache, opening it if needed.
+   * m_mutex must be held
+   * @param file File name
+   * @return Stream appending to the file, and its flush counter
+   */
+  static Cached_file& cached_file(const std::string& file)
+  {
+    File_cache& cache = file_cache();
+    auto it = cache.find(file);
+    if(it != cache.end())
+    {
+      return it->second;
+    }
+    if(cache.size() >= MAX_CACHED_FILES)
+    {
+      // Closing flushes each file
+      cache.clear();
+    }
+    Cached_file& out = cache[file];
+    out.stream.reset(new Log_file_stream<C,T>(file, 1 << 16));
+    return out;
+  }
+
+  /**
+   * @brief Get the flush policy state
+   */
+  static Flush_state& flush_state()
+  {
+    static Flush_state state;
+    return state;
+  }
+
+  /**
+   * @brief Get the Flush_interval thread
+   */
+  static Log_timer& flush_timer()
+  {
+    static Log_timer timer(&flush_expired_locked);
+    return timer;
+  }
+
+  /**
+   * @brief Get the limiter summary thread
+   */
+  static Log_timer& summary_timer()
+  {
+    static Log_timer timer(&write_limiter_summary);
+    return timer;
+  }
+
+  /**
+   * @brief Take m_mutex and flush the streams that have waited long enough
+   */
+  static void flush_expired_locked()
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    flush_expired();
+  }
+
+  /**
+   * @brief Write one message listing the messages each rate limited
+   * statement has held back since the last summary, if any have
+   */
+  static void write_limiter_summary()
+  {
+    std::ostringstream summary;
+    Log_limiter::Drain_suppressed(
+          [&summary](const char* file, const int line, const uint64_t count)
+    {
+      summary << (summary.tellp() > 0 ? ", " : "")
+              << file << ":" << line << " " << count;
+    });
+    if(summary.tellp() > 0)
+    {
+      Log_level level =
+          static_cast<Log_level>(m_summary_level.load(boost::memory_order_relaxed));
+      if(Is_enabled(level))
+      {
+        Basic_logger(std::string("Log_limiter"), level)
+            << "Suppressed messages: " << summary.str().c_str();
+      }
+    }
+  }
+
+  /**
+   * @brief Count a message written to a stream and decide whether the stream
+   * should be flushed now. m_mutex must be held
+   * @param level Logging level of the message
+   * @param counter The stream's flush counter
+   * @return True to flush
+   */
+  static bool should_flush(const uint64_t level, Flush_counter& counter)
+  {
+    Flush_state& state = flush_state();
+    counter.unflushed++;
+    bool flush = false;
+    switch(state.policy)
+    {
+      case Flush_always:
+        flush = true;
+        break;
+      case Flush_every_n:
+        flush = counter.unflushed >= state.every_n;
+        break;
+      case Flush_interval:
+        flush = std::chrono::steady_clock::now() - counter.last_flush
+            >= state.interval;
+        break;
+      case Flush_on_severity:
+        flush = level <= Warning;
+        break;
+      case Flush_explicit:
+        break;
+    }
+    if(flush)
+    {
+      counter = Flush_counter();
+    }
+    return flush;
+  }
+
+  /**
+   * @brief Flush every stream holding messages written at least the flush
+   * interval ago. m_mutex must be held
+   */
+  static void flush_expired()
+  {
+    Flush_state& state = flush_state();
+    if(state.policy != Flush_interval)
+    {
+      return;
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(m_out_stream && state.out.unflushed > 0
+       && now - state.out.last_flush >= state.interval)
+    {
+      m_out_stream->flush();
+      state.out = Flush_counter();
+    }
+    for(auto& file : file_cache())
+    {
+      if(file.second.counter.unflushed > 0
+         && now - file.second.counter.last_flush >= state.interval)
+      {
+        file.second.stream->flush();
+        file.second.counter = Flush_counter();
+      }
+    }
+  }
+
+  /**
+   * @brief Hand the message to every registered sink that accepts it. A sink
+   * whose writer has been stopped is written directly
+   * @return False if no sinks are registered
+   */
+  bool write_to_sinks()
+  {
+    typename Swap_ptr<const Sink_list>::Reader sinks(sink_state().current);
+    if(!sinks.Get())
+    {
+      return false;
+    }
+    for(const std::shared_ptr<Sink_entry>& entry : *sinks.Get())
+    {
+      if(entry->sink->Is_enabled(m_msg_level)
+         && !entry->writer->Push(m_msg_level, m_file,
+                                 m_buffer->Data(), m_buffer->Size()))
+      {
+        entry->Write_direct(m_msg_level, m_file,
+                            m_buffer->Data(), m_buffer->Size());
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Point m_buffer at this thread's buffer, or at a buffer of our own
+   * if the thread's buffer is in use
+   */
+  void acquire_buffer()
+  {
+    thread_local Log_buffer<C,T> buffer;
+    if(buffer.Acquire())
+    {
+      m_buffer = &buffer;
+    }
+    else
+    {
+      m_owned_buffer.reset(new Log_buffer<C,T>());
+      m_owned_buffer->Acquire();
+      m_buffer = m_owned_buffer.get();
+    }
+  }
+
+  /**
+   * @brief Write a finished record. Called from the background writer
+   * @param record Record to write
+   */
+  static void write_record(const Log_record<C,T>& record)
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    write_unlocked(record.file,
+                   record.level,
+                   record.text.data(),
+                   record.text.size());
+  }
+
+  /**
+   * @brief Write a message to its output and end the line. Alternate files
+   * are kept open between messages, and outputs are flushed according to the
+   * flush policy. m_mutex must be held
+   * @param file Alternate file, empty to use m_out_stream
+   * @param level Logging level of the message
+   * @param text Formatted message
+   * @param len Number of characters in text
+   */
+  static void write_unlocked(const std::string& file,
+                             const uint64_t level,
+                             const C* text,
+                             const size_t len)
+  {
+    std::basic_ostream<C,T>* out = m_out_stream.get();
+    Flush_counter* counter = &flush_state().out;
+    if(!file.empty())
+    {
+      Cached_file& cached = cached_file(file);
+      out = cached.stream.get();
+      counter = &cached.counter;
+    }
+    if(out)
+    {
+      out->write(text, len);
+      out->put(out->widen('\n'));
+      if(should_flush(level, *counter))
+      {
+        out->flush();
+      }
+    }
+  }
+
+  /**
+   * @brief Write the current time to the message
+   * @param source Clock to read
+   */
+  void write_timestamp(const Log_clock::Source source)
+  {
+    char text[Log_clock::MAX_TEXT];
+    size_t len = Log_clock::Format(source, Log_clock::Now(source), text);
+    // The text is ASCII, so widening is a plain copy
+    C widened[Log_clock::MAX_TEXT];
+    std::copy(text, text + len, widened);
+    m_buffer->Get_stream().write(widened, len);
+  }
+
+  /**
+   * @brief Widen a narrow string literal to the logger's character type
+   */
+  static std::basic_string<C,T> widen(const char* s)
+  {
+    std::basic_ostringstream<C,T> ss;
+    ss << s;
+    return ss.str();
+  }
+
+  /**
+   * @brief Start the message. The message prefix takes the form
+   * '[timestamp ]LEVEL--[class::function] '. The level and scope are
+   * precomputed and the timestamp is formatted on the stack, so writing the
+   * prefix does not allocate. Binary messages store the raw time and the site
+   * id instead, or the scope itself for a site that only lives as long as the
+   * message
+   * @param site Call site of the message
+   * @param is_static True if the site outlives the message (the Log_msg
+   * macros), so it can be registered with the binary log
+   */
+  void write_prefix(const Site& site, const bool is_static)
+  {
+    acquire_buffer();
+    int clock = m_timestamp_clock.load(boost::memory_order_relaxed);
+    if(m_to_outputs && m_file.empty() && Binary_log::Is_open())
+    {
+      m_binary = true;
+      std::vector<char>& bytes = m_buffer->Get_bytes();
+      Log_clock::Source source =
+          clock >= 0 && Log_clock::Is_wall(static_cast<Log_clock::Source>(clock))
+          ? static_cast<Log_clock::Source>(clock) : Log_clock::Wall;
+      int64_t ns = Log_clock::Now(source);
+      if(is_static)
+      {
+        Binary_log::Begin_message(bytes, site.Get_binary_id(), m_msg_level, ns);
+      }
+      else
+      {
+        Binary_log::Begin_message(bytes, 0, m_msg_level, ns);
+        Binary_encoder<C,T>::Put(bytes, site.Get_function());
+      }
+      // Registered sinks still get the message as text
+      if(!sink_state().current.Get())
+      {
+        return;
+      }
+    }
+    m_text = true;
+    m_buffer->Clear();
+    if(clock >= 0)
+    {
+      write_timestamp(static_cast<Log_clock::Source>(clock));
+    }
+    const std::basic_string<C,T>& level = Get_level_prefix(m_msg_level);
+    m_buffer->Get_stream().write(level.data(), level.size());
+    m_buffer->Get_stream().write(site.Get_prefix().data(),
+                                 site.Get_prefix().size());
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Used by the logging macros to turn a whole log statement into a void
+ * expression. operator& binds more loosely than operator<<, so every insertion
+ * in the statement happens first
+ */
+struct Log_voidify
+{
+  template<typename C, typename T>
+  void operator&(const Basic_logger<C,T>&) const
+  {
   }
 };
 
@@ -281,15 +1713,117 @@ boost::mutex so::Basic_logger<C, T>::m_mutex;
 
 
 template<typename C, typename T>
-uint64_t so::Basic_logger<C ,T>::m_logging_mask(Basic_logger<C,T>::Debug);
+boost::atomic<uint64_t> so::Basic_logger<C ,T>::m_logging_mask(Basic_logger<C,T>::Debug);
+
+template<typename C, typename T>
+boost::atomic<uint64_t> so::Basic_logger<C ,T>::m_recorder_mask(0);
+
+template<typename C, typename T>
+boost::atomic<uint64_t> so::Basic_logger<C ,T>::m_enabled_mask(Basic_logger<C,T>::Debug);
+
+template<typename C, typename T>
+boost::atomic<uint64_t> so::Basic_logger<C ,T>::m_summary_level(Basic_logger<C,T>::Warning);
+
+template<typename C, typename T>
+boost::atomic<int> so::Basic_logger<C ,T>::m_timestamp_clock(-1);
 
 template<typename C,typename T>
 boost::shared_ptr<std::basic_ostream<C,T> > so::Basic_logger<C,T>::m_out_stream(so::Stream_info<C,T>::Get_default());
 
+//////////////////////////////////////////////////////////////////////////////
+// Compile time logging mask. Log statements whose level does not pass this
+// mask are compiled out entirely. Define SO_LOG_MIN_LEVEL before including
+// this header (or on the command line), e.g.
+// -DSO_LOG_MIN_LEVEL=SO_LOG_LEVEL_INFO to remove every Debug statement
+#define SO_LOG_LEVEL_DEBUG   0xFFFFFFFFFF
+#define SO_LOG_LEVEL_INFO    0x00FFFFFFFF
+#define SO_LOG_LEVEL_WARNING 0x0000FFFFFF
+#define SO_LOG_LEVEL_SEVERE  0x000000FFFF
+#define SO_LOG_LEVEL_FATAL   0x00000000FF
+
+#ifndef SO_LOG_MIN_LEVEL
+#define SO_LOG_MIN_LEVEL SO_LOG_LEVEL_DEBUG
+#endif
+
+#define SO_LOG_COMPILED_IN(level) \
+  ((static_cast<uint64_t>(level) & static_cast<uint64_t>(SO_LOG_MIN_LEVEL)) \
+   == static_cast<uint64_t>(level))
+
+#define SO_LOG_FIRST_ARG(first, ...) first
+
+// The call site of a log statement. Every lambda expression has its own type,
+// so the static inside is created once per statement (and per instantiation
+// of an enclosing template)
+#define SO_LOG_SITE(logger_type) \
+  [](const char* so_log_function) -> const logger_type::Site& \
+  { \
+    static const logger_type::Site so_log_site(so_log_function); \
+    return so_log_site; \
+  }(BOOST_CURRENT_FUNCTION)
+
+// A disabled statement costs one relaxed load and a branch; the message is
+// never constructed and the insertion arguments are never evaluated
+#define SO_LOG_STATEMENT(logger_type, ...) \
+  !(SO_LOG_COMPILED_IN(SO_LOG_FIRST_ARG(__VA_ARGS__, 0)) \
+    && logger_type::Is_enabled(SO_LOG_FIRST_ARG(__VA_ARGS__, 0))) \
+  ? (void)0 \
+  : so::Log_voidify() & logger_type(SO_LOG_SITE(logger_type), __VA_ARGS__)
+
+// The limiter of a log statement, created on first use from the arguments
+#define SO_LOG_LIMITER(...) \
+  [&]() -> so::Log_limiter& \
+  { \
+    static so::Log_limiter so_log_limiter(__FILE__, __LINE__, __VA_ARGS__); \
+    return so_log_limiter; \
+  }()
+
+// A log statement that its limiter may hold back. The limiter only sees
+// messages whose level is enabled. Written as a loop that runs at most once
+// so that it has no else to bind to, which makes it a statement rather than
+// an expression
+#define SO_LOG_LIMITED_STATEMENT(logger_type, limiter, ...) \
+  for(uint64_t so_log_suppressed = 0, \
+        so_log_once = SO_LOG_COMPILED_IN(SO_LOG_FIRST_ARG(__VA_ARGS__, 0)) \
+          && logger_type::Is_enabled(SO_LOG_FIRST_ARG(__VA_ARGS__, 0)) \
+          && limiter.Allow(so_log_suppressed); \
+      so_log_once; \
+      so_log_once = 0) \
+    so::Log_voidify() & logger_type(SO_LOG_SITE(logger_type), __VA_ARGS__) \
+                          .Note_suppressed(so_log_suppressed)
+
 //////////////////////////////////////////////////////////////////////////////
 //Macros to automatically insert scope
-#define Log_msg(...) Logger(BOOST_CURRENT_FUNCTION,__VA_ARGS__)
-#define Log_wmsg(...) WLogger(BOOST_CURRENT_FUNCTION,__VA_ARGS__)
+#define Log_msg(...) SO_LOG_STATEMENT(so::Logger, __VA_ARGS__)
+#define Log_wmsg(...) SO_LOG_STATEMENT(so::WLogger, __VA_ARGS__)
+
+// Rate limited variants for statements that may fire in floods. Each message
+// that gets through starts with the number held back before it, e.g.
+//   Log_msg_every_n(1000, so::Logger::Warning) << "Bad sample " << i;
+// The limit parameters are read the first time the statement runs
+#define Log_msg_every_n(n, ...) \
+  SO_LOG_LIMITED_STATEMENT(so::Logger, \
+                           SO_LOG_LIMITER(so::Log_limiter::Every_n, n), \
+                           __VA_ARGS__)
+#define Log_msg_first_n(n, then_every_m, ...) \
+  SO_LOG_LIMITED_STATEMENT(so::Logger, \
+                           SO_LOG_LIMITER(so::Log_limiter::First_n, n, then_every_m), \
+                           __VA_ARGS__)
+#define Log_msg_rate(per_second, burst, ...) \
+  SO_LOG_LIMITED_STATEMENT(so::Logger, \
+                           SO_LOG_LIMITER(so::Log_limiter::Rate, per_second, burst), \
+                           __VA_ARGS__)
+#define Log_wmsg_every_n(n, ...) \
+  SO_LOG_LIMITED_STATEMENT(so::WLogger, \
+                           SO_LOG_LIMITER(so::Log_limiter::Every_n, n), \
+                           __VA_ARGS__)
+#define Log_wmsg_first_n(n, then_every_m, ...) \
+  SO_LOG_LIMITED_STATEMENT(so::WLogger, \
+                           SO_LOG_LIMITER(so::Log_limiter::First_n, n, then_every_m), \
+                           __VA_ARGS__)
+#define Log_wmsg_rate(per_second, burst, ...) \
+  SO_LOG_LIMITED_STATEMENT(so::WLogger, \
+                           SO_LOG_LIMITER(so::Log_limiter::Rate, per_second, burst), \
+                           __VA_ARGS__)
 
 //////////////////////////////////////////////////////////////////////////////
 
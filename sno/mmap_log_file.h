@@ -0,0 +1,348 @@
+/**
+ * @class Mmap_log_file
+ * @brief Log file made of fixed-size, preallocated, memory-mapped segments.
+ *
+ * Segments are named '<path>.<n>' with n counting up. A background thread
+ * creates and maps the next segment before it is needed, and unmaps, trims
+ * and deletes old segments, so switching segments is a pointer swap for the
+ * writer. Only the newest max_old_segments full segments are kept. Segment
+ * numbering continues from the files already on disk.
+ *
+ * A segment is full size until it is closed and trimmed to the bytes written,
+ * so after a crash the newest segment ends in zero bytes. Because the process
+ * never renames its files, external tools should not rotate them either.
+ */
+
+#ifndef SO_MMAP_LOG_FILE_H
+#define SO_MMAP_LOG_FILE_H
+
+#include <limits.h>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace so
+{
+
+class Mmap_log_file_impl;
+
+class Mmap_log_file
+{
+public:
+  /**
+   * @brief Constructor, creates and maps the first segment
+   * @param path Segment file names are path.0, path.1, ...
+   * @param segment_size Size of each segment in bytes, rounded up to a whole
+   * number of pages
+   * @param max_old_segments Number of full segments kept besides the one
+   * being written
+   * @throws so::Write_error if the first segment cannot be created
+   */
+  Mmap_log_file(const std::string& path,
+                const size_t segment_size,
+                const size_t max_old_segments);
+
+  /**
+   * @brief Destructor, closes the file if Close() has not been called
+   */
+  ~Mmap_log_file();
+
+  Mmap_log_file(const Mmap_log_file& other) = delete;
+  Mmap_log_file& operator=(const Mmap_log_file& other) = delete;
+
+  /**
+   * @brief Get the mapped memory of the segment being written
+   * @return First byte of the segment
+   */
+  char* Get_data() const;
+
+  /**
+   * @brief Get the size of each segment
+   * @return Segment size in bytes
+   */
+  size_t Get_size() const;
+
+  /**
+   * @brief Get the file name of the segment being written
+   * @return Segment file name
+   */
+  std::string Get_current_path() const;
+
+  /**
+   * @brief Switch to the next segment. The current segment is trimmed to the
+   * bytes used and unmapped in the background, so its memory must not be
+   * touched after this call. Only waits if the background thread has not yet
+   * finished preparing the next segment
+   * @param used Number of bytes written to the current segment
+   * @return False if the next segment could not be created
+   */
+  bool Rotate(const size_t used);
+
+  /**
+   * @brief Trim the current segment to the bytes used and close the file
+   * @param used Number of bytes written to the current segment
+   */
+  void Close(const size_t used);
+
+private:
+  /**
+   * @brief m_pimpl Implementation class
+   */
+  std::unique_ptr<Mmap_log_file_impl> m_pimpl;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Mmap_log_streambuf
+ * @brief Stream buffer whose put area is the mapped segment of an
+ * Mmap_log_file, so characters are written straight into the file's pages.
+ * When a segment fills up, its unfinished last line is carried over to the
+ * next segment so that no line is split between files. Characters are stored
+ * in their in-memory representation (UTF-32 for wchar_t on Linux).
+ *
+ * If the next segment cannot be created (e.g. the disk is full), the stream
+ * does not fail: characters are dropped into a small scratch area, and the
+ * switch is tried again each time that fills up. The first segment after
+ * the failure starts with a line giving the number of characters dropped
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Mmap_log_streambuf : public std::basic_streambuf<C,T>
+{
+public:
+  typedef typename T::int_type int_type;
+
+  /**
+   * @brief Constructor, see Mmap_log_file
+   */
+  Mmap_log_streambuf(const std::string& path,
+                     const size_t segment_size,
+                     const size_t max_old_segments)
+    :
+      m_file(path, segment_size, max_old_segments),
+      m_begin(nullptr),
+      m_scratch(4096),
+      m_dropping(false),
+      m_segment_used(0),
+      m_dropped(0)
+  {
+    start_segment();
+  }
+
+  /**
+   * @brief Destructor, trims and closes the current segment
+   */
+  ~Mmap_log_streambuf()
+  {
+    m_file.Close(used());
+  }
+
+  Mmap_log_streambuf(const Mmap_log_streambuf& other) = delete;
+  Mmap_log_streambuf& operator=(const Mmap_log_streambuf& other) = delete;
+
+  /**
+   * @brief Get the file name of the segment being written
+   * @return Segment file name
+   */
+  std::string Get_current_path() const
+  {
+    return m_file.Get_current_path();
+  }
+
+protected:
+  int_type overflow(int_type c) override
+  {
+    if(T::eq_int_type(c, T::eof()))
+    {
+      return T::not_eof(c);
+    }
+    // There is room afterwards, in the next segment or the scratch area
+    rotate();
+    *this->pptr() = T::to_char_type(c);
+    this->pbump(1);
+    return c;
+  }
+
+  std::streamsize xsputn(const C* s, std::streamsize n) override
+  {
+    std::streamsize done = 0;
+    while(done < n)
+    {
+      std::streamsize avail = this->epptr() - this->pptr();
+      if(avail == 0)
+      {
+        rotate();
+        continue;
+      }
+      std::streamsize k = std::min<std::streamsize>(
+            std::min(avail, n - done), INT_MAX);
+      T::copy(this->pptr(), s + done, k);
+      this->pbump(static_cast<int>(k));
+      done += k;
+    }
+    return n;
+  }
+
+  int sync() override
+  {
+    // Characters are already in the page cache
+    return 0;
+  }
+
+private:
+  /**
+   * @brief m_file Segments
+   */
+  Mmap_log_file m_file;
+
+  /**
+   * @brief m_begin First character of the current segment
+   */
+  C* m_begin;
+
+  /**
+   * @brief m_scratch Put area while no segment can be written
+   */
+  std::vector<C> m_scratch;
+
+  /**
+   * @brief m_dropping True while writing to m_scratch
+   */
+  bool m_dropping;
+
+  /**
+   * @brief m_segment_used Bytes kept in the current segment, while dropping
+   */
+  size_t m_segment_used;
+
+  /**
+   * @brief m_dropped Characters dropped since the last segment switch failed
+   */
+  uint64_t m_dropped;
+
+  /**
+   * @brief Bytes written to the current segment
+   */
+  size_t used() const
+  {
+    return m_dropping ? m_segment_used : (this->pptr() - m_begin) * sizeof(C);
+  }
+
+  /**
+   * @brief Point the put area at the current segment
+   */
+  void start_segment()
+  {
+    m_begin = reinterpret_cast<C*>(m_file.Get_data());
+    this->setp(m_begin, m_begin + m_file.Get_size() / sizeof(C));
+  }
+
+  /**
+   * @brief Move to the next segment, carrying the unfinished line with us.
+   * If the next segment cannot be created, point the put area at m_scratch
+   * instead and count what is written there as dropped
+   */
+  void rotate()
+  {
+    if(m_dropping)
+    {
+      m_dropped += this->pptr() - this->pbase();
+      if(!m_file.Rotate(m_segment_used))
+      {
+        this->setp(m_scratch.data(), m_scratch.data() + m_scratch.size());
+        return;
+      }
+      m_dropping = false;
+      start_segment();
+      note_dropped();
+      return;
+    }
+
+    C* end = this->pptr();
+    C* line = end;
+    while(line > m_begin && !T::eq(line[-1], static_cast<C>('\n')))
+    {
+      line--;
+    }
+    if(line == m_begin)
+    {
+      // A single line longer than a segment has to be split
+      line = end;
+    }
+    std::vector<C> carry(line, end);
+    if(!m_file.Rotate((line - m_begin) * sizeof(C)))
+    {
+      // Keep the segment up to its last full line and retry once the scratch
+      // area fills up
+      m_dropping = true;
+      m_segment_used = (line - m_begin) * sizeof(C);
+      m_dropped = carry.size();
+      this->setp(m_scratch.data(), m_scratch.data() + m_scratch.size());
+      return;
+    }
+    start_segment();
+    T::copy(this->pptr(), carry.data(), carry.size());
+    this->pbump(static_cast<int>(carry.size()));
+  }
+
+  /**
+   * @brief Start the segment with a line giving the number of characters
+   * dropped
+   */
+  void note_dropped()
+  {
+    std::string note = "[" + std::to_string(m_dropped)
+        + " characters dropped: could not create a log segment]\n";
+    // The text is ASCII, so widening is a plain copy
+    std::copy(note.begin(), note.end(), this->pptr());
+    this->pbump(static_cast<int>(note.size()));
+    m_dropped = 0;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Mmap_log_stream
+ * @brief Output stream writing to an Mmap_log_streambuf
+ */
+template<typename C, typename T = std::char_traits<C> >
+class Mmap_log_stream : public std::basic_ostream<C,T>
+{
+public:
+  /**
+   * @brief Constructor, see Mmap_log_file
+   */
+  Mmap_log_stream(const std::string& path,
+                  const size_t segment_size,
+                  const size_t max_old_segments)
+    :
+      std::basic_ostream<C,T>(nullptr),
+      m_buffer(path, segment_size, max_old_segments)
+  {
+    this->rdbuf(&m_buffer);
+  }
+
+  /**
+   * @brief Get the file name of the segment being written
+   * @return Segment file name
+   */
+  std::string Get_current_path() const
+  {
+    return m_buffer.Get_current_path();
+  }
+
+private:
+  /**
+   * @brief m_buffer Stream buffer
+   */
+  Mmap_log_streambuf<C,T> m_buffer;
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * @class Mpsc_queue
+ * @brief Bounded lock-free multi-producer, single-consumer queue.
+ *
+ * Based on Dmitry Vyukov's bounded queue: every cell carries a sequence number
+ * that tells producers and the consumer whether it is free or full, so neither
+ * side takes a lock. Values are written and read in place; cells are reused,
+ * so a value type that owns storage (e.g. std::string) keeps its capacity
+ * between uses.
+ */
+
+#ifndef SO_MPSC_QUEUE_H
+#define SO_MPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <boost/atomic.hpp>
+
+namespace so
+{
+
+template<class V>
+class Mpsc_queue
+{
+public:
+  /**
+   * @brief Constructor, a new empty queue
+   * @param capacity Maximum number of values in the queue. Rounded up to the
+   * next power of two
+   */
+  explicit Mpsc_queue(const size_t capacity)
+    :
+      m_mask(round_up(capacity) - 1),
+      m_cells(new Cell[m_mask + 1]),
+      m_push_pos(0),
+      m_pop_pos(0)
+  {
+    for(size_t i = 0; i <= m_mask; i++)
+    {
+      m_cells[i].seq.store(i, boost::memory_order_relaxed);
+    }
+  }
+
+  Mpsc_queue(const Mpsc_queue& other) = delete;
+  Mpsc_queue& operator=(const Mpsc_queue& other) = delete;
+
+  /**
+   * @brief Try to add a value to the queue. Safe to call from any number of
+   * threads
+   * @param fill Called with a reference to the claimed cell's value, which it
+   * should overwrite
+   * @return False if the queue is full, in which case fill is not called
+   */
+  template<class F>
+  bool Try_push(F&& fill)
+  {
+    uint64_t pos = m_push_pos.load(boost::memory_order_relaxed);
+    Cell* cell;
+    while(true)
+    {
+      cell = &m_cells[pos & m_mask];
+      uint64_t seq = cell->seq.load(boost::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+      if(diff == 0)
+      {
+        if(m_push_pos.compare_exchange_weak(pos, pos + 1,
+                                            boost::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if(diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = m_push_pos.load(boost::memory_order_relaxed);
+      }
+    }
+    fill(cell->value);
+    cell->seq.store(pos + 1, boost::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Try to remove the oldest value from the queue. Must only be called
+   * from one thread at a time
+   * @param consume Called with a reference to the oldest value. The cell is
+   * released once consume returns
+   * @return False if the queue is empty (or the oldest value is still being
+   * written), in which case consume is not called
+   */
+  template<class F>
+  bool Try_pop(F&& consume)
+  {
+    uint64_t pos = m_pop_pos.load(boost::memory_order_relaxed);
+    Cell* cell = &m_cells[pos & m_mask];
+    uint64_t seq = cell->seq.load(boost::memory_order_acquire);
+    if(seq != pos + 1)
+    {
+      return false;
+    }
+    consume(cell->value);
+    cell->seq.store(pos + m_mask + 1, boost::memory_order_release);
+    m_pop_pos.store(pos + 1, boost::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Get the number of values ever claimed by producers
+   * @return Number of successful Try_push() calls started
+   */
+  uint64_t Get_push_count() const
+  {
+    return m_push_pos.load(boost::memory_order_acquire);
+  }
+
+  /**
+   * @brief Get the number of values ever consumed
+   * @return Number of successful Try_pop() calls completed
+   */
+  uint64_t Get_pop_count() const
+  {
+    return m_pop_pos.load(boost::memory_order_acquire);
+  }
+
+  /**
+   * @brief Get the capacity of the queue
+   * @return Maximum number of values in the queue
+   */
+  size_t Get_capacity() const
+  {
+    return m_mask + 1;
+  }
+
+private:
+  /**
+   * @brief A value and the sequence number that says who owns it
+   */
+  struct Cell
+  {
+    boost::atomic<uint64_t> seq;
+    V value;
+  };
+
+  /**
+   * @brief Round up to a power of two, minimum 2
+   */
+  static size_t round_up(const size_t n)
+  {
+    size_t p = 2;
+    while(p < n)
+    {
+      p <<= 1;
+    }
+    return p;
+  }
+
+  /**
+   * @brief m_mask Capacity - 1, used to wrap positions onto cells
+   */
+  const size_t m_mask;
+
+  /**
+   * @brief m_cells Storage
+   */
+  std::unique_ptr<Cell[]> m_cells;
+
+  // Producer and consumer positions live on separate cache lines so the
+  // consumer does not slow producers down
+  char m_pad_0[64];
+
+  /**
+   * @brief m_push_pos Next position to be claimed by a producer
+   */
+  boost::atomic<uint64_t> m_push_pos;
+
+  char m_pad_1[64];
+
+  /**
+   * @brief m_pop_pos Next position to be consumed
+   */
+  boost::atomic<uint64_t> m_pop_pos;
+
+  char m_pad_2[64];
+};
+
+} // namespace so
+
+#endif
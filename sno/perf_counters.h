@@ -0,0 +1,168 @@
+/**
+ * @class Perf_counters
+ * @brief Hardware and software event counters around timed scopes, read
+ * with Linux perf_event_open().
+ *
+ * Each thread opens one counter group the first time it reads the counters,
+ * so a read is a single read() system call. Each so::Perf_scope reads the
+ * counters and the time when it starts and ends, and adds the difference to
+ * the totals of its name. Perf_counters::Write_report() prints the totals
+ * with the elapsed time of each scope.
+ *
+ * Counters the system does not provide, e.g. hardware counters in most
+ * containers and virtual machines or everything when perf_event_paranoid
+ * forbids it, are reported as unavailable (-1) and the elapsed time is still
+ * measured. Counts are scaled when the kernel had to multiplex the counters.
+ *
+ * Reading the counters costs a system call, on the order of a microsecond,
+ * so use scopes around sections that run for much longer than that, and
+ * so::Profile_zone for short ones.
+ */
+
+#ifndef SO_PERF_COUNTERS_H
+#define SO_PERF_COUNTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace so
+{
+
+/**
+ * @brief Counter readings, or differences between two readings
+ */
+struct Perf_values
+{
+  /**
+   * @brief Counted events
+   */
+  enum Event
+  {
+    Cycles,
+    Instructions,
+    Cache_misses,
+    Branch_misses,
+    Context_switches,
+    Page_faults,
+    NUM_EVENTS
+  };
+
+  int64_t elapsed_ns;         ///< CLOCK_MONOTONIC time, nanoseconds
+  int64_t counts[NUM_EVENTS]; ///< Event counts, -1 if unavailable
+};
+
+/**
+ * @brief Totals of one scope name
+ */
+struct Perf_scope_stats
+{
+  std::string name;
+  uint64_t count;     ///< Number of times the scope ran
+  Perf_values totals; ///< Sum of the differences
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+class Perf_counters
+{
+public:
+  /**
+   * @brief Get the name of an event, as perf stat prints it
+   */
+  static const char* Get_event_name(const Perf_values::Event event);
+
+  /**
+   * @brief Check whether an event can be counted on the calling thread
+   */
+  static bool Is_available(const Perf_values::Event event);
+
+  /**
+   * @brief Read the calling thread's counters and the time
+   * @return Counts since the thread first read them, -1 for unavailable
+   * events
+   */
+  static Perf_values Read();
+
+  /**
+   * @brief Get the difference between two readings. Unavailable counts stay
+   * -1
+   */
+  static Perf_values Difference(const Perf_values& start,
+                                const Perf_values& end);
+
+  /**
+   * @brief Add the difference between two readings to the totals of a scope
+   * name for the calling thread
+   * @param name Scope name
+   * @param start Reading at the start of the scope
+   * @param end Reading at the end of the scope
+   */
+  static void Record(const std::string& name,
+                     const Perf_values& start,
+                     const Perf_values& end);
+
+  /**
+   * @brief Sum the totals of every thread by scope name
+   * @return One entry per scope name, largest elapsed time first
+   */
+  static std::vector<Perf_scope_stats> Get_stats();
+
+  /**
+   * @brief Write a table of the totals of every scope: runs, elapsed time,
+   * each counter, and instructions per cycle when both are available
+   * @param out Stream to write to
+   */
+  static void Write_report(std::ostream& out);
+
+  /**
+   * @brief Forget the totals of every scope
+   */
+  static void Clear();
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Perf_scope
+ * @brief Counts the events and time of the scope it is declared in
+ */
+class Perf_scope
+{
+public:
+  /**
+   * @brief Constructor, reads the counters
+   * @param name Scope name the results are added to
+   */
+  explicit Perf_scope(const std::string& name);
+
+  /**
+   * @brief Destructor, reads the counters again and records the difference
+   */
+  ~Perf_scope();
+
+  Perf_scope(const Perf_scope& other) = delete;
+  Perf_scope& operator=(const Perf_scope& other) = delete;
+
+  /**
+   * @brief Get the difference since the scope started, without ending it
+   */
+  Perf_values Get_values() const;
+
+private:
+  /**
+   * @brief m_name Scope name
+   */
+  const std::string m_name;
+
+  /**
+   * @brief m_start Reading when the scope started
+   */
+  const Perf_values m_start;
+};
+
+} // namespace so
+
+#endif
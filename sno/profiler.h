@@ -0,0 +1,481 @@
+/**
+ * @class Profiler
+ * @brief Scoped-zone profiler. Each so::Profile_zone times the scope it lives
+ * in; zones may nest and may run on any number of threads.
+ *
+ * A zone reads so::Tsc_clock when it starts and ends, and then appends one
+ * event to a buffer owned by its thread, so recording takes no locks. Each
+ * thread also keeps the count, total, minimum and maximum time of every zone,
+ * which stay exact after the event buffer is full. The events can be written
+ * as Chrome trace JSON, which chrome://tracing and the Perfetto UI open.
+ *
+ * Zones are usually declared with SO_PROFILE_ZONE("name"), which registers
+ * the name once per statement. Compiling with -DSO_PROFILE=0 removes every
+ * SO_PROFILE_ZONE entirely.
+ */
+
+#ifndef SO_PROFILER_H
+#define SO_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <sno/tsc_clock.h>
+
+namespace so
+{
+
+/**
+ * @brief A finished zone
+ */
+struct Profile_event
+{
+  int64_t begin; ///< Tsc_clock ticks
+  int64_t end;   ///< Tsc_clock ticks
+  uint32_t site; ///< Profile_site id
+  uint32_t depth;///< Number of enclosing zones on the same thread
+};
+
+/**
+ * @brief Aggregate times of one zone name
+ */
+struct Profile_stats
+{
+  std::string name;
+  uint64_t count;
+  int64_t total_ns;
+  int64_t min_ns;
+  int64_t max_ns;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Profile_thread_buffer
+ * @brief Events and statistics of one thread. Written only by its thread;
+ * read by so::Profiler while the thread may still be writing. When the thread
+ * exits the buffer is released, and a new thread may take it over, keeping
+ * what was recorded before
+ */
+class Profile_thread_buffer
+{
+public:
+  /**
+   * @brief Running totals of one zone. Only the owning thread writes them,
+   * so relaxed loads and stores are enough
+   */
+  struct Stats
+  {
+    boost::atomic<uint64_t> count;
+    boost::atomic<int64_t> total;
+    boost::atomic<int64_t> min;
+    boost::atomic<int64_t> max;
+  };
+
+  /**
+   * @brief A thread that has owned the buffer
+   */
+  struct Owner
+  {
+    size_t first_event; ///< Index of the thread's first event
+    int64_t tid;        ///< Id of the thread
+  };
+
+  /**
+   * @brief Zone statistics are allocated in chunks of this many sites
+   */
+  static const size_t STATS_CHUNK = 256;
+
+  /**
+   * @brief Maximum number of chunks, so at most 16384 distinct zones
+   */
+  static const size_t MAX_STATS_CHUNKS = 64;
+
+  /**
+   * @brief Constructor
+   * @param capacity Number of events kept; later events are only counted
+   * @param tid Id of the owning thread
+   */
+  Profile_thread_buffer(const size_t capacity, const int64_t tid);
+
+  ~Profile_thread_buffer();
+
+  Profile_thread_buffer(const Profile_thread_buffer& other) = delete;
+  Profile_thread_buffer& operator=(const Profile_thread_buffer& other) = delete;
+
+  /**
+   * @brief Enter a zone
+   * @return Number of zones already open on this thread
+   */
+  uint32_t Enter()
+  {
+    return m_depth++;
+  }
+
+  /**
+   * @brief Leave a zone and record it
+   * @param site Zone's site id
+   * @param depth Value returned by Enter()
+   * @param begin Start time, Tsc_clock ticks
+   * @param end End time, Tsc_clock ticks
+   */
+  void Leave(const uint32_t site,
+             const uint32_t depth,
+             const int64_t begin,
+             const int64_t end)
+  {
+    m_depth = depth;
+    size_t n = m_count.load(boost::memory_order_relaxed);
+    if(n < m_capacity)
+    {
+      Profile_event& e = m_events[n];
+      e.begin = begin;
+      e.end = end;
+      e.site = site;
+      e.depth = depth;
+      m_count.store(n + 1, boost::memory_order_release);
+    }
+    else
+    {
+      m_dropped.store(m_dropped.load(boost::memory_order_relaxed) + 1,
+                      boost::memory_order_relaxed);
+    }
+
+    Stats* chunk = m_stats[site / STATS_CHUNK].load(boost::memory_order_relaxed);
+    if(!chunk)
+    {
+      chunk = add_chunk(site / STATS_CHUNK);
+      if(!chunk)
+      {
+        return;
+      }
+    }
+    Stats& s = chunk[site % STATS_CHUNK];
+    int64_t ticks = end - begin;
+    uint64_t count = s.count.load(boost::memory_order_relaxed);
+    s.total.store(s.total.load(boost::memory_order_relaxed) + ticks,
+                  boost::memory_order_relaxed);
+    if(count == 0 || ticks < s.min.load(boost::memory_order_relaxed))
+    {
+      s.min.store(ticks, boost::memory_order_relaxed);
+    }
+    if(count == 0 || ticks > s.max.load(boost::memory_order_relaxed))
+    {
+      s.max.store(ticks, boost::memory_order_relaxed);
+    }
+    s.count.store(count + 1, boost::memory_order_release);
+  }
+
+  /**
+   * @brief Get the finished events recorded so far
+   * @param count Set to the number of events
+   * @return First event
+   */
+  const Profile_event* Get_events(size_t& count) const
+  {
+    count = m_count.load(boost::memory_order_acquire);
+    return m_events.get();
+  }
+
+  /**
+   * @brief Get the statistics of a zone
+   * @param site Zone's site id
+   * @return Statistics, or nullptr if the zone never ran on this thread
+   */
+  const Stats* Get_stats(const uint32_t site) const;
+
+  /**
+   * @brief Get the number of events that did not fit in the buffer
+   */
+  uint64_t Get_dropped() const
+  {
+    return m_dropped.load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the number of events the buffer holds
+   */
+  size_t Get_capacity() const
+  {
+    return m_capacity;
+  }
+
+  /**
+   * @brief Get the threads that have owned the buffer, oldest first. Only
+   * safe while no thread can claim the buffer (so::Profiler holds its lock)
+   */
+  const std::vector<Owner>& Get_owners() const
+  {
+    return m_owners;
+  }
+
+  /**
+   * @brief Take the buffer over from a thread that has exited. Its events and
+   * statistics are kept; later events belong to the new thread
+   * @param tid Id of the new owning thread
+   * @return False if the buffer is still owned
+   */
+  bool Claim(const int64_t tid);
+
+  /**
+   * @brief Give the buffer up. Called when the owning thread exits
+   */
+  void Release()
+  {
+    m_in_use.store(false, boost::memory_order_release);
+  }
+
+  /**
+   * @brief Forget all events and statistics. Only safe while the owning
+   * thread has no zone open
+   */
+  void Clear();
+
+private:
+  //Variables
+  /**
+   * @brief m_capacity Size of m_events
+   */
+  const size_t m_capacity;
+
+  /**
+   * @brief m_events Finished zones, in the order they ended
+   */
+  std::unique_ptr<Profile_event[]> m_events;
+
+  /**
+   * @brief m_count Number of events in m_events
+   */
+  boost::atomic<size_t> m_count;
+
+  /**
+   * @brief m_dropped Events that did not fit
+   */
+  boost::atomic<uint64_t> m_dropped;
+
+  /**
+   * @brief m_depth Number of open zones. Owning thread only
+   */
+  uint32_t m_depth;
+
+  /**
+   * @brief m_in_use True while a thread owns the buffer
+   */
+  boost::atomic<bool> m_in_use;
+
+  /**
+   * @brief m_owners Threads that have owned the buffer, oldest first
+   */
+  std::vector<Owner> m_owners;
+
+  /**
+   * @brief m_stats Chunks of zone statistics, indexed by site id / STATS_CHUNK
+   */
+  boost::atomic<Stats*> m_stats[MAX_STATS_CHUNKS];
+
+  //Functions
+  /**
+   * @brief Allocate a chunk of statistics
+   * @return The chunk, or nullptr if the site id is out of range
+   */
+  Stats* add_chunk(const size_t index);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Profile_site
+ * @brief A zone name registered with the profiler. SO_PROFILE_ZONE creates
+ * one static Profile_site for each statement
+ */
+class Profile_site
+{
+public:
+  /**
+   * @brief Constructor, registers the name
+   * @param name Zone name. Must outlive the profiler, e.g. a string literal
+   */
+  explicit Profile_site(const char* name);
+
+  /**
+   * @brief Get the id of this site
+   */
+  uint32_t Get_id() const
+  {
+    return m_id;
+  }
+
+private:
+  /**
+   * @brief m_id Index of the name in the profiler's site list
+   */
+  const uint32_t m_id;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+class Profiler
+{
+public:
+  /**
+   * @brief Set the number of events each thread keeps. Only affects threads
+   * that have not recorded a zone yet
+   * @param events Events per thread
+   */
+  static void Set_buffer_size(const size_t events);
+
+  /**
+   * @brief Get the calling thread's buffer, creating it on first use
+   */
+  static Profile_thread_buffer& Get_thread_buffer()
+  {
+    thread_local Profile_thread_buffer* buffer = nullptr;
+    if(!buffer)
+    {
+      buffer = register_thread();
+    }
+    return *buffer;
+  }
+
+  /**
+   * @brief Aggregate the statistics of every thread by zone name
+   * @return One entry per zone that has run, largest total time first
+   */
+  static std::vector<Profile_stats> Get_stats();
+
+  /**
+   * @brief Get the number of events that did not fit in the thread buffers.
+   * They are still included in Get_stats()
+   */
+  static uint64_t Get_dropped();
+
+  /**
+   * @brief Write the recorded events as Chrome trace JSON ("X" complete
+   * events, times in microseconds)
+   * @param out Stream to write to
+   */
+  static void Write_chrome_trace(std::ostream& out);
+
+  /**
+   * @brief Write the recorded events to a Chrome trace JSON file
+   * @param filename File to write, truncated if it exists
+   * @throws so::Write_error if the file cannot be written
+   */
+  static void Write_chrome_trace(const std::string& filename);
+
+  /**
+   * @brief Forget all events and statistics. Only safe while no zone is open
+   * on any thread
+   */
+  static void Clear();
+
+private:
+  friend class Profile_site;
+
+  /**
+   * @brief Give the calling thread a buffer, reusing one released by a thread
+   * that has exited if it has the current size
+   */
+  static Profile_thread_buffer* register_thread();
+
+  /**
+   * @brief Add a zone name
+   * @return Site id
+   */
+  static uint32_t register_site(const char* name);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @class Profile_zone
+ * @brief Times the scope it is declared in
+ */
+class Profile_zone
+{
+public:
+  /**
+   * @brief Start a zone at a registered site. Used by SO_PROFILE_ZONE
+   * @param site Zone's site
+   */
+  explicit Profile_zone(const Profile_site& site)
+    :
+      m_buffer(Profiler::Get_thread_buffer()),
+      m_site(site.Get_id()),
+      m_depth(m_buffer.Enter()),
+      m_begin(Tsc_clock::Now())
+  {
+  }
+
+  /**
+   * @brief Start a zone by name. Finds the name's site in a per-thread
+   * table, so prefer SO_PROFILE_ZONE in hot code
+   * @param name Zone name. Must outlive the profiler, e.g. a string literal
+   */
+  explicit Profile_zone(const char* name);
+
+  /**
+   * @brief Destructor, ends the zone and records it
+   */
+  ~Profile_zone()
+  {
+    int64_t end = Tsc_clock::Now();
+    m_buffer.Leave(m_site, m_depth, m_begin, end);
+  }
+
+  Profile_zone(const Profile_zone& other) = delete;
+  Profile_zone& operator=(const Profile_zone& other) = delete;
+
+private:
+  /**
+   * @brief m_buffer Calling thread's buffer
+   */
+  Profile_thread_buffer& m_buffer;
+
+  /**
+   * @brief m_site Zone's site id
+   */
+  const uint32_t m_site;
+
+  /**
+   * @brief m_depth Number of enclosing zones
+   */
+  const uint32_t m_depth;
+
+  /**
+   * @brief m_begin Start time, Tsc_clock ticks
+   */
+  const int64_t m_begin;
+};
+
+} // namespace so
+
+//////////////////////////////////////////////////////////////////////////////
+// Compile time switch. Define SO_PROFILE as 0 before including this header
+// (or on the command line) to remove every SO_PROFILE_ZONE
+#ifndef SO_PROFILE
+#define SO_PROFILE 1
+#endif
+
+#define SO_PROFILE_CONCAT_IMPL(a, b) a##b
+#define SO_PROFILE_CONCAT(a, b) SO_PROFILE_CONCAT_IMPL(a, b)
+
+#if SO_PROFILE
+// Every lambda expression has its own type, so the site inside is registered
+// once per statement
+#define SO_PROFILE_ZONE(name) \
+  so::Profile_zone SO_PROFILE_CONCAT(so_profile_zone_, __LINE__)( \
+    []() -> const so::Profile_site& \
+    { \
+      static const so::Profile_site so_profile_site(name); \
+      return so_profile_site; \
+    }())
+#else
+#define SO_PROFILE_ZONE(name) static_cast<void>(0)
+#endif
+
+#endif
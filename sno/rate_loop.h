@@ -0,0 +1,216 @@
+/**
+ * @class Rate_loop
+ * @brief Runs a loop at a fixed rate.
+ *
+ * Deadlines are fixed times on a so::Stopwatch started by Start(), one
+ * period apart, so the time spent in the loop body does not add up into
+ * drift. Wait() sleeps until shortly before the next one with
+ * clock_nanosleep(TIMER_ABSTIME) and reads the stopwatch for the rest. With a
+ * spin time, Wait() wakes that much early and busy-waits the rest, which
+ * trades CPU time for less jitter.
+ *
+ * Wait() finding its deadline already passed is an overrun. With Catch_up,
+ * the missed iterations then run back to back until the loop is on schedule
+ * again; with Skip, they are dropped and the loop waits for the next deadline
+ * on the original schedule.
+ *
+ * How late each wake-up was and how late each overrun was are recorded in
+ * histograms, so the jitter percentiles of a loop can be read at any time.
+ *
+ * Like any so::Stopwatch, the loop follows an installed so::Clock. Wait() then
+ * returns at once instead of sleeping, so a replay runs as fast as its clock
+ * is moved.
+ *
+ * Example:
+ *   so::Rate_loop loop(500.0);
+ *   while(running)
+ *   {
+ *     loop.Wait();
+ *     update_filter();
+ *   }
+ */
+
+#ifndef SO_RATE_LOOP_H
+#define SO_RATE_LOOP_H
+
+#include <stdint.h>
+#include <chrono>
+#include <sno/latency_histogram.h>
+#include <sno/stopwatch.h>
+
+namespace so
+{
+
+class Rate_loop
+{
+public:
+  /**
+   * @brief What to do with iterations whose deadline has passed
+   */
+  enum Overrun_policy
+  {
+    Catch_up, ///< Run them at once, back to back
+    Skip,     ///< Drop them and wait for the next deadline
+  };
+
+  /**
+   * @brief Constructor
+   * @param hz Iterations per second
+   * @param policy What to do after an overrun
+   * @param spin Time before each deadline spent busy-waiting instead of
+   * sleeping
+   * @param source Clock the schedule is kept on
+   * @throws so::Invalid_argument if hz is not positive or spin is negative
+   */
+  explicit Rate_loop(const double hz,
+                     const Overrun_policy policy = Skip,
+                     const std::chrono::nanoseconds spin =
+                         std::chrono::nanoseconds(0),
+                     const Stopwatch::Clock_source source = Stopwatch::Steady);
+
+  Rate_loop(const Rate_loop& other) = delete;
+  Rate_loop& operator=(const Rate_loop& other) = delete;
+
+  /**
+   * @brief Start the schedule now. The first deadline is one period later.
+   * Called by the first Wait() if needed
+   */
+  void Start();
+
+  /**
+   * @brief Wait for the next deadline
+   * @return True if the deadline was met, false after an overrun
+   */
+  bool Wait();
+
+  /**
+   * @brief Get the time between deadlines
+   * @return Period, nanoseconds
+   */
+  int64_t Get_period_ns() const
+  {
+    return m_period;
+  }
+
+  /**
+   * @brief Get the deadline the last Wait() waited for
+   * @return Time since Start(), nanoseconds
+   */
+  int64_t Get_deadline_ns() const
+  {
+    return m_deadline;
+  }
+
+  /**
+   * @brief Get the number of completed Wait() calls
+   */
+  uint64_t Get_iteration_count() const
+  {
+    return m_iterations;
+  }
+
+  /**
+   * @brief Get the number of overruns
+   */
+  uint64_t Get_overrun_count() const
+  {
+    return m_overruns;
+  }
+
+  /**
+   * @brief Get the number of iterations dropped by the Skip policy
+   */
+  uint64_t Get_skipped_count() const
+  {
+    return m_skipped;
+  }
+
+  /**
+   * @brief Get how late Wait() returned after each deadline it met
+   */
+  const Latency_histogram& Get_jitter() const
+  {
+    return m_jitter;
+  }
+
+  /**
+   * @brief Get how far past its deadline Wait() was called, for each overrun
+   */
+  const Latency_histogram& Get_overruns() const
+  {
+    return m_overrun_times;
+  }
+
+  /**
+   * @brief Forget the statistics. The schedule is kept
+   */
+  void Reset_statistics();
+
+private:
+  //Variables
+  /**
+   * @brief m_period Time between deadlines, nanoseconds
+   */
+  const int64_t m_period;
+
+  /**
+   * @brief m_policy What to do after an overrun
+   */
+  const Overrun_policy m_policy;
+
+  /**
+   * @brief m_spin Time busy-waited before each deadline, nanoseconds
+   */
+  const int64_t m_spin;
+
+  /**
+   * @brief m_clock Time since the schedule started
+   */
+  Stopwatch m_clock;
+
+  /**
+   * @brief m_started True once the schedule has started
+   */
+  bool m_started;
+
+  /**
+   * @brief m_deadline Current deadline, nanoseconds since Start()
+   */
+  int64_t m_deadline;
+
+  /**
+   * @brief m_iterations Number of completed Wait() calls
+   */
+  uint64_t m_iterations;
+
+  /**
+   * @brief m_overruns Number of overruns
+   */
+  uint64_t m_overruns;
+
+  /**
+   * @brief m_skipped Number of iterations dropped
+   */
+  uint64_t m_skipped;
+
+  /**
+   * @brief m_jitter Lateness of met deadlines
+   */
+  Latency_histogram m_jitter;
+
+  /**
+   * @brief m_overrun_times Lateness of overruns
+   */
+  Latency_histogram m_overrun_times;
+
+  //Functions
+  /**
+   * @brief Sleep and spin until a deadline
+   * @return Time since Start() on waking, nanoseconds
+   */
+  int64_t wait_until(const int64_t deadline);
+};
+
+} // namespace so
+
+#endif
@@ -1,11 +1,18 @@
 /**
+ * @brief Coordinate transforms between the body and earth (NED) frames.
  *
+ * Every function that takes an attitude quaternion normalizes it before use,
+ * so a quaternion that has drifted slightly from unit length gives the same
+ * result through each path (single point, batch, or direction cosine
+ * matrix).
  */
 
 #ifndef ROTATE_H
 #define ROTATE_H
 
+#include <stddef.h>
 #include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Geometry>
 
 namespace so
 {
@@ -46,6 +53,177 @@ Eigen::Vector3d body_2_earth(const Eigen::Vector3d& position,
 Eigen::Vector3d earth_2_body(const Eigen::Vector3d& position,
                              const Eigen::Vector3d& attitude);
 
+/**
+ * @brief Convert coordinates from body frame to earth frame given the current
+ * attitude of the vehicle as a quaternion
+ * @param position [X, Y, Z] coordinates in vehicle frame
+ * @param attitude Body to earth attitude quaternion, see euler_2_quat(). Need
+ * not be of unit length
+ * @return [X, Y, Z] coordinates in earth frame (northing, easting, downing)
+ */
+Eigen::Vector3d body_2_earth(const Eigen::Vector3d& position,
+                             const Eigen::Quaterniond& attitude);
+
+/**
+ * @brief Convert a set of points from body frame to earth frame. The rotation
+ * matrix is computed once and applied to every point
+ * @param positions [X, Y, Z] coordinates in vehicle frame, one point per column
+ * @param attitude Body to earth attitude quaternion, see euler_2_quat(). Need
+ * not be of unit length
+ * @return [X, Y, Z] coordinates in earth frame, one point per column
+ */
+Eigen::Matrix3Xd body_2_earth(const Eigen::Matrix3Xd& positions,
+                              const Eigen::Quaterniond& attitude);
+
+/**
+ * @brief Convert coordinates from earth frame
+ * (northing/easting/downing relative to vehicle) to body fixed frame given the
+ * attitude of the vehicle as a quaternion
+ * @param position [Northing, easting, downing] relative to vehicle
+ * @param attitude Body to earth attitude quaternion, see euler_2_quat(). Need
+ * not be of unit length
+ * @return [X, Y, Z] coordinates in body frame
+ */
+Eigen::Vector3d earth_2_body(const Eigen::Vector3d& position,
+                             const Eigen::Quaterniond& attitude);
+
+/**
+ * @brief Convert a set of points from earth frame to body frame. The rotation
+ * matrix is computed once and applied to every point
+ * @param positions [Northing, easting, downing] relative to vehicle, one
+ * point per column
+ * @param attitude Body to earth attitude quaternion, see euler_2_quat(). Need
+ * not be of unit length
+ * @return [X, Y, Z] coordinates in body frame, one point per column
+ */
+Eigen::Matrix3Xd earth_2_body(const Eigen::Matrix3Xd& positions,
+                              const Eigen::Quaterniond& attitude);
+
+/**
+ * @brief Convert a set of points held as separate coordinate arrays
+ * (structure of arrays) from body frame to earth frame. The rotation matrix
+ * is computed once and applied to every point
+ * @param x X coordinates in vehicle frame, n values
+ * @param y Y coordinates in vehicle frame, n values
+ * @param z Z coordinates in vehicle frame, n values
+ * @param n Number of points
+ * @param attitude Body to earth attitude quaternion, see euler_2_quat(). Need
+ * not be of unit length
+ * @param north Will be populated with northing relative to vehicle, n values
+ * @param east Will be populated with easting relative to vehicle, n values
+ * @param down Will be populated with downing relative to vehicle, n values.
+ * The outputs must not overlap the inputs
+ */
+void body_2_earth(const double* x,
+                  const double* y,
+                  const double* z,
+                  const size_t n,
+                  const Eigen::Quaterniond& attitude,
+                  double* north,
+                  double* east,
+                  double* down);
+
+/**
+ * @brief Convert a set of points held as separate coordinate arrays
+ * (structure of arrays) from earth frame to body frame. The rotation matrix
+ * is computed once and applied to every point
+ * @param north Northing relative to vehicle, n values
+ * @param east Easting relative to vehicle, n values
+ * @param down Downing relative to vehicle, n values
+ * @param n Number of points
+ * @param attitude Body to earth attitude quaternion, see euler_2_quat(). Need
+ * not be of unit length
+ * @param x Will be populated with X coordinates in body frame, n values
+ * @param y Will be populated with Y coordinates in body frame, n values
+ * @param z Will be populated with Z coordinates in body frame, n values. The
+ * outputs must not overlap the inputs
+ */
+void earth_2_body(const double* north,
+                  const double* east,
+                  const double* down,
+                  const size_t n,
+                  const Eigen::Quaterniond& attitude,
+                  double* x,
+                  double* y,
+                  double* z);
+
+/**
+ * @brief Convert Euler angles to the equivalent attitude quaternion. The
+ * quaternion rotates vectors from the body frame to the earth frame, i.e.
+ * body_2_earth(p, euler_2_quat(a)) == body_2_earth(p, a)
+ * @param attitude [roll, pitch, heading], degrees
+ * @return Unit quaternion for the body to earth rotation
+ */
+Eigen::Quaterniond euler_2_quat(const Eigen::Vector3d& attitude);
+
+/**
+ * @brief Convert an attitude quaternion to Euler angles
+ * @param q Body to earth attitude quaternion. Need not be of unit length
+ * @return [roll, pitch, heading], degrees. Roll and heading are in
+ * (-180, 180], pitch is in [-90, 90]
+ */
+Eigen::Vector3d quat_2_euler(const Eigen::Quaterniond& q);
+
+/**
+ * @brief Convert an attitude quaternion to a direction cosine matrix
+ * @param q Body to earth attitude quaternion. Need not be of unit length
+ * @return Matrix that transforms a vector from the body frame to the earth
+ * frame
+ */
+Eigen::Matrix3d quat_2_dcm(const Eigen::Quaterniond& q);
+
+/**
+ * @brief Convert a direction cosine matrix to an attitude quaternion
+ * @param dcm Orthonormal matrix that transforms a vector from the body frame
+ * to the earth frame
+ * @return Unit quaternion for the same rotation
+ */
+Eigen::Quaterniond dcm_2_quat(const Eigen::Matrix3d& dcm);
+
+/**
+ * @brief Compose two rotations. If q_ab rotates vectors from frame b to frame
+ * a and q_bc rotates vectors from frame c to frame b, the result rotates
+ * vectors from frame c to frame a
+ * @param q_ab Frame b to frame a rotation
+ * @param q_bc Frame c to frame b rotation
+ * @return Normalized frame c to frame a rotation
+ */
+Eigen::Quaterniond quat_compose(const Eigen::Quaterniond& q_ab,
+                                const Eigen::Quaterniond& q_bc);
+
+/**
+ * @brief Invert a rotation
+ * @param q Unit quaternion
+ * @return Quaternion for the opposite rotation (the conjugate of q)
+ */
+Eigen::Quaterniond quat_inverse(const Eigen::Quaterniond& q);
+
+/**
+ * @brief Convert a set of Euler angles to attitude quaternions
+ * @param attitudes [roll, pitch, heading] in degrees, one attitude per column
+ * @return Quaternion coefficients [w, x, y, z], one attitude per column
+ */
+Eigen::Matrix4Xd euler_2_quat(const Eigen::Matrix3Xd& attitudes);
+
+/**
+ * @brief Convert a set of attitude quaternions to Euler angles
+ * @param q Quaternion coefficients [w, x, y, z], one attitude per column
+ * @return [roll, pitch, heading] in degrees, one attitude per column
+ */
+Eigen::Matrix3Xd quat_2_euler(const Eigen::Matrix4Xd& q);
+
+/**
+ * @brief Convert a set of points from body frame to earth frame, each with its
+ * own attitude
+ * @param positions [X, Y, Z] coordinates in vehicle frame, one point per column
+ * @param attitudes Quaternion coefficients [w, x, y, z] of the body to earth
+ * rotation for each point, one per column. Need not be of unit length
+ * @return [X, Y, Z] coordinates in earth frame, one point per column
+ * @throws so::Invalid_argument if the number of points and attitudes differ
+ */
+Eigen::Matrix3Xd body_2_earth(const Eigen::Matrix3Xd& positions,
+                              const Eigen::Matrix4Xd& attitudes);
+
 /**
  * @brief Return the matrix to transforms a vector [x, y, z]
  * from one coordinate system to a coordinate system rotated about the x axis
@@ -1,17 +1,34 @@
+#ifndef SO_STOPWATCH_H
+#define SO_STOPWATCH_H
+
+#include <stdint.h>
 #include <memory>
 
 namespace so
 {
 
+class Latency_histogram;
 class Stopwatch_impl;
 
 class Stopwatch
 {
 public:
+  /**
+   * @brief Clock the stopwatch reads
+   */
+  enum Clock_source
+  {
+    Steady, ///< std::chrono::steady_clock
+    Tsc,    ///< so::Tsc_clock, for timing very short sections. Falls back to
+            ///< clock_gettime() if the CPU has no invariant TSC
+  };
+
   /**
    * @brief Constructor, a new stopwatch
+   * @param source Clock to read. Either reads the installed so::Clock
+   * instead if there is one
    */
-  Stopwatch();
+  explicit Stopwatch(const Clock_source source = Steady);
 
   /**
    * @brief Destructor
@@ -31,20 +48,38 @@ public:
   /**
    * @brief Stop the stopwatch but do not reset the elapsed time
    * @return Elapsed time, seconds
-   * @throws so::runtime_exception if the number of microseconds in the
-   * current elapsed time cannot be represented by a double
    */
   double Stop();
 
+  /**
+   * @brief Stop the stopwatch but do not reset the elapsed time
+   * @return Elapsed time, nanoseconds
+   */
+  int64_t Stop_ns();
+
   /**
    * @brief Take a split
    * @return Number of seconds since the last split, or since the stopwatch was
    * started if this is the first split. Returns 0 if the timer isn't running
-   * @throws so::runtime_exception if the number of microseconds in the
-   * current split cannot be represented by a double
    */
   double Split();
 
+  /**
+   * @brief Take a split
+   * @return Number of nanoseconds since the last split, or since the
+   * stopwatch was started if this is the first split. Returns 0 if the timer
+   * isn't running
+   */
+  int64_t Split_ns();
+
+  /**
+   * @brief Take a split and record it
+   * @param histogram Histogram to record the split in. Nothing is recorded
+   * if the timer isn't running
+   * @return Number of nanoseconds since the last split, as Split_ns()
+   */
+  int64_t Split_ns(Latency_histogram& histogram);
+
   /**
    * @brief Reset the stopwatch
    */
@@ -53,11 +88,15 @@ public:
   /**
    * @brief Get the current elapsed time since the stopwatch was started
    * @return Current elapsed time since the stopwatch was started, seconds
-   * @throws so::runtime_exception if the number of microseconds in the
-   * current elapsed time cannot be represented by a double
    */
   double Get_time();
 
+  /**
+   * @brief Get the current elapsed time since the stopwatch was started
+   * @return Current elapsed time since the stopwatch was started, nanoseconds
+   */
+  int64_t Get_time_ns();
+
 private:
   /**
    * @brief m_pimpl Implementation class
@@ -66,3 +105,5 @@ private:
 };
 
 } // namespace so
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @class Strapdown
+ * @brief Strapdown inertial mechanization. Integrates blocks of gyro and
+ * accelerometer samples into a body to earth (NED) attitude quaternion and an
+ * earth frame velocity.
+ *
+ * Each sample is treated as an angle increment and a velocity increment over
+ * the sample interval. Coning and sculling are compensated using the previous
+ * sample's increments. The earth is treated as flat and non-rotating, which
+ * is adequate over the short horizons this is intended for.
+ */
+
+#ifndef SO_STRAPDOWN_H
+#define SO_STRAPDOWN_H
+
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Geometry>
+
+namespace so
+{
+
+class Strapdown
+{
+public:
+  /**
+   * @brief Constructor, a new strapdown integrator
+   * @param attitude Initial [roll, pitch, heading], degrees
+   * @param velocity Initial [north, east, down] velocity, m/s
+   * @param gravity Magnitude of gravity, m/s^2. Applied along +down
+   */
+  Strapdown(const Eigen::Vector3d& attitude,
+            const Eigen::Vector3d& velocity = Eigen::Vector3d::Zero(),
+            const double gravity = 9.80665);
+
+  /**
+   * @brief Integrate a block of gyro and accelerometer rates sampled at a
+   * fixed interval
+   * @param gyro Angular rates [x, y, z], rad/s, one sample per column
+   * @param accel Specific force [x, y, z], m/s^2, one sample per column
+   * @param dt Sample interval, seconds
+   * @throws so::Invalid_argument if the blocks have different lengths or
+   * dt is not positive
+   */
+  void Integrate(const Eigen::Matrix3Xd& gyro,
+                 const Eigen::Matrix3Xd& accel,
+                 const double dt);
+
+  /**
+   * @brief Integrate a block of angle and velocity increments, as output by
+   * most IMUs
+   * @param delta_theta Angle increments [x, y, z], rad, one sample per column
+   * @param delta_v Velocity increments [x, y, z], m/s, one sample per column
+   * @param dt Sample interval, seconds
+   * @throws so::Invalid_argument if the blocks have different lengths or
+   * dt is not positive
+   */
+  void Integrate_increments(const Eigen::Matrix3Xd& delta_theta,
+                            const Eigen::Matrix3Xd& delta_v,
+                            const double dt);
+
+  /**
+   * @brief Reset the attitude and velocity and discard the coning/sculling
+   * history
+   * @param attitude [roll, pitch, heading], degrees
+   * @param velocity [north, east, down] velocity, m/s
+   */
+  void Reset(const Eigen::Vector3d& attitude,
+             const Eigen::Vector3d& velocity = Eigen::Vector3d::Zero());
+
+  /**
+   * @brief Get the current attitude as Euler angles, suitable for
+   * so::Rotate::body_2_earth()
+   * @return [roll, pitch, heading], degrees
+   */
+  Eigen::Vector3d Get_attitude() const;
+
+  /**
+   * @brief Get the current body to earth attitude quaternion
+   * @return Attitude quaternion
+   */
+  const Eigen::Quaterniond& Get_quaternion() const;
+
+  /**
+   * @brief Get the current velocity
+   * @return [north, east, down] velocity, m/s
+   */
+  const Eigen::Vector3d& Get_velocity() const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+  /**
+   * @brief m_q Body to earth attitude
+   */
+  Eigen::Quaterniond m_q;
+
+  /**
+   * @brief m_v Earth frame velocity
+   */
+  Eigen::Vector3d m_v;
+
+  /**
+   * @brief m_gravity Gravity vector in the earth frame
+   */
+  Eigen::Vector3d m_gravity;
+
+  /**
+   * @brief m_prev_dtheta Angle increment of the previous sample
+   */
+  Eigen::Vector3d m_prev_dtheta;
+
+  /**
+   * @brief m_prev_dv Velocity increment of the previous sample
+   */
+  Eigen::Vector3d m_prev_dv;
+};
+
+} // namespace so
+
+#endif
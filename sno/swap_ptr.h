@@ -0,0 +1,178 @@
+/**
+ * @class Swap_ptr
+ * @brief Owning pointer that any number of threads read without locks while
+ * it is replaced.
+ *
+ * Readers count themselves in one of two counters, chosen by the current
+ * epoch, for as long as they use the value. Reset() installs the new value,
+ * flips the epoch and waits for the readers counted under the old epoch to
+ * leave. They are the only ones that can still hold the old value, so it is
+ * then deleted. Readers that arrive during the wait use the new value and do
+ * not hold Reset() up. A reader that finds the epoch changed while it was
+ * counting itself may be counted where no Reset() will wait for it, so it
+ * takes itself out and counts again under the new epoch.
+ */
+
+#ifndef SO_SWAP_PTR_H
+#define SO_SWAP_PTR_H
+
+#include <stdint.h>
+#include <memory>
+#include <thread>
+#include <boost/atomic.hpp>
+
+namespace so
+{
+
+template<class V>
+class Swap_ptr
+{
+public:
+  /**
+   * @class Reader
+   * @brief Access to the value for the reader's lifetime
+   */
+  class Reader
+  {
+  public:
+    /**
+     * @brief Constructor, starts reading
+     * @param ptr Pointer to read
+     */
+    explicit Reader(const Swap_ptr& ptr)
+      :
+        m_ptr(ptr),
+        m_epoch(ptr.m_epoch.load()),
+        m_value(nullptr)
+    {
+      m_ptr.m_readers[m_epoch].count.fetch_add(1);
+      uint32_t epoch = m_ptr.m_epoch.load();
+      while(epoch != m_epoch)
+      {
+        m_ptr.m_readers[m_epoch].count.fetch_sub(1, boost::memory_order_release);
+        m_epoch = epoch;
+        m_ptr.m_readers[m_epoch].count.fetch_add(1);
+        epoch = m_ptr.m_epoch.load();
+      }
+      m_value = m_ptr.m_value.load();
+    }
+
+    /**
+     * @brief Destructor, stops reading
+     */
+    ~Reader()
+    {
+      m_ptr.m_readers[m_epoch].count.fetch_sub(1, boost::memory_order_release);
+    }
+
+    Reader(const Reader& other) = delete;
+    Reader& operator=(const Reader& other) = delete;
+
+    /**
+     * @brief Get the value
+     * @return Value, valid until the reader is destroyed, or nullptr
+     */
+    V* Get() const
+    {
+      return m_value;
+    }
+
+  private:
+    /**
+     * @brief m_ptr Pointer being read
+     */
+    const Swap_ptr& m_ptr;
+
+    /**
+     * @brief m_epoch Counter this reader is counted in
+     */
+    uint32_t m_epoch;
+
+    /**
+     * @brief m_value Value read
+     */
+    V* m_value;
+  };
+
+  /**
+   * @brief Constructor, a null pointer
+   */
+  Swap_ptr()
+    :
+      m_value(nullptr),
+      m_epoch(0),
+      m_readers()
+  {
+    m_readers[0].count.store(0, boost::memory_order_relaxed);
+    m_readers[1].count.store(0, boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Destructor, deletes the value. No reader may be left
+   */
+  ~Swap_ptr()
+  {
+    delete m_value.load();
+  }
+
+  Swap_ptr(const Swap_ptr& other) = delete;
+  Swap_ptr& operator=(const Swap_ptr& other) = delete;
+
+  /**
+   * @brief Replace the value and delete the old one once no reader can still
+   * hold it. Calls must be serialized by the caller, and must not come from a
+   * thread that holds a Reader of this pointer
+   * @param value New value, may be null
+   */
+  void Reset(std::unique_ptr<V> value)
+  {
+    V* old = m_value.exchange(value.release());
+    uint32_t epoch = m_epoch.load(boost::memory_order_relaxed);
+    m_epoch.store(epoch ^ 1);
+    while(m_readers[epoch].count.load() != 0)
+    {
+      std::this_thread::yield();
+    }
+    delete old;
+  }
+
+  /**
+   * @brief Get the value without counting as a reader. Any thread may check
+   * it against null, but only the thread that calls Reset(), holding the lock
+   * that serializes it, may use the value
+   * @return Value, or nullptr
+   */
+  V* Get() const
+  {
+    return m_value.load(boost::memory_order_relaxed);
+  }
+
+private:
+  /**
+   * @brief A reader counter on its own cache line
+   */
+  struct Counter
+  {
+    boost::atomic<uint64_t> count;
+    char pad[64 - sizeof(boost::atomic<uint64_t>)];
+  };
+
+  /**
+   * @brief m_value Current value
+   */
+  boost::atomic<V*> m_value;
+
+  /**
+   * @brief m_epoch Counter new readers use
+   */
+  boost::atomic<uint32_t> m_epoch;
+
+  /**
+   * @brief m_readers Number of readers counted under each epoch
+   */
+  mutable Counter m_readers[2];
+};
+
+} // namespace so
+
+#endif
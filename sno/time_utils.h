@@ -7,18 +7,99 @@
 
 #include <chrono>
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <boost/atomic.hpp>
+#include <sno/clock.h>
 namespace so
 {
 namespace Time_utils
 {
 /**
- * @brief Return the current unix time in decimal seconds
- * @return Time since 00:00 on Jan 1 1970
- * @throws so::runtime_error if the number of microseconds since the UNIX
- * epoch cannot be stored in a double
+ * @brief Return the current unix time in decimal seconds. Like every
+ * function here, reads the installed so::Clock if there is one
+ * @return Time since 00:00 on Jan 1 1970, to about a microsecond
  */
 double Unix_time();
 
+/**
+ * @brief Return the current unix time in microseconds. Reads
+ * clock_gettime(CLOCK_REALTIME), which the vDSO serves without a system call
+ * @return Microseconds since 00:00 on Jan 1 1970
+ */
+inline int64_t Unix_time_us()
+{
+  const Clock* clock = Clock::Get_current();
+  if(clock)
+  {
+    return clock->Unix_ns() / 1000;
+  }
+  return Clock::Real_unix_ns() / 1000;
+}
+
+/**
+ * @brief Return the current unix time in nanoseconds. Reads
+ * clock_gettime(CLOCK_REALTIME), which the vDSO serves without a system call
+ * @return Nanoseconds since 00:00 on Jan 1 1970
+ */
+inline int64_t Unix_time_ns()
+{
+  const Clock* clock = Clock::Get_current();
+  if(clock)
+  {
+    return clock->Unix_ns();
+  }
+  return Clock::Real_unix_ns();
+}
+
+/**
+ * @brief Start the cached clock. A background thread stores the unix time in
+ * an atomic every period, so that Cached_unix_time_ns() costs a single load.
+ * The cached time is behind the real time by up to the period plus the
+ * thread's scheduling delay. Calling it again only changes the period
+ * @param period Time between updates
+ */
+void Start_cached_time(const std::chrono::microseconds period =
+                           std::chrono::microseconds(100));
+
+/**
+ * @brief Stop the cached clock. Cached_unix_time_ns() then reads the clock
+ * directly again
+ */
+void Stop_cached_time();
+
+/**
+ * @brief Time stored by the cached clock, 0 while it is stopped or a
+ * so::Clock is installed
+ */
+inline boost::atomic<int64_t>& Cached_time_value()
+{
+  static boost::atomic<int64_t> value(0);
+  return value;
+}
+
+/**
+ * @brief Return the unix time last stored by the cached clock, or the
+ * current time if the cached clock is stopped. One relaxed load while the
+ * cached clock runs; the installed so::Clock is read through Unix_time_ns()
+ * @return Nanoseconds since 00:00 on Jan 1 1970
+ */
+inline int64_t Cached_unix_time_ns()
+{
+  int64_t ns = Cached_time_value().load(boost::memory_order_relaxed);
+  return ns ? ns : Unix_time_ns();
+}
+
+/**
+ * @brief Return the unix time last stored by the cached clock, or the
+ * current time if the cached clock is stopped
+ * @return Microseconds since 00:00 on Jan 1 1970
+ */
+inline int64_t Cached_unix_time_us()
+{
+  return Cached_unix_time_ns() / 1000;
+}
+
 } // namespace Time_utils
 } // namespace so
 
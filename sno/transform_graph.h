@@ -0,0 +1,208 @@
+/**
+ * @class Transform_graph
+ * @brief Tree of coordinate frames connected by rigid transforms, e.g.
+ * sensor->body->earth->map. Edges are either static (fixed when added) or
+ * dynamic (updated once per timestamp). Frequently queried source->target
+ * compositions are registered as chains; static runs along a chain are
+ * composed once up front, and the full composition is cached until one of the
+ * dynamic edges on the chain changes.
+ *
+ * Thread safety: frames, edges and chains must be added before the graph is
+ * shared between threads. After that, Lookup() is lock-free and may be called
+ * from any number of threads while Update_edge() runs. Each dynamic edge must
+ * have a single writer at a time. Each edge is always read consistently, but a
+ * lookup that overlaps updates of several edges may see some of them before
+ * and some after the update.
+ */
+
+#ifndef SO_TRANSFORM_GRAPH_H
+#define SO_TRANSFORM_GRAPH_H
+
+#include <memory>
+#include <string>
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Geometry>
+
+namespace so
+{
+
+/**
+ * @class Rigid_transform
+ * @brief Rotation followed by a translation, p' = R * p + t
+ */
+class Rigid_transform
+{
+public:
+  /**
+   * @brief Constructor, the identity transform
+   */
+  Rigid_transform();
+
+  /**
+   * @brief Constructor, a new transform
+   * @param rotation Rotation from the source frame to the destination frame
+   * @param translation Origin of the source frame in the destination frame
+   */
+  Rigid_transform(const Eigen::Quaterniond& rotation,
+                  const Eigen::Vector3d& translation = Eigen::Vector3d::Zero());
+
+  /**
+   * @brief Constructor, a new transform from Euler angles, e.g. a sensor
+   * mounting or the vehicle attitude
+   * @param attitude [roll, pitch, heading] of the source frame relative to the
+   * destination frame, degrees. Same convention as so::Rotate::body_2_earth()
+   * @param translation Origin of the source frame in the destination frame
+   */
+  Rigid_transform(const Eigen::Vector3d& attitude,
+                  const Eigen::Vector3d& translation = Eigen::Vector3d::Zero());
+
+  /**
+   * @brief Get the rotation
+   * @return Rotation from the source frame to the destination frame
+   */
+  const Eigen::Quaterniond& Get_rotation() const;
+
+  /**
+   * @brief Get the translation
+   * @return Origin of the source frame in the destination frame
+   */
+  const Eigen::Vector3d& Get_translation() const;
+
+  /**
+   * @brief Transform a point
+   * @param p Point in the source frame
+   * @return Point in the destination frame
+   */
+  Eigen::Vector3d Apply(const Eigen::Vector3d& p) const;
+
+  /**
+   * @brief Transform a set of points
+   * @param p Points in the source frame, one per column
+   * @return Points in the destination frame, one per column
+   */
+  Eigen::Matrix3Xd Apply(const Eigen::Matrix3Xd& p) const;
+
+  /**
+   * @brief Get the inverse transform
+   * @return Transform from the destination frame to the source frame
+   */
+  Rigid_transform Inverse() const;
+
+  /**
+   * @brief Compose two transforms
+   * @param other Transform applied first
+   * @return Transform equivalent to applying other, then this
+   */
+  Rigid_transform operator*(const Rigid_transform& other) const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+  /**
+   * @brief m_rotation Rotation from the source frame to the destination frame
+   */
+  Eigen::Quaterniond m_rotation;
+
+  /**
+   * @brief m_translation Origin of the source frame in the destination frame
+   */
+  Eigen::Vector3d m_translation;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+class Transform_graph_impl;
+
+class Transform_graph
+{
+public:
+  /**
+   * @brief Handle to a dynamic edge
+   */
+  typedef size_t Edge_id;
+
+  /**
+   * @brief Handle to a registered source->target chain
+   */
+  typedef size_t Chain_id;
+
+  /**
+   * @brief Constructor, an empty graph
+   */
+  Transform_graph();
+
+  /**
+   * @brief Destructor
+   */
+  ~Transform_graph();
+
+  // The graph holds atomics shared with reader threads, so it can be moved
+  // but not copied
+  Transform_graph(const Transform_graph& other) = delete;
+  Transform_graph& operator=(const Transform_graph& other) = delete;
+  Transform_graph(Transform_graph&& other);
+  Transform_graph& operator=(Transform_graph&& other);
+
+  /**
+   * @brief Add an edge whose transform never changes. Frames are created the
+   * first time they are named
+   * @param child Name of the child frame
+   * @param parent Name of the parent frame
+   * @param child_2_parent Transform from the child frame to the parent frame
+   * @throws so::Invalid_argument if child already has a parent or the edge
+   * would create a cycle
+   */
+  void Add_static_edge(const std::string& child,
+                       const std::string& parent,
+                       const Rigid_transform& child_2_parent);
+
+  /**
+   * @brief Add an edge whose transform is updated with Update_edge(). The
+   * transform is the identity until the first update
+   * @param child Name of the child frame
+   * @param parent Name of the parent frame
+   * @return Handle for updating the edge
+   * @throws so::Invalid_argument if child already has a parent or the edge
+   * would create a cycle
+   */
+  Edge_id Add_dynamic_edge(const std::string& child,
+                           const std::string& parent);
+
+  /**
+   * @brief Register a source->target composition to be cached
+   * @param source Name of the source frame
+   * @param target Name of the target frame
+   * @return Handle for looking up the composition
+   * @throws so::Invalid_argument if either frame does not exist or the frames
+   * are not connected
+   */
+  Chain_id Add_chain(const std::string& source, const std::string& target);
+
+  /**
+   * @brief Set the transform of a dynamic edge. Lock-free
+   * @param edge Handle returned by Add_dynamic_edge()
+   * @param child_2_parent Transform from the child frame to the parent frame
+   * @throws so::Invalid_argument if edge is not a valid handle
+   */
+  void Update_edge(const Edge_id edge, const Rigid_transform& child_2_parent);
+
+  /**
+   * @brief Get the current source->target transform of a chain. Lock-free;
+   * returns the cached composition unless a dynamic edge on the chain has
+   * been updated since it was computed
+   * @param chain Handle returned by Add_chain()
+   * @return Transform from the chain's source frame to its target frame
+   * @throws so::Invalid_argument if chain is not a valid handle
+   */
+  Rigid_transform Lookup(const Chain_id chain) const;
+
+private:
+  /**
+   * @brief m_pimpl Implementation class
+   */
+  std::unique_ptr<Transform_graph_impl> m_pimpl;
+};
+
+} // namespace so
+
+#endif
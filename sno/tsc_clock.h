@@ -0,0 +1,156 @@
+/**
+ * @class Tsc_clock
+ * @brief Monotonic clock read from the CPU timestamp counter.
+ *
+ * Reading the counter takes a few nanoseconds and no system call, which makes
+ * it suitable for timing very short sections of code. The counter is only
+ * used if the CPU reports an invariant TSC (constant rate, not stopped in
+ * sleep states); otherwise, and on other architectures, the clock falls back
+ * to clock_gettime(CLOCK_MONOTONIC) and its ticks are nanoseconds.
+ *
+ * The tick rate is calibrated against std::chrono::steady_clock the first
+ * time the clock is used, which takes about 20 ms.
+ */
+
+#ifndef SO_TSC_CLOCK_H
+#define SO_TSC_CLOCK_H
+
+#include <stdint.h>
+#include <sno/clock.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SO_TSC_CLOCK_X86 1
+#endif
+
+namespace so
+{
+
+/**
+ * @brief Multiply by a 32.32 fixed point factor, (a * b) >> 32, without
+ * overflowing the intermediate product
+ * @param a Value
+ * @param b Factor, 32.32 fixed point, not negative
+ * @return Product, rounded down
+ */
+inline int64_t Mul_q32(const int64_t a, const int64_t b)
+{
+#ifdef __SIZEOF_INT128__
+  return static_cast<int64_t>((static_cast<__int128>(a) * b) >> 32);
+#else
+  // Split both into 32 bit halves; only the low halves' product has bits
+  // below the binary point
+  int64_t a_high = a >> 32;
+  uint64_t a_low = static_cast<uint64_t>(a) & 0xFFFFFFFFu;
+  int64_t b_high = b >> 32;
+  uint64_t b_low = static_cast<uint64_t>(b) & 0xFFFFFFFFu;
+  return static_cast<int64_t>(static_cast<uint64_t>(a_high * b_high) << 32)
+      + a_high * static_cast<int64_t>(b_low)
+      + static_cast<int64_t>(a_low) * b_high
+      + static_cast<int64_t>((a_low * b_low) >> 32);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+class Tsc_clock
+{
+public:
+  /**
+   * @brief Read the clock
+   * @return Ticks since an arbitrary start point
+   */
+  static int64_t Now()
+  {
+#ifdef SO_TSC_CLOCK_X86
+    if(calibration().tsc)
+    {
+      return static_cast<int64_t>(__rdtsc());
+    }
+#endif
+    return Clock::Real_monotonic_ns();
+  }
+
+  /**
+   * @brief Read the clock once every earlier instruction has finished, for
+   * the end of a timed section. Later instructions may still start early
+   * @return Ticks since the same start point as Now()
+   */
+  static int64_t Now_serialized()
+  {
+#ifdef SO_TSC_CLOCK_X86
+    if(calibration().tsc)
+    {
+      unsigned int aux;
+      return static_cast<int64_t>(__rdtscp(&aux));
+    }
+#endif
+    return Clock::Real_monotonic_ns();
+  }
+
+  /**
+   * @brief Convert ticks to nanoseconds
+   * @param ticks Difference between two readings
+   * @return Nanoseconds
+   */
+  static int64_t To_ns(const int64_t ticks)
+  {
+    return Mul_q32(ticks, calibration().ns_per_tick_q32);
+  }
+
+  /**
+   * @brief Convert ticks to seconds
+   * @param ticks Difference between two readings
+   * @return Seconds
+   */
+  static double To_seconds(const int64_t ticks)
+  {
+    return static_cast<double>(ticks) / calibration().ticks_per_second;
+  }
+
+  /**
+   * @brief Check whether the timestamp counter is in use
+   * @return False if the clock fell back to clock_gettime()
+   */
+  static bool Is_tsc()
+  {
+    return calibration().tsc;
+  }
+
+  /**
+   * @brief Get the tick rate
+   * @return Ticks per second, 1e9 if the clock fell back to clock_gettime()
+   */
+  static double Get_ticks_per_second()
+  {
+    return calibration().ticks_per_second;
+  }
+
+private:
+  /**
+   * @brief Result of the calibration
+   */
+  struct Calibration
+  {
+    bool tsc;                ///< True if the timestamp counter is used
+    double ticks_per_second;
+    int64_t ns_per_tick_q32; ///< Nanoseconds per tick, 32.32 fixed point
+  };
+
+  /**
+   * @brief Get the calibration, measuring it on first use
+   */
+  static const Calibration& calibration()
+  {
+    static const Calibration c = calibrate();
+    return c;
+  }
+
+  /**
+   * @brief Detect an invariant TSC and measure its rate
+   */
+  static Calibration calibrate();
+};
+
+} // namespace so
+
+#endif
@@ -0,0 +1,656 @@
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sno/binary_log.h>
+#include <sno/logger.h>
+#include <sno/so_exception.h>
+
+namespace
+{
+
+const char MAGIC[8] = {'S', 'N', 'O', 'B', 'L', 'O', 'G', '1'};
+
+/**
+ * @brief Size of [uint8 type][uint32 length]
+ */
+const size_t RECORD_HEADER_SIZE = 5;
+
+/**
+ * @brief Single-producer, single-consumer byte ring. The owning thread copies
+ * whole records in; the writer thread copies out everything between tail and
+ * head, so the file only ever sees complete records
+ */
+struct Ring
+{
+  explicit Ring(const size_t size)
+    :
+      mask(round_up(size) - 1),
+      data(new char[mask + 1]),
+      head(0),
+      tail(0),
+      closed(false)
+  {
+  }
+
+  static size_t round_up(const size_t n)
+  {
+    size_t p = 64;
+    while(p < n)
+    {
+      p <<= 1;
+    }
+    return p;
+  }
+
+  const size_t mask;
+  std::unique_ptr<char[]> data;
+  char pad_0[64];
+  boost::atomic<uint64_t> head;   ///< Written by the owning thread
+  char pad_1[64];
+  boost::atomic<uint64_t> tail;   ///< Written by the writer thread
+  boost::atomic<bool> closed;     ///< Set when the owning thread exits
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief The calling thread's ring and the generation it belongs to
+ */
+struct Thread_ring
+{
+  Thread_ring()
+    :
+      ring(),
+      generation(0)
+  {
+  }
+
+  ~Thread_ring()
+  {
+    if(ring)
+    {
+      ring->closed.store(true, boost::memory_order_release);
+    }
+  }
+
+  std::shared_ptr<Ring> ring;
+  uint32_t generation;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct State
+{
+  State()
+    :
+      control(),
+      mutex(),
+      file(),
+      thread(),
+      running(false),
+      ring_size(0),
+      next_site(1),
+      new_rings(),
+      rings(),
+      sites(),
+      passes(0),
+      dropped(0),
+      committing(0)
+  {
+  }
+
+  ~State()
+  {
+    so::Binary_log::Close();
+  }
+
+  std::mutex control;                         ///< Serializes Open() and Close()
+  std::mutex mutex;                           ///< Guards the members below
+  std::ofstream file;
+  std::thread thread;
+  boost::atomic<bool> running;
+  size_t ring_size;
+  uint32_t next_site;
+  std::vector<std::shared_ptr<Ring> > new_rings;
+  std::vector<std::shared_ptr<Ring> > rings;  ///< Writer thread only
+  std::vector<char> sites;                    ///< Site records not yet written
+  boost::atomic<uint64_t> passes;             ///< Completed writer passes
+  boost::atomic<uint64_t> dropped;
+  boost::atomic<uint32_t> committing;         ///< Commit() calls in progress
+};
+
+State& state()
+{
+  static State s;
+  return s;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Ends a Commit() call counted in State::committing
+ */
+struct Committing
+{
+  explicit Committing(State& s)
+    :
+      s(s)
+  {
+  }
+
+  ~Committing()
+  {
+    s.committing.fetch_sub(1, boost::memory_order_release);
+  }
+
+  State& s;
+};
+
+Thread_ring& thread_ring()
+{
+  thread_local Thread_ring t;
+  return t;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+template<class V>
+void put_raw(std::vector<char>& out, const V& v)
+{
+  size_t n = out.size();
+  out.resize(n + sizeof(V));
+  memcpy(&out[n], &v, sizeof(V));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Copy everything committed to the thread rings into the file
+ * @return True if anything was written
+ */
+bool write_pass(State& s)
+{
+  std::vector<char> sites;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    sites.swap(s.sites);
+    s.rings.insert(s.rings.end(), s.new_rings.begin(), s.new_rings.end());
+    s.new_rings.clear();
+  }
+  bool wrote = !sites.empty();
+  s.file.write(sites.data(), sites.size());
+
+  for(auto it = s.rings.begin(); it != s.rings.end();)
+  {
+    Ring& r = **it;
+    bool closed = r.closed.load(boost::memory_order_acquire);
+    uint64_t head = r.head.load(boost::memory_order_acquire);
+    uint64_t tail = r.tail.load(boost::memory_order_relaxed);
+    if(head != tail)
+    {
+      size_t start = tail & r.mask;
+      size_t n = head - tail;
+      size_t first = std::min(n, r.mask + 1 - start);
+      s.file.write(&r.data[start], first);
+      s.file.write(&r.data[0], n - first);
+      r.tail.store(head, boost::memory_order_release);
+      wrote = true;
+    }
+    if(closed)
+    {
+      it = s.rings.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  if(wrote)
+  {
+    s.file.flush();
+  }
+  s.passes.fetch_add(1, boost::memory_order_release);
+  return wrote;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void run(State& s)
+{
+  while(s.running.load(boost::memory_order_acquire))
+  {
+    if(!write_pass(s))
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  // Close() was called: write whatever is left, including records from
+  // Commit() calls that saw the file still open
+  while(true)
+  {
+    bool committing = s.committing.load() != 0;
+    if(!write_pass(s) && !committing)
+    {
+      break;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Reads values out of a record, throwing if it runs past the end
+ */
+class Reader
+{
+public:
+  Reader(const char* begin, const char* end)
+    :
+      m_pos(begin),
+      m_end(end)
+  {
+  }
+
+  template<class V>
+  V Get()
+  {
+    V v;
+    memcpy(&v, Take(sizeof(V)), sizeof(V));
+    return v;
+  }
+
+  const char* Take(const size_t n)
+  {
+    if(static_cast<size_t>(m_end - m_pos) < n)
+    {
+      throw so::Read_error("Binary log record is truncated");
+    }
+    const char* p = m_pos;
+    m_pos += n;
+    return p;
+  }
+
+  bool At_end() const
+  {
+    return m_pos == m_end;
+  }
+
+private:
+  const char* m_pos;
+  const char* m_end;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+void put_utf8(std::ostream& out, const uint32_t c)
+{
+  if(c < 0x80)
+  {
+    out.put(static_cast<char>(c));
+  }
+  else if(c < 0x800)
+  {
+    out.put(static_cast<char>(0xC0 | (c >> 6)));
+    out.put(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+  else if(c < 0x10000)
+  {
+    out.put(static_cast<char>(0xE0 | (c >> 12)));
+    out.put(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+    out.put(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+  else
+  {
+    out.put(static_cast<char>(0xF0 | (c >> 18)));
+    out.put(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+    out.put(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+    out.put(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Format one argument the way the text logger would have
+ */
+void format_argument(Reader& in, std::ostream& out)
+{
+  uint8_t tag = in.Get<uint8_t>();
+  switch(tag)
+  {
+    case so::Binary_log::Tag_bool:   out << static_cast<bool>(in.Get<uint8_t>()); return;
+    case so::Binary_log::Tag_char:   out << in.Get<char>(); return;
+    case so::Binary_log::Tag_wchar:  put_utf8(out, in.Get<uint32_t>()); return;
+    case so::Binary_log::Tag_int | 1:  out << static_cast<int>(in.Get<int8_t>()); return;
+    case so::Binary_log::Tag_int | 2:  out << in.Get<int16_t>(); return;
+    case so::Binary_log::Tag_int | 4:  out << in.Get<int32_t>(); return;
+    case so::Binary_log::Tag_int | 8:  out << in.Get<int64_t>(); return;
+    case so::Binary_log::Tag_uint | 1: out << static_cast<unsigned>(in.Get<uint8_t>()); return;
+    case so::Binary_log::Tag_uint | 2: out << in.Get<uint16_t>(); return;
+    case so::Binary_log::Tag_uint | 4: out << in.Get<uint32_t>(); return;
+    case so::Binary_log::Tag_uint | 8: out << in.Get<uint64_t>(); return;
+    case so::Binary_log::Tag_float:  out << in.Get<float>(); return;
+    case so::Binary_log::Tag_double: out << in.Get<double>(); return;
+    case so::Binary_log::Tag_string:
+    {
+      uint32_t n = in.Get<uint32_t>();
+      out.write(in.Take(n), n);
+      return;
+    }
+    case so::Binary_log::Tag_wstring:
+    {
+      uint32_t n = in.Get<uint32_t>();
+      for(uint32_t i = 0; i < n; i++)
+      {
+        put_utf8(out, in.Get<uint32_t>());
+      }
+      return;
+    }
+  }
+  throw so::Read_error("Unknown binary log argument tag: ",
+                       static_cast<unsigned>(tag));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief A decoded message waiting to be sorted
+ */
+struct Message
+{
+  int64_t ns;
+  uint32_t site;
+  uint64_t level;
+  std::string scope;  ///< Only for messages without a registered site
+  std::string text;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write 'YYYY-MM-DD HH:MM:SS.nnnnnnnnn ' in UTC
+ */
+void format_time(std::ostream& out, const int64_t ns)
+{
+  int64_t sec = ns / 1000000000;
+  int64_t frac = ns % 1000000000;
+  if(frac < 0)
+  {
+    sec--;
+    frac += 1000000000;
+  }
+  time_t t = static_cast<time_t>(sec);
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d.%09lld ",
+           tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+           tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<long long>(frac));
+  out << buf;
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+boost::atomic<bool> so::Binary_log::m_open(false);
+boost::atomic<uint32_t> so::Binary_log::m_generation(0);
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Binary_log::Open(const std::string& filename,
+                          const size_t thread_buffer_size)
+{
+  State& s = state();
+  std::lock_guard<std::mutex> control(s.control);
+  if(s.thread.joinable())
+  {
+    m_open.store(false);
+    s.running.store(false);
+    s.thread.join();
+    s.file.close();
+  }
+
+  std::ofstream file(filename.c_str(),
+                     std::ios_base::binary | std::ios_base::trunc);
+  if(!file)
+  {
+    throw so::Write_error("Could not open binary log file '", filename, "'");
+  }
+  file.write(MAGIC, sizeof(MAGIC));
+
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.file = std::move(file);
+    s.ring_size = thread_buffer_size;
+    s.next_site = 1;
+    s.new_rings.clear();
+    s.rings.clear();
+    s.sites.clear();
+  }
+  m_generation.fetch_add(1);
+  s.running.store(true);
+  s.thread = std::thread(run, std::ref(s));
+  m_open.store(true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Binary_log::Close()
+{
+  State& s = state();
+  std::lock_guard<std::mutex> control(s.control);
+  if(!s.thread.joinable())
+  {
+    return;
+  }
+  m_open.store(false);
+  s.running.store(false);
+  s.thread.join();
+  s.file.close();
+
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.new_rings.clear();
+  s.rings.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+uint32_t so::Binary_log::Register_site(const char* function)
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  uint32_t id = s.next_site++;
+  size_t len = strlen(function);
+  s.sites.push_back(static_cast<char>(Site_record));
+  put_raw(s.sites,
+          static_cast<uint32_t>(RECORD_HEADER_SIZE + sizeof(id) + len));
+  put_raw(s.sites, id);
+  s.sites.insert(s.sites.end(), function, function + len);
+  return id;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Binary_log::Begin_message(std::vector<char>& out,
+                                   const uint32_t site,
+                                   const uint64_t level,
+                                   const int64_t ns)
+{
+  out.clear();
+  out.push_back(static_cast<char>(Message_record));
+  put_raw(out, static_cast<uint32_t>(0));
+  put_raw(out, site);
+  put_raw(out, level);
+  put_raw(out, ns);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Binary_log::Commit(std::vector<char>& out)
+{
+  State& s = state();
+  // Either the writer sees this call in progress before it exits, or this
+  // call sees the file closed and counts the record as dropped
+  s.committing.fetch_add(1);
+  Committing committing(s);
+  if(!m_open.load())
+  {
+    s.dropped.fetch_add(1, boost::memory_order_relaxed);
+    return;
+  }
+
+  uint32_t len = static_cast<uint32_t>(out.size());
+  memcpy(&out[1], &len, sizeof(len));
+
+  Thread_ring& t = thread_ring();
+  uint32_t generation = Get_generation();
+  if(!t.ring || t.generation != generation)
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if(t.ring)
+    {
+      t.ring->closed.store(true, boost::memory_order_release);
+    }
+    t.ring = std::make_shared<Ring>(s.ring_size);
+    t.generation = generation;
+    s.new_rings.push_back(t.ring);
+  }
+
+  Ring& r = *t.ring;
+  size_t capacity = r.mask + 1;
+  if(len > capacity)
+  {
+    s.dropped.fetch_add(1, boost::memory_order_relaxed);
+    return;
+  }
+  uint64_t head = r.head.load(boost::memory_order_relaxed);
+  while(capacity - (head - r.tail.load(boost::memory_order_acquire)) < len)
+  {
+    if(!Is_open())
+    {
+      s.dropped.fetch_add(1, boost::memory_order_relaxed);
+      return;
+    }
+    std::this_thread::yield();
+  }
+  size_t start = head & r.mask;
+  size_t first = std::min<size_t>(len, capacity - start);
+  memcpy(&r.data[start], out.data(), first);
+  memcpy(&r.data[0], out.data() + first, len - first);
+  r.head.store(head + len, boost::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Binary_log::Flush()
+{
+  State& s = state();
+  // A pass that starts after this call sees every committed record, and the
+  // second pass to complete from now is such a pass
+  uint64_t target = s.passes.load(boost::memory_order_acquire) + 2;
+  while(Is_open() && s.passes.load(boost::memory_order_acquire) < target)
+  {
+    std::this_thread::yield();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t so::Binary_log::Get_dropped()
+{
+  return state().dropped.load(boost::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Binary_log::Decode(std::istream& in, std::ostream& out)
+{
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  if(data.size() < sizeof(MAGIC)
+     || data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0)
+  {
+    throw so::Read_error("Not a binary log file");
+  }
+
+  // Threads write their records in batches, so sites may follow the messages
+  // that use them and messages are only ordered within a thread
+  std::map<uint32_t, std::string> sites;
+  std::vector<Message> messages;
+  Reader file(data.data() + sizeof(MAGIC), data.data() + data.size());
+  while(!file.At_end())
+  {
+    uint8_t type = file.Get<uint8_t>();
+    uint32_t len = file.Get<uint32_t>();
+    if(len < RECORD_HEADER_SIZE)
+    {
+      throw so::Read_error("Binary log record has invalid length ", len);
+    }
+    size_t payload_size = len - RECORD_HEADER_SIZE;
+    const char* payload = file.Take(payload_size);
+    Reader record(payload, payload + payload_size);
+
+    if(type == Site_record)
+    {
+      uint32_t id = record.Get<uint32_t>();
+      const char* function = payload + sizeof(id);
+      std::string& prefix = sites[id];
+      prefix = Log_site<char>(
+            std::string(function, payload + payload_size).c_str()).Get_prefix();
+    }
+    else if(type == Message_record)
+    {
+      Message m;
+      m.site = record.Get<uint32_t>();
+      m.level = record.Get<uint64_t>();
+      m.ns = record.Get<int64_t>();
+      std::ostringstream ss;
+      if(m.site == 0 && !record.At_end())
+      {
+        format_argument(record, ss);
+        m.scope = Log_site<char>(ss.str().c_str()).Get_prefix();
+        ss.str("");
+      }
+      while(!record.At_end())
+      {
+        format_argument(record, ss);
+      }
+      m.text = ss.str();
+      messages.push_back(std::move(m));
+    }
+    else
+    {
+      throw so::Read_error("Unknown binary log record type: ",
+                           static_cast<unsigned>(type));
+    }
+  }
+
+  std::stable_sort(messages.begin(), messages.end(),
+                   [](const Message& a, const Message& b)
+                   {
+                     return a.ns < b.ns;
+                   });
+  for(const Message& m : messages)
+  {
+    format_time(out, m.ns);
+    out << Logger::Get_level_prefix(m.level);
+    if(m.site == 0)
+    {
+      out << m.scope;
+    }
+    else
+    {
+      auto it = sites.find(m.site);
+      out << (it != sites.end() ? it->second : std::string("[?] "));
+    }
+    out << m.text << '\n';
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
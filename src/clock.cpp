@@ -0,0 +1,53 @@
+#include <sno/clock.h>
+#include <sno/so_exception.h>
+#include <sno/time_utils.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Clock::~Clock() = default;
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Clock::Set_current(Clock* clock)
+{
+  current().store(clock, boost::memory_order_seq_cst);
+  // The cached clock does not store while a clock is installed, and clearing
+  // its value sends Cached_unix_time_ns() to this clock. See Cached_clock
+  Time_utils::Cached_time_value().store(0, boost::memory_order_seq_cst);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Virtual_clock::Virtual_clock(const int64_t start_unix_ns)
+  :
+    m_start_unix(start_unix_ns),
+    m_elapsed(0)
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Virtual_clock::Set_unix_ns(const int64_t unix_ns)
+{
+  int64_t elapsed = unix_ns - m_start_unix;
+  if(elapsed < m_elapsed.load(boost::memory_order_relaxed))
+  {
+    throw so::Invalid_argument("Virtual clock cannot move back from ",
+                               Unix_ns(), " ns to ", unix_ns, " ns");
+  }
+  m_elapsed.store(elapsed, boost::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Virtual_clock::Advance_ns(const int64_t ns)
+{
+  if(ns < 0)
+  {
+    throw so::Invalid_argument("Virtual clock cannot advance by ", ns, " ns");
+  }
+  m_elapsed.fetch_add(ns, boost::memory_order_acq_rel);
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,211 @@
+#include <math.h>
+#include <algorithm>
+#include <sno/clock_mapper.h>
+#include <sno/so_exception.h>
+
+namespace
+{
+
+/**
+ * @brief The rate estimate uses readings at least this far apart
+ */
+const int64_t MIN_RATE_BASELINE_NS = 1000000000;
+
+/**
+ * @brief Readings further apart than this restart the rate estimate, so that
+ * it follows changes of the wall clock's rate
+ */
+const int64_t MAX_RATE_BASELINE_NS = 64000000000LL;
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Time_utils::Clock_mapper::Clock_mapper(const Source source,
+                                           const int64_t step_threshold_ns,
+                                           const double max_slew_ppm)
+  :
+    m_source(source),
+    m_step_threshold(step_threshold_ns),
+    m_max_slew(max_slew_ppm * 1e-6),
+    m_sequence(0),
+    m_base_raw(0),
+    m_base_unix(0),
+    m_scale_q32(0),
+    m_steps(0),
+    m_last_error(0),
+    m_update_mutex(),
+    m_rate_q32(source == Tsc ? Tsc_clock::To_ns(INT64_C(1) << 32)
+                             : INT64_C(1) << 32),
+    m_ref_raw(0),
+    m_ref_unix(0),
+    m_last_raw(0),
+    m_thread_mutex(),
+    m_wake(),
+    m_thread(),
+    m_running(false),
+    m_generation(0),
+    m_period(100)
+{
+  if(step_threshold_ns <= 0 || !(max_slew_ppm > 0.0))
+  {
+    throw so::Invalid_argument("Clock mapper step threshold and slew rate must"
+                               " be positive, got ", step_threshold_ns,
+                               " ns and ", max_slew_ppm, " ppm");
+  }
+  int64_t raw, unix_ns;
+  sample(raw, unix_ns);
+  m_ref_raw = raw;
+  m_ref_unix = unix_ns;
+  m_last_raw = raw;
+  write_model(Model{raw, unix_ns, m_rate_q32});
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Time_utils::Clock_mapper::~Clock_mapper()
+{
+  Stop();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Time_utils::Clock_mapper::Update()
+{
+  int64_t raw, unix_ns;
+  sample(raw, unix_ns);
+  Update(raw, unix_ns);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Time_utils::Clock_mapper::Update(const int64_t raw,
+                                          const int64_t unix_ns)
+{
+  std::lock_guard<std::mutex> lock(m_update_mutex);
+  Model current{m_base_raw.load(boost::memory_order_relaxed),
+                m_base_unix.load(boost::memory_order_relaxed),
+                m_scale_q32.load(boost::memory_order_relaxed)};
+  int64_t predicted = apply(current, raw);
+  int64_t error = unix_ns - predicted;
+  m_last_error.store(error, boost::memory_order_relaxed);
+
+  if(error > m_step_threshold || error < -m_step_threshold)
+  {
+    // The wall clock was stepped, or the raw clock stopped. Follow it at once
+    // and start the rate estimate again
+    m_steps.fetch_add(1, boost::memory_order_relaxed);
+    m_ref_raw = raw;
+    m_ref_unix = unix_ns;
+    m_last_raw = raw;
+    write_model(Model{raw, unix_ns, m_rate_q32});
+    return;
+  }
+
+  int64_t baseline_ns = unix_ns - m_ref_unix;
+  if(baseline_ns >= MIN_RATE_BASELINE_NS && raw > m_ref_raw)
+  {
+    m_rate_q32 = static_cast<int64_t>(
+          (static_cast<__int128>(baseline_ns) << 32) / (raw - m_ref_raw));
+    if(baseline_ns >= MAX_RATE_BASELINE_NS)
+    {
+      m_ref_raw = raw;
+      m_ref_unix = unix_ns;
+    }
+  }
+
+  // Remove the error over about one update period, starting from where the
+  // current model is now so that converted times do not jump
+  int64_t interval_ns = apply(Model{0, 0, m_rate_q32}, raw - m_last_raw);
+  double correction = static_cast<double>(error) /
+                      std::max<int64_t>(interval_ns, 1000000);
+  correction = std::min(std::max(correction, -m_max_slew), m_max_slew);
+  m_last_raw = raw;
+  write_model(Model{raw, predicted,
+                    static_cast<int64_t>(llround(m_rate_q32 *
+                                                 (1.0 + correction)))});
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Time_utils::Clock_mapper::Start(const std::chrono::milliseconds period)
+{
+  std::lock_guard<std::mutex> lock(m_thread_mutex);
+  m_period = period;
+  if(m_running)
+  {
+    m_wake.notify_all();
+    return;
+  }
+  m_running = true;
+  m_generation++;
+  m_thread = std::thread(&Clock_mapper::run, this, m_generation);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Time_utils::Clock_mapper::Stop()
+{
+  // The thread needs the lock to finish, so it is joined outside it
+  std::thread finished;
+  {
+    std::lock_guard<std::mutex> lock(m_thread_mutex);
+    m_running = false;
+    finished.swap(m_thread);
+  }
+  m_wake.notify_all();
+  if(finished.joinable())
+  {
+    finished.join();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Time_utils::Clock_mapper::write_model(const Model& m)
+{
+  uint64_t sequence = m_sequence.load(boost::memory_order_relaxed);
+  m_sequence.store(sequence + 1, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+  m_base_raw.store(m.base_raw, boost::memory_order_relaxed);
+  m_base_unix.store(m.base_unix, boost::memory_order_relaxed);
+  m_scale_q32.store(m.scale_q32, boost::memory_order_relaxed);
+  m_sequence.store(sequence + 2, boost::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Time_utils::Clock_mapper::sample(int64_t& raw, int64_t& unix_ns) const
+{
+  // Keep the wall clock reading with the fewest raw units either side of it,
+  // and take the raw clock to be halfway between
+  int64_t best = INT64_MAX;
+  for(int i = 0; i < 8; i++)
+  {
+    int64_t before = Now_raw();
+    int64_t now = Clock::Real_unix_ns();
+    int64_t after = Now_raw();
+    if(after - before < best)
+    {
+      best = after - before;
+      raw = before + best / 2;
+      unix_ns = now;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Time_utils::Clock_mapper::run(const uint64_t generation)
+{
+  std::unique_lock<std::mutex> lock(m_thread_mutex);
+  while(m_running && m_generation == generation)
+  {
+    lock.unlock();
+    Update();
+    lock.lock();
+    m_wake.wait_for(lock, m_period);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
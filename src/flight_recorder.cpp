@@ -0,0 +1,503 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <sno/flight_recorder.h>
+#include <sno/log_clock.h>
+#include <sno/so_exception.h>
+
+namespace
+{
+
+/**
+ * @brief One thread's messages. Only the owning thread writes; dumps read
+ */
+struct Ring
+{
+  explicit Ring(const size_t size)
+    :
+      mask(size - 1),
+      data(new char[size]),
+      pos(0),
+      in_use(true),
+      tid(0),
+      next(nullptr)
+  {
+  }
+
+  const size_t mask;
+  std::unique_ptr<char[]> data;
+  std::atomic<uint64_t> pos;   ///< Total bytes ever written
+  std::atomic<bool> in_use;    ///< True while a thread owns the ring
+  std::atomic<long> tid;       ///< Owning thread
+  Ring* next;                  ///< Next ring in the recorder's list
+};
+
+size_t round_up(const size_t n)
+{
+  size_t p = 256;
+  while(p < n)
+  {
+    p <<= 1;
+  }
+  return p;
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+struct so::Flight_recorder_state
+{
+  explicit Flight_recorder_state(const size_t size)
+    :
+      ring_size(round_up(size)),
+      rings(nullptr)
+  {
+  }
+
+  ~Flight_recorder_state()
+  {
+    Ring* r = rings.load();
+    while(r)
+    {
+      Ring* next = r->next;
+      delete r;
+      r = next;
+    }
+  }
+
+  const size_t ring_size;
+
+  /**
+   * @brief Singly linked list of rings. Rings are only ever added, so dumps
+   * can walk it without locks
+   */
+  std::atomic<Ring*> rings;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/**
+ * @brief The calling thread's ring, released for reuse when the thread exits
+ */
+struct Thread_slot
+{
+  Thread_slot()
+    :
+      state(),
+      ring(nullptr)
+  {
+  }
+
+  ~Thread_slot()
+  {
+    if(ring)
+    {
+      ring->in_use.store(false, std::memory_order_release);
+    }
+  }
+
+  std::shared_ptr<so::Flight_recorder_state> state;
+  Ring* ring;
+};
+
+Thread_slot& thread_slot()
+{
+  thread_local Thread_slot slot;
+  return slot;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Give the calling thread a ring of this recorder, reusing one whose
+ * thread has exited if possible
+ */
+void claim(Thread_slot& slot,
+           const std::shared_ptr<so::Flight_recorder_state>& state)
+{
+  if(slot.ring)
+  {
+    slot.ring->in_use.store(false, std::memory_order_release);
+    slot.ring = nullptr;
+  }
+  slot.state = state;
+  for(Ring* r = state->rings.load(std::memory_order_acquire); r; r = r->next)
+  {
+    bool expected = false;
+    if(r->in_use.compare_exchange_strong(expected, true,
+                                         std::memory_order_acq_rel))
+    {
+      slot.ring = r;
+      break;
+    }
+  }
+  if(!slot.ring)
+  {
+    Ring* r = new Ring(state->ring_size);
+    r->next = state->rings.load(std::memory_order_relaxed);
+    while(!state->rings.compare_exchange_weak(r->next, r,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed))
+    {
+    }
+    slot.ring = r;
+  }
+  slot.ring->tid.store(syscall(SYS_gettid), std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get the calling thread's ring of a recorder
+ */
+Ring& thread_ring(const std::shared_ptr<so::Flight_recorder_state>& state)
+{
+  Thread_slot& slot = thread_slot();
+  if(slot.state != state)
+  {
+    claim(slot, state);
+  }
+  return *slot.ring;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Copy bytes into a ring at pos, wrapping around
+ */
+void put(Ring& r, uint64_t& pos, const char* p, size_t n)
+{
+  while(n > 0)
+  {
+    size_t offset = pos & r.mask;
+    size_t k = std::min(n, r.mask + 1 - offset);
+    memcpy(&r.data[offset], p, k);
+    pos += k;
+    p += k;
+    n -= k;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Encode one character as UTF-8
+ * @param out Buffer of at least 4 bytes
+ * @return Number of bytes written
+ */
+size_t encode_utf8(const uint32_t c, char* out)
+{
+  if(c < 0x80)
+  {
+    out[0] = static_cast<char>(c);
+    return 1;
+  }
+  if(c < 0x800)
+  {
+    out[0] = static_cast<char>(0xC0 | (c >> 6));
+    out[1] = static_cast<char>(0x80 | (c & 0x3F));
+    return 2;
+  }
+  if(c < 0x10000)
+  {
+    out[0] = static_cast<char>(0xE0 | (c >> 12));
+    out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (c & 0x3F));
+    return 3;
+  }
+  out[0] = static_cast<char>(0xF0 | (c >> 18));
+  out[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+  out[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+  out[3] = static_cast<char>(0x80 | (c & 0x3F));
+  return 4;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write an unsigned integer, zero padded to width digits
+ * @return Pointer past the last digit
+ */
+char* format_uint(char* out, uint64_t v, const int width)
+{
+  char digits[20];
+  int n = 0;
+  do
+  {
+    digits[n++] = static_cast<char>('0' + v % 10);
+    v /= 10;
+  }while(v > 0);
+  while(n < width)
+  {
+    digits[n++] = '0';
+  }
+  while(n > 0)
+  {
+    *out++ = digits[--n];
+  }
+  return out;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write the time for a message. Reads the coarse wall clock, which is
+ * plenty for ordering a crash's last messages and much cheaper than
+ * CLOCK_REALTIME
+ * @param out Buffer of at least so::Log_clock::MAX_TEXT characters
+ * @return Number of characters written
+ */
+size_t format_timestamp(char* out)
+{
+  return so::Log_clock::Format(so::Log_clock::Wall_coarse,
+                               so::Log_clock::Now(so::Log_clock::Wall_coarse),
+                               out);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write all of a buffer, retrying after interruptions. Async-signal-safe
+ */
+void write_all(const int fd, const char* p, size_t n)
+{
+  while(n > 0)
+  {
+    ssize_t k = write(fd, p, n);
+    if(k < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      return;
+    }
+    p += k;
+    n -= k;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write every ring to a file descriptor. Async-signal-safe
+ */
+void dump_state(const so::Flight_recorder_state& state, const int fd)
+{
+  for(Ring* r = state.rings.load(std::memory_order_acquire); r; r = r->next)
+  {
+    uint64_t end = r->pos.load(std::memory_order_acquire);
+    if(end == 0)
+    {
+      continue;
+    }
+    size_t size = r->mask + 1;
+    uint64_t start = 0;
+    if(end > size)
+    {
+      // Leave out the part most likely to be overwritten while we write,
+      // then skip to the start of the next whole line
+      start = end - size + size / 16;
+      while(start < end && r->data[start++ & r->mask] != '\n')
+      {
+      }
+    }
+
+    char header[64];
+    const char title[] = "==== so::Flight_recorder thread ";
+    char* p = header;
+    memcpy(p, title, sizeof(title) - 1);
+    p += sizeof(title) - 1;
+    p = format_uint(p, r->tid.load(std::memory_order_relaxed), 1);
+    memcpy(p, " ====\n", 6);
+    p += 6;
+    write_all(fd, header, p - header);
+
+    size_t offset = start & r->mask;
+    size_t n = end - start;
+    size_t first = std::min(n, size - offset);
+    write_all(fd, &r->data[offset], first);
+    write_all(fd, &r->data[0], n - first);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+const int CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+const size_t NUM_CRASH_SIGNALS = sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]);
+
+/**
+ * @brief Crash handler state. Written only by Install_crash_handler() and
+ * Remove_crash_handler()
+ */
+std::atomic<so::Flight_recorder_state*> crash_state(nullptr);
+char crash_path[4096];
+struct sigaction old_actions[NUM_CRASH_SIGNALS];
+bool crash_handler_installed = false;
+
+void restore_handlers()
+{
+  for(size_t i = 0; i < NUM_CRASH_SIGNALS; i++)
+  {
+    sigaction(CRASH_SIGNALS[i], &old_actions[i], nullptr);
+  }
+}
+
+void crash_handler(int sig)
+{
+  so::Flight_recorder_state* state = crash_state.load();
+  if(state)
+  {
+    int fd = open(crash_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd >= 0)
+    {
+      dump_state(*state, fd);
+      close(fd);
+    }
+  }
+  restore_handlers();
+  raise(sig);
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Flight_recorder::Flight_recorder(const size_t bytes_per_thread)
+  :
+    m_state(std::make_shared<Flight_recorder_state>(bytes_per_thread))
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Flight_recorder::~Flight_recorder()
+{
+  if(crash_state.load() == m_state.get())
+  {
+    Remove_crash_handler();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Flight_recorder::Record(const char* text, const size_t len)
+{
+  Ring& r = thread_ring(m_state);
+
+  char stamp[Log_clock::MAX_TEXT];
+  size_t stamp_len = format_timestamp(stamp);
+  size_t n = std::min(len, r.mask - stamp_len);
+  uint64_t pos = r.pos.load(std::memory_order_relaxed);
+  put(r, pos, stamp, stamp_len);
+  put(r, pos, text, n);
+  put(r, pos, "\n", 1);
+  r.pos.store(pos, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Flight_recorder::Record(const wchar_t* text, const size_t len)
+{
+  Ring& r = thread_ring(m_state);
+
+  char stamp[Log_clock::MAX_TEXT];
+  size_t stamp_len = format_timestamp(stamp);
+  size_t room = r.mask - stamp_len;
+  uint64_t pos = r.pos.load(std::memory_order_relaxed);
+  put(r, pos, stamp, stamp_len);
+
+  // Encode into a small buffer on the stack and copy it to the ring as it
+  // fills, stopping before a character that would not fit whole
+  char chunk[256];
+  size_t used = 0;
+  for(size_t i = 0; i < len; i++)
+  {
+    if(used > sizeof(chunk) - 4)
+    {
+      put(r, pos, chunk, used);
+      used = 0;
+    }
+    size_t k = encode_utf8(static_cast<uint32_t>(text[i]), &chunk[used]);
+    if(k > room)
+    {
+      break;
+    }
+    room -= k;
+    used += k;
+  }
+  put(r, pos, chunk, used);
+  put(r, pos, "\n", 1);
+  r.pos.store(pos, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Flight_recorder::Dump(const int fd) const
+{
+  dump_state(*m_state, fd);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Flight_recorder::Dump(const std::string& filename) const
+{
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+  if(fd < 0)
+  {
+    throw so::Write_error("Could not open flight recorder dump '", filename,
+                          "': ", strerror(errno));
+  }
+  dump_state(*m_state, fd);
+  close(fd);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Flight_recorder::Install_crash_handler(const std::string& filename)
+{
+  // Stop the handler from using the path while it changes
+  crash_state.store(nullptr);
+  size_t n = std::min(filename.size(), sizeof(crash_path) - 1);
+  memcpy(crash_path, filename.data(), n);
+  crash_path[n] = '\0';
+  crash_state.store(m_state.get());
+
+  if(!crash_handler_installed)
+  {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = crash_handler;
+    sigemptyset(&sa.sa_mask);
+    for(size_t i = 0; i < NUM_CRASH_SIGNALS; i++)
+    {
+      sigaction(CRASH_SIGNALS[i], &sa, &old_actions[i]);
+    }
+    crash_handler_installed = true;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Flight_recorder::Remove_crash_handler()
+{
+  crash_state.store(nullptr);
+  if(crash_handler_installed)
+  {
+    restore_handlers();
+    crash_handler_installed = false;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,230 @@
+#include <cmath>
+#include <constants.h>
+#include <sno/geodetic.h>
+
+namespace
+{
+// Derived ellipsoid parameters
+const double E2 = so::Geodetic::WGS84_F * (2 - so::Geodetic::WGS84_F);
+const double B = so::Geodetic::WGS84_A * (1 - so::Geodetic::WGS84_F);
+const double EP2 = E2 / (1 - E2);
+
+typedef Eigen::Array<double, 1, Eigen::Dynamic> Row;
+
+/**
+ * @brief Element-wise atan2 of two rows
+ */
+Row atan2(const Row& y, const Row& x)
+{
+  return y.binaryExpr(x, [](double a, double b) {return std::atan2(a, b);});
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::lla_2_ecef(const Eigen::Vector3d& lla)
+{
+  double lat = lla(0) * DEG_TO_RAD;
+  double lon = lla(1) * DEG_TO_RAD;
+  double sin_lat = std::sin(lat);
+  double cos_lat = std::cos(lat);
+  double n = WGS84_A / std::sqrt(1 - E2 * sin_lat * sin_lat);
+  return Eigen::Vector3d((n + lla(2)) * cos_lat * std::cos(lon),
+                         (n + lla(2)) * cos_lat * std::sin(lon),
+                         (n * (1 - E2) + lla(2)) * sin_lat);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::lla_2_ecef(const Eigen::Matrix3Xd& lla)
+{
+  Row lat = lla.row(0).array() * DEG_TO_RAD;
+  Row lon = lla.row(1).array() * DEG_TO_RAD;
+  Row h = lla.row(2).array();
+  Row sin_lat = lat.sin();
+  Row cos_lat = lat.cos();
+  Row n = WGS84_A / (1 - E2 * sin_lat.square()).sqrt();
+
+  Eigen::Matrix3Xd ecef(3, lla.cols());
+  ecef.row(0) = (n + h) * cos_lat * lon.cos();
+  ecef.row(1) = (n + h) * cos_lat * lon.sin();
+  ecef.row(2) = (n * (1 - E2) + h) * sin_lat;
+  return ecef;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::ecef_2_lla(const Eigen::Vector3d& ecef)
+{
+  double p = std::hypot(ecef(0), ecef(1));
+  double theta = std::atan2(ecef(2) * WGS84_A, p * B);
+  double sin_theta = std::sin(theta);
+  double cos_theta = std::cos(theta);
+  double lat = std::atan2(ecef(2) + EP2 * B * sin_theta * sin_theta * sin_theta,
+                          p - E2 * WGS84_A * cos_theta * cos_theta * cos_theta);
+  double sin_lat = std::sin(lat);
+  double h = p * std::cos(lat) + ecef(2) * sin_lat
+      - WGS84_A * std::sqrt(1 - E2 * sin_lat * sin_lat);
+  return Eigen::Vector3d(lat * RAD_TO_DEG,
+                         std::atan2(ecef(1), ecef(0)) * RAD_TO_DEG,
+                         h);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::ecef_2_lla(const Eigen::Matrix3Xd& ecef)
+{
+  Row x = ecef.row(0).array();
+  Row y = ecef.row(1).array();
+  Row z = ecef.row(2).array();
+  Row p = (x.square() + y.square()).sqrt();
+  Row theta = atan2(z * WGS84_A, p * B);
+  Row sin_theta = theta.sin();
+  Row cos_theta = theta.cos();
+  Row lat = atan2(z + EP2 * B * sin_theta.cube(),
+                  p - E2 * WGS84_A * cos_theta.cube());
+  Row sin_lat = lat.sin();
+
+  Eigen::Matrix3Xd lla(3, ecef.cols());
+  lla.row(0) = lat * RAD_TO_DEG;
+  lla.row(1) = atan2(y, x) * RAD_TO_DEG;
+  lla.row(2) = p * lat.cos() + z * sin_lat
+      - WGS84_A * (1 - E2 * sin_lat.square()).sqrt();
+  return lla;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3d so::Geodetic::ecef_2_ned_matrix(double lat, double lon)
+{
+  double sin_lat = std::sin(lat * DEG_TO_RAD);
+  double cos_lat = std::cos(lat * DEG_TO_RAD);
+  double sin_lon = std::sin(lon * DEG_TO_RAD);
+  double cos_lon = std::cos(lon * DEG_TO_RAD);
+  Eigen::Matrix3d m;
+  m << -sin_lat * cos_lon, -sin_lat * sin_lon, cos_lat,
+       -sin_lon, cos_lon, 0,
+       -cos_lat * cos_lon, -cos_lat * sin_lon, -sin_lat;
+  return m;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Geodetic::Local_frame::Local_frame(const Eigen::Vector3d& origin_lla)
+  :
+    m_origin_lla(origin_lla),
+    m_origin_ecef(lla_2_ecef(origin_lla)),
+    m_ecef_2_ned(ecef_2_ned_matrix(origin_lla(0), origin_lla(1))),
+    m_ecef_2_enu()
+{
+  // ENU is NED with north and east swapped and down negated
+  m_ecef_2_enu.row(0) = m_ecef_2_ned.row(1);
+  m_ecef_2_enu.row(1) = m_ecef_2_ned.row(0);
+  m_ecef_2_enu.row(2) = -m_ecef_2_ned.row(2);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+const Eigen::Vector3d& so::Geodetic::Local_frame::Get_origin() const
+{
+  return m_origin_lla;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::Local_frame::Ecef_2_ned(
+    const Eigen::Vector3d& ecef) const
+{
+  return m_ecef_2_ned * (ecef - m_origin_ecef);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::Local_frame::Ecef_2_ned(
+    const Eigen::Matrix3Xd& ecef) const
+{
+  return m_ecef_2_ned * (ecef.colwise() - m_origin_ecef);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::Local_frame::Ned_2_ecef(
+    const Eigen::Vector3d& ned) const
+{
+  return m_ecef_2_ned.transpose() * ned + m_origin_ecef;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::Local_frame::Ned_2_ecef(
+    const Eigen::Matrix3Xd& ned) const
+{
+  return (m_ecef_2_ned.transpose() * ned).colwise() + m_origin_ecef;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::Local_frame::Ecef_2_enu(
+    const Eigen::Vector3d& ecef) const
+{
+  return m_ecef_2_enu * (ecef - m_origin_ecef);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::Local_frame::Ecef_2_enu(
+    const Eigen::Matrix3Xd& ecef) const
+{
+  return m_ecef_2_enu * (ecef.colwise() - m_origin_ecef);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::Local_frame::Enu_2_ecef(
+    const Eigen::Vector3d& enu) const
+{
+  return m_ecef_2_enu.transpose() * enu + m_origin_ecef;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::Local_frame::Enu_2_ecef(
+    const Eigen::Matrix3Xd& enu) const
+{
+  return (m_ecef_2_enu.transpose() * enu).colwise() + m_origin_ecef;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::Local_frame::Lla_2_ned(
+    const Eigen::Vector3d& lla) const
+{
+  return Ecef_2_ned(lla_2_ecef(lla));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::Local_frame::Lla_2_ned(
+    const Eigen::Matrix3Xd& lla) const
+{
+  return Ecef_2_ned(lla_2_ecef(lla));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Geodetic::Local_frame::Ned_2_lla(
+    const Eigen::Vector3d& ned) const
+{
+  return ecef_2_lla(Ned_2_ecef(ned));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Geodetic::Local_frame::Ned_2_lla(
+    const Eigen::Matrix3Xd& ned) const
+{
+  return ecef_2_lla(Ned_2_ecef(ned));
+}
+
+//////////////////////////////////////////////////////////////////////////////
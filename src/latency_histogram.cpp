@@ -0,0 +1,209 @@
+#include <math.h>
+#include <algorithm>
+#include <sno/latency_histogram.h>
+#include <sno/so_exception.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Latency_histogram::Latency_histogram(const int64_t max_ns,
+                                         const int significant_digits)
+  :
+    m_max_trackable(max_ns),
+    m_significant_digits(significant_digits),
+    m_sub_bucket_half_count_magnitude(0),
+    m_sub_bucket_mask(0),
+    m_counts_size(0),
+    m_counts(),
+    m_min(INT64_MAX),
+    m_max(-1)
+{
+  if(max_ns < 2)
+  {
+    throw so::Invalid_argument("Latency histogram range must be at least 2 ns,"
+                               " got ", max_ns);
+  }
+  if(significant_digits < 1 || significant_digits > 5)
+  {
+    throw so::Invalid_argument("Latency histogram precision must be 1 to 5"
+                               " significant digits, got ", significant_digits);
+  }
+
+  // Enough sub-buckets that two adjacent values in the top half of a bucket
+  // differ by less than one unit of the last significant digit
+  int64_t largest_single_unit = 2;
+  for(int i = 0; i < significant_digits; i++)
+  {
+    largest_single_unit *= 10;
+  }
+  int sub_bucket_count_magnitude = 0;
+  while((INT64_C(1) << sub_bucket_count_magnitude) < largest_single_unit)
+  {
+    sub_bucket_count_magnitude++;
+  }
+  m_sub_bucket_half_count_magnitude = sub_bucket_count_magnitude - 1;
+  int64_t sub_bucket_count = INT64_C(1) << sub_bucket_count_magnitude;
+  m_sub_bucket_mask = static_cast<uint64_t>(sub_bucket_count - 1);
+
+  // Each bucket covers twice the range of the one before
+  size_t bucket_count = 1;
+  int64_t smallest_untrackable = sub_bucket_count;
+  while(smallest_untrackable <= max_ns)
+  {
+    bucket_count++;
+    if(smallest_untrackable > INT64_MAX / 2)
+    {
+      break;
+    }
+    smallest_untrackable <<= 1;
+  }
+  m_counts_size = (bucket_count + 1) << m_sub_bucket_half_count_magnitude;
+  m_counts.reset(new boost::atomic<uint64_t>[m_counts_size]);
+  for(size_t i = 0; i < m_counts_size; i++)
+  {
+    m_counts[i].store(0, boost::memory_order_relaxed);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Latency_histogram::Merge(const Latency_histogram& other)
+{
+  if(other.m_max_trackable != m_max_trackable ||
+     other.m_significant_digits != m_significant_digits)
+  {
+    throw so::Invalid_argument("Cannot merge latency histograms with different"
+                               " layouts");
+  }
+  for(size_t i = 0; i < m_counts_size; i++)
+  {
+    uint64_t count = other.m_counts[i].load(boost::memory_order_relaxed);
+    if(count)
+    {
+      m_counts[i].fetch_add(count, boost::memory_order_relaxed);
+    }
+  }
+
+  int64_t other_min = other.m_min.load(boost::memory_order_relaxed);
+  int64_t min = m_min.load(boost::memory_order_relaxed);
+  while(other_min < min &&
+        !m_min.compare_exchange_weak(min, other_min,
+                                     boost::memory_order_relaxed))
+  {
+  }
+  int64_t other_max = other.m_max.load(boost::memory_order_relaxed);
+  int64_t max = m_max.load(boost::memory_order_relaxed);
+  while(other_max > max &&
+        !m_max.compare_exchange_weak(max, other_max,
+                                     boost::memory_order_relaxed))
+  {
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Latency_histogram::Get_percentile(const double percentile) const
+{
+  uint64_t total = Get_count();
+  if(total == 0)
+  {
+    return 0;
+  }
+  double share = std::min(std::max(percentile, 0.0), 100.0) / 100.0;
+  uint64_t target = static_cast<uint64_t>(ceil(share * total));
+  target = std::max<uint64_t>(target, 1);
+
+  uint64_t seen = 0;
+  for(size_t i = 0; i < m_counts_size; i++)
+  {
+    seen += m_counts[i].load(boost::memory_order_relaxed);
+    if(seen >= target)
+    {
+      int64_t lowest;
+      int64_t size = range_of(i, lowest);
+      int64_t highest = lowest + size - 1;
+      return std::max(std::min(highest, Get_max()), Get_min());
+    }
+  }
+  return Get_max();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t so::Latency_histogram::Get_count() const
+{
+  uint64_t total = 0;
+  for(size_t i = 0; i < m_counts_size; i++)
+  {
+    total += m_counts[i].load(boost::memory_order_relaxed);
+  }
+  return total;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Latency_histogram::Get_min() const
+{
+  int64_t min = m_min.load(boost::memory_order_relaxed);
+  return min == INT64_MAX ? 0 : min;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Latency_histogram::Get_max() const
+{
+  return std::max<int64_t>(m_max.load(boost::memory_order_relaxed), 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+double so::Latency_histogram::Get_mean() const
+{
+  uint64_t total = 0;
+  double sum = 0.0;
+  for(size_t i = 0; i < m_counts_size; i++)
+  {
+    uint64_t count = m_counts[i].load(boost::memory_order_relaxed);
+    if(count)
+    {
+      int64_t lowest;
+      int64_t size = range_of(i, lowest);
+      total += count;
+      sum += count * (lowest + (size - 1) / 2.0);
+    }
+  }
+  return total ? sum / total : 0.0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Latency_histogram::Reset()
+{
+  for(size_t i = 0; i < m_counts_size; i++)
+  {
+    m_counts[i].store(0, boost::memory_order_relaxed);
+  }
+  m_min.store(INT64_MAX, boost::memory_order_relaxed);
+  m_max.store(-1, boost::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Latency_histogram::range_of(const size_t index,
+                                        int64_t& lowest) const
+{
+  size_t half_count = static_cast<size_t>(1) <<
+                      m_sub_bucket_half_count_magnitude;
+  int bucket = static_cast<int>(index >> m_sub_bucket_half_count_magnitude) - 1;
+  int64_t sub_bucket = static_cast<int64_t>((index & (half_count - 1)) +
+                                            half_count);
+  if(bucket < 0)
+  {
+    // The first bucket also holds the values below half its sub-buckets
+    sub_bucket -= half_count;
+    bucket = 0;
+  }
+  lowest = sub_bucket << bucket;
+  return INT64_C(1) << bucket;
+}
+
+//////////////////////////////////////////////////////////////////////////////
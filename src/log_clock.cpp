@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <string.h>
+#include <sno/log_clock.h>
+
+namespace
+{
+
+/**
+ * @brief Text for the second a thread last formatted
+ */
+struct Second_cache
+{
+  int64_t second;
+  bool wall;
+  size_t len;
+  char text[so::Log_clock::MAX_TEXT];
+};
+
+/**
+ * @brief Write 'YYYY-MM-DD HH:MM:SS.' or 'seconds.' for a whole second
+ * @return Number of characters written
+ */
+size_t format_second(const int64_t second, const bool wall, char* out)
+{
+  int n;
+  if(wall)
+  {
+    time_t t = static_cast<time_t>(second);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    n = snprintf(out, so::Log_clock::MAX_TEXT - 10,
+                 "%04d-%02d-%02d %02d:%02d:%02d.",
+                 tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                 tm.tm_hour, tm.tm_min, tm.tm_sec);
+  }
+  else
+  {
+    n = snprintf(out, so::Log_clock::MAX_TEXT - 10, "%lld.",
+                 static_cast<long long>(second));
+  }
+  return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Log_clock::Format(const Source source, const int64_t ns, char* out)
+{
+  static const char DIGIT_PAIRS[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+  thread_local Second_cache cache = {-1, false, 0, {}};
+
+  int64_t second = ns / 1000000000;
+  int64_t frac = ns % 1000000000;
+  if(frac < 0)
+  {
+    second--;
+    frac += 1000000000;
+  }
+  bool wall = Is_wall(source);
+  if(second != cache.second || wall != cache.wall)
+  {
+    cache.second = second;
+    cache.wall = wall;
+    cache.len = format_second(second, wall, cache.text);
+  }
+  memcpy(out, cache.text, cache.len);
+  char* p = out + cache.len;
+
+  // Nanoseconds, nine digits, two at a time from the right
+  uint32_t n = static_cast<uint32_t>(frac);
+  for(int i = 7; i >= 1; i -= 2)
+  {
+    memcpy(p + i, &DIGIT_PAIRS[2 * (n % 100)], 2);
+    n /= 100;
+  }
+  p[0] = static_cast<char>('0' + n);
+  p[9] = ' ';
+  return cache.len + 10;
+}
+
+//////////////////////////////////////////////////////////////////////////////
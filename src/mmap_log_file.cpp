@@ -0,0 +1,54 @@
+#include <mmap_log_file_impl.h>
+#include <sno/mmap_log_file.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Mmap_log_file::Mmap_log_file(const std::string& path,
+                                 const size_t segment_size,
+                                 const size_t max_old_segments)
+  :
+    m_pimpl(new Mmap_log_file_impl(path, segment_size, max_old_segments))
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Mmap_log_file::~Mmap_log_file() = default;
+
+//////////////////////////////////////////////////////////////////////////////
+
+char* so::Mmap_log_file::Get_data() const
+{
+  return m_pimpl->Get_data();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Mmap_log_file::Get_size() const
+{
+  return m_pimpl->Get_size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::string so::Mmap_log_file::Get_current_path() const
+{
+  return m_pimpl->Get_current_path();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool so::Mmap_log_file::Rotate(const size_t used)
+{
+  return m_pimpl->Rotate(used);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Mmap_log_file::Close(const size_t used)
+{
+  m_pimpl->Close(used);
+}
+
+//////////////////////////////////////////////////////////////////////////////
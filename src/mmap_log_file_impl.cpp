@@ -0,0 +1,283 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sno/so_exception.h>
+#include <mmap_log_file_impl.h>
+
+namespace
+{
+
+/**
+ * @brief Round up to a whole number of pages
+ */
+size_t round_to_pages(const size_t n)
+{
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return std::max<size_t>((n + page - 1) / page, 1) * page;
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Mmap_log_file_impl::Mmap_log_file_impl(const std::string& path,
+                                           const size_t segment_size,
+                                           const size_t max_old_segments)
+  :
+    m_path(path),
+    m_segment_size(round_to_pages(segment_size)),
+    m_max_old_segments(max_old_segments),
+    m_current(),
+    m_closed(false),
+    m_old(),
+    m_mutex(),
+    m_cv(),
+    m_next(),
+    m_next_ready(false),
+    m_failed(false),
+    m_next_index(0),
+    m_retired(),
+    m_running(true),
+    m_thread()
+{
+  std::vector<uint64_t> existing = find_segments();
+  m_old.assign(existing.begin(), existing.end());
+  uint64_t first = existing.empty() ? 0 : existing.back() + 1;
+  if(!create_segment(first, m_current))
+  {
+    throw so::Write_error("Could not create log segment '",
+                          segment_path(first), "': ", strerror(errno));
+  }
+  m_next_index = first + 1;
+  m_thread = std::thread(&Mmap_log_file_impl::run, this);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Mmap_log_file_impl::~Mmap_log_file_impl()
+{
+  Close(m_segment_size);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+char* so::Mmap_log_file_impl::Get_data() const
+{
+  return m_current.data;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Mmap_log_file_impl::Get_size() const
+{
+  return m_segment_size;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::string so::Mmap_log_file_impl::Get_current_path() const
+{
+  return segment_path(m_current.index);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool so::Mmap_log_file_impl::Rotate(const size_t used)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock, [this]() { return m_next_ready || m_failed; });
+  if(!m_next_ready)
+  {
+    // Try again at the next rotation
+    m_failed = false;
+    m_cv.notify_all();
+    return false;
+  }
+  m_retired.push_back(Retired{m_current, used});
+  m_current = m_next;
+  m_next_ready = false;
+  m_cv.notify_all();
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Mmap_log_file_impl::Close(const size_t used)
+{
+  if(m_closed)
+  {
+    return;
+  }
+  m_closed = true;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    m_cv.notify_all();
+  }
+  m_thread.join();
+
+  // The background thread has finished every retired segment
+  if(m_next_ready)
+  {
+    finish_segment(m_next, 0);
+    unlink(segment_path(m_next.index).c_str());
+    m_next_ready = false;
+  }
+  finish_segment(m_current, std::min(used, m_segment_size));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::string so::Mmap_log_file_impl::segment_path(const uint64_t index) const
+{
+  return m_path + "." + std::to_string(index);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint64_t> so::Mmap_log_file_impl::find_segments() const
+{
+  size_t slash = m_path.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "." : m_path.substr(0, slash + 1);
+  std::string prefix = (slash == std::string::npos ? m_path
+                                                   : m_path.substr(slash + 1))
+      + ".";
+
+  std::vector<uint64_t> indices;
+  DIR* d = opendir(dir.c_str());
+  if(!d)
+  {
+    return indices;
+  }
+  while(struct dirent* entry = readdir(d))
+  {
+    std::string name(entry->d_name);
+    if(name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix))
+    {
+      continue;
+    }
+    std::string suffix = name.substr(prefix.size());
+    if(suffix.find_first_not_of("0123456789") != std::string::npos)
+    {
+      continue;
+    }
+    indices.push_back(strtoull(suffix.c_str(), nullptr, 10));
+  }
+  closedir(d);
+  std::sort(indices.begin(), indices.end());
+  return indices;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool so::Mmap_log_file_impl::create_segment(const uint64_t index,
+                                            Segment& segment) const
+{
+  std::string path = segment_path(index);
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(fd < 0)
+  {
+    return false;
+  }
+  // Allocate the blocks now so the writer never waits on the file system.
+  // Some file systems cannot, in which case the file is sparse
+  if(ftruncate(fd, m_segment_size) != 0)
+  {
+    close(fd);
+    unlink(path.c_str());
+    return false;
+  }
+  posix_fallocate(fd, 0, m_segment_size);
+
+  void* data = mmap(nullptr, m_segment_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, 0);
+  if(data == MAP_FAILED)
+  {
+    close(fd);
+    unlink(path.c_str());
+    return false;
+  }
+  segment.index = index;
+  segment.fd = fd;
+  segment.data = static_cast<char*>(data);
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Mmap_log_file_impl::finish_segment(const Segment& segment,
+                                            const size_t used) const
+{
+  munmap(segment.data, m_segment_size);
+  if(ftruncate(segment.fd, used) != 0)
+  {
+    // Leaves zero bytes at the end of the file, which readers skip
+  }
+  close(segment.fd);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Mmap_log_file_impl::retire_segment(const Retired& retired)
+{
+  finish_segment(retired.segment, retired.used);
+  m_old.push_back(retired.segment.index);
+  while(m_old.size() > m_max_old_segments)
+  {
+    unlink(segment_path(m_old.front()).c_str());
+    m_old.pop_front();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Mmap_log_file_impl::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(true)
+  {
+    if(!m_retired.empty())
+    {
+      std::vector<Retired> retired;
+      retired.swap(m_retired);
+      lock.unlock();
+      for(const Retired& r : retired)
+      {
+        retire_segment(r);
+      }
+      lock.lock();
+      continue;
+    }
+    if(!m_running)
+    {
+      break;
+    }
+    if(!m_next_ready && !m_failed)
+    {
+      uint64_t index = m_next_index++;
+      Segment segment;
+      lock.unlock();
+      bool ok = create_segment(index, segment);
+      lock.lock();
+      if(ok)
+      {
+        m_next = segment;
+        m_next_ready = true;
+      }
+      else
+      {
+        m_failed = true;
+      }
+      m_cv.notify_all();
+      continue;
+    }
+    m_cv.wait(lock);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
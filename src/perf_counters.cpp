@@ -0,0 +1,408 @@
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <sno/clock.h>
+#include <sno/perf_counters.h>
+
+namespace
+{
+
+/**
+ * @brief perf_event_open() type and config of each event. Hardware events
+ * come first so that one of them leads the group when available
+ */
+const struct
+{
+  uint32_t type;
+  uint64_t config;
+  const char* name;
+} EVENTS[so::Perf_values::NUM_EVENTS] =
+{
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses"},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches"},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page-faults"},
+};
+
+/**
+ * @brief Open a counter for the calling thread. Kernel-side counting is
+ * tried for software events, then user space only if that is not allowed
+ * @param event Index into EVENTS
+ * @param group_fd Group leader, -1 to start a group
+ * @return File descriptor, or -1 if the event is unavailable
+ */
+int open_event(const size_t event, const int group_fd)
+{
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = EVENTS[event].type;
+  attr.config = EVENTS[event].config;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_hv = 1;
+  attr.exclude_kernel = EVENTS[event].type == PERF_TYPE_HARDWARE;
+  int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                    group_fd, PERF_FLAG_FD_CLOEXEC));
+  if(fd < 0 && !attr.exclude_kernel && (errno == EACCES || errno == EPERM))
+  {
+    attr.exclude_kernel = 1;
+    fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                  group_fd, PERF_FLAG_FD_CLOEXEC));
+  }
+  return fd;
+}
+
+/**
+ * @brief Scope totals by name
+ */
+typedef std::map<std::string, so::Perf_scope_stats> Stats_map;
+
+struct Thread_counters;
+
+/**
+ * @brief The counters of running threads, and the scope totals of threads
+ * that have exited
+ */
+struct State
+{
+  std::mutex mutex;
+  std::vector<Thread_counters*> threads;
+  Stats_map finished;
+};
+
+State& state()
+{
+  static State s;
+  return s;
+}
+
+/**
+ * @brief Add differences to scope totals. A count unavailable in either
+ * stays unavailable
+ */
+void add(so::Perf_scope_stats& total, const uint64_t count,
+         const so::Perf_values& values)
+{
+  if(total.count == 0)
+  {
+    total.totals = values;
+  }
+  else
+  {
+    total.totals.elapsed_ns += values.elapsed_ns;
+    for(size_t i = 0; i < so::Perf_values::NUM_EVENTS; i++)
+    {
+      int64_t& sum = total.totals.counts[i];
+      sum = sum < 0 || values.counts[i] < 0 ? -1 : sum + values.counts[i];
+    }
+  }
+  total.count += count;
+}
+
+/**
+ * @brief Add every scope of one set of totals to another
+ */
+void add_all(Stats_map& totals, const Stats_map& stats)
+{
+  for(const auto& entry : stats)
+  {
+    auto it = totals.find(entry.first);
+    if(it == totals.end())
+    {
+      it = totals.emplace(entry.first,
+                          so::Perf_scope_stats{entry.first, 0,
+                                               so::Perf_values()}).first;
+    }
+    add(it->second, entry.second.count, entry.second.totals);
+  }
+}
+
+/**
+ * @brief Counter group and scope totals of one thread. Registered with the
+ * state while the thread runs; when it exits the counters are closed and
+ * only its totals are kept
+ */
+struct Thread_counters
+{
+  Thread_counters()
+    :
+      leader(-1),
+      fds(),
+      positions(),
+      members(0),
+      mutex(),
+      stats()
+  {
+    for(size_t i = 0; i < so::Perf_values::NUM_EVENTS; i++)
+    {
+      fds[i] = open_event(i, leader);
+      positions[i] = fds[i] < 0 ? -1 : static_cast<int>(members++);
+      if(leader < 0)
+      {
+        leader = fds[i];
+      }
+    }
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.threads.push_back(this);
+  }
+
+  ~Thread_counters()
+  {
+    for(int fd : fds)
+    {
+      if(fd >= 0)
+      {
+        close(fd);
+      }
+    }
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.threads.erase(std::find(s.threads.begin(), s.threads.end(), this));
+    std::lock_guard<std::mutex> thread_lock(mutex);
+    add_all(s.finished, stats);
+  }
+
+  Thread_counters(const Thread_counters& other) = delete;
+  Thread_counters& operator=(const Thread_counters& other) = delete;
+
+  int leader;
+  int fds[so::Perf_values::NUM_EVENTS];
+  int positions[so::Perf_values::NUM_EVENTS]; ///< Index in a group read
+  size_t members;
+  std::mutex mutex;
+  Stats_map stats;
+};
+
+/**
+ * @brief Get the calling thread's counters, opening them on first use
+ */
+Thread_counters& thread_counters()
+{
+  thread_local Thread_counters counters;
+  return counters;
+}
+
+/**
+ * @brief Write a count, or n/a if it is unavailable
+ */
+void write_count(std::ostream& out, const int width, const int64_t count)
+{
+  out << std::setw(width);
+  if(count < 0)
+  {
+    out << "n/a";
+  }
+  else
+  {
+    out << count;
+  }
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+const char* so::Perf_counters::Get_event_name(const Perf_values::Event event)
+{
+  return EVENTS[event].name;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool so::Perf_counters::Is_available(const Perf_values::Event event)
+{
+  return thread_counters().positions[event] >= 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Perf_values so::Perf_counters::Read()
+{
+  Thread_counters& t = thread_counters();
+  Perf_values values;
+  for(int64_t& count : values.counts)
+  {
+    count = -1;
+  }
+
+  // nr, time enabled, time running, then one value per member
+  uint64_t buffer[3 + Perf_values::NUM_EVENTS];
+  ssize_t n = t.leader < 0 ? -1 : read(t.leader, buffer, sizeof(buffer));
+  values.elapsed_ns = Clock::Real_monotonic_ns();
+  if(n < static_cast<ssize_t>((3 + t.members) * sizeof(uint64_t)) ||
+     buffer[2] == 0)
+  {
+    return values;
+  }
+
+  // Counters that were multiplexed only ran for part of the time
+  double scale = buffer[2] < buffer[1] ? static_cast<double>(buffer[1]) /
+                                         buffer[2] : 1.0;
+  for(size_t i = 0; i < Perf_values::NUM_EVENTS; i++)
+  {
+    if(t.positions[i] >= 0)
+    {
+      uint64_t count = buffer[3 + t.positions[i]];
+      values.counts[i] = scale == 1.0 ? static_cast<int64_t>(count)
+                                      : static_cast<int64_t>(count * scale);
+    }
+  }
+  return values;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Perf_values so::Perf_counters::Difference(const Perf_values& start,
+                                              const Perf_values& end)
+{
+  Perf_values difference;
+  difference.elapsed_ns = end.elapsed_ns - start.elapsed_ns;
+  for(size_t i = 0; i < Perf_values::NUM_EVENTS; i++)
+  {
+    difference.counts[i] = start.counts[i] < 0 || end.counts[i] < 0
+                           ? -1 : end.counts[i] - start.counts[i];
+  }
+  return difference;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Perf_counters::Record(const std::string& name,
+                               const Perf_values& start,
+                               const Perf_values& end)
+{
+  Thread_counters& t = thread_counters();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  auto it = t.stats.find(name);
+  if(it == t.stats.end())
+  {
+    it = t.stats.emplace(name, Perf_scope_stats{name, 0, Perf_values()}).first;
+  }
+  add(it->second, 1, Difference(start, end));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<so::Perf_scope_stats> so::Perf_counters::Get_stats()
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  Stats_map by_name = s.finished;
+  for(Thread_counters* t : s.threads)
+  {
+    std::lock_guard<std::mutex> thread_lock(t->mutex);
+    add_all(by_name, t->stats);
+  }
+
+  std::vector<Perf_scope_stats> result;
+  for(const auto& entry : by_name)
+  {
+    result.push_back(entry.second);
+  }
+  std::sort(result.begin(), result.end(),
+            [](const Perf_scope_stats& a, const Perf_scope_stats& b)
+            {
+              return a.totals.elapsed_ns > b.totals.elapsed_ns;
+            });
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Perf_counters::Write_report(std::ostream& out)
+{
+  std::vector<Perf_scope_stats> stats = Get_stats();
+  size_t name_width = 5;
+  for(const Perf_scope_stats& s : stats)
+  {
+    name_width = std::max(name_width, s.name.size());
+  }
+
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::left << std::setw(static_cast<int>(name_width)) << "scope"
+      << std::right << std::setw(10) << "runs" << std::setw(14)
+      << "elapsed_ms";
+  for(size_t i = 0; i < Perf_values::NUM_EVENTS; i++)
+  {
+    out << std::setw(18) << EVENTS[i].name;
+  }
+  out << std::setw(8) << "IPC" << '\n';
+
+  for(const Perf_scope_stats& s : stats)
+  {
+    const int64_t* counts = s.totals.counts;
+    out << std::left << std::setw(static_cast<int>(name_width)) << s.name
+        << std::right << std::setw(10) << s.count << std::setw(14)
+        << std::fixed << std::setprecision(3) << s.totals.elapsed_ns * 1e-6;
+    for(size_t i = 0; i < Perf_values::NUM_EVENTS; i++)
+    {
+      write_count(out, 18, counts[i]);
+    }
+    out << std::setw(8);
+    if(counts[Perf_values::Cycles] > 0 && counts[Perf_values::Instructions] >= 0)
+    {
+      out << std::setprecision(2) << static_cast<double>(
+               counts[Perf_values::Instructions]) / counts[Perf_values::Cycles];
+    }
+    else
+    {
+      out << "n/a";
+    }
+    out << '\n';
+  }
+  out.flags(flags);
+  out.precision(precision);
+  out.flush();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Perf_counters::Clear()
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.finished.clear();
+  for(Thread_counters* t : s.threads)
+  {
+    std::lock_guard<std::mutex> thread_lock(t->mutex);
+    t->stats.clear();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Perf_scope::Perf_scope(const std::string& name)
+  :
+    m_name(name),
+    m_start(Perf_counters::Read())
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Perf_scope::~Perf_scope()
+{
+  Perf_counters::Record(m_name, m_start, Perf_counters::Read());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Perf_values so::Perf_scope::Get_values() const
+{
+  return Perf_counters::Difference(m_start, Perf_counters::Read());
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,443 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <sno/profiler.h>
+#include <sno/so_exception.h>
+
+namespace
+{
+
+/**
+ * @brief Registered sites and thread buffers. Buffers are kept until exit so
+ * that the zones of finished threads can still be exported; new threads take
+ * over the buffers of finished ones
+ */
+struct State
+{
+  State()
+    :
+      mutex(),
+      sites(),
+      buffers(),
+      buffer_size(1 << 16)
+  {
+  }
+
+  std::mutex mutex;
+  std::vector<const char*> sites;
+  std::vector<std::unique_ptr<so::Profile_thread_buffer> > buffers;
+  size_t buffer_size;
+};
+
+State& state()
+{
+  static State s;
+  return s;
+}
+
+/**
+ * @brief Releases the calling thread's buffer when the thread exits
+ */
+struct Buffer_release
+{
+  Buffer_release()
+    :
+      buffer(nullptr)
+  {
+  }
+
+  ~Buffer_release()
+  {
+    if(buffer)
+    {
+      buffer->Release();
+    }
+  }
+
+  so::Profile_thread_buffer* buffer;
+};
+
+/**
+ * @brief Write a string as a JSON string literal
+ */
+void write_json_string(std::ostream& out, const char* s)
+{
+  out << '"';
+  for(; *s; s++)
+  {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if(c == '"' || c == '\\')
+    {
+      out << '\\' << *s;
+    }
+    else if(c < 0x20)
+    {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec << std::setfill(' ');
+    }
+    else
+    {
+      out << *s;
+    }
+  }
+  out << '"';
+}
+
+/**
+ * @brief Write a time in microseconds with nanosecond digits
+ */
+void write_us(std::ostream& out, const int64_t ns)
+{
+  out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000
+      << std::setfill(' ');
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Profile_thread_buffer::Profile_thread_buffer(const size_t capacity,
+                                                 const int64_t tid)
+  :
+    m_capacity(capacity),
+    m_events(new Profile_event[capacity]),
+    m_count(0),
+    m_dropped(0),
+    m_depth(0),
+    m_in_use(true),
+    m_owners(1, Owner{0, tid}),
+    m_stats()
+{
+  for(boost::atomic<Stats*>& chunk : m_stats)
+  {
+    chunk.store(nullptr, boost::memory_order_relaxed);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Profile_thread_buffer::~Profile_thread_buffer()
+{
+  for(boost::atomic<Stats*>& chunk : m_stats)
+  {
+    delete[] chunk.load();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+const so::Profile_thread_buffer::Stats*
+so::Profile_thread_buffer::Get_stats(const uint32_t site) const
+{
+  if(site / STATS_CHUNK >= MAX_STATS_CHUNKS)
+  {
+    return nullptr;
+  }
+  const Stats* chunk =
+      m_stats[site / STATS_CHUNK].load(boost::memory_order_acquire);
+  if(!chunk)
+  {
+    return nullptr;
+  }
+  const Stats& s = chunk[site % STATS_CHUNK];
+  return s.count.load(boost::memory_order_acquire) ? &s : nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool so::Profile_thread_buffer::Claim(const int64_t tid)
+{
+  bool expected = false;
+  if(!m_in_use.compare_exchange_strong(expected, true,
+                                       boost::memory_order_acquire))
+  {
+    return false;
+  }
+  m_depth = 0;
+  size_t first = m_count.load(boost::memory_order_relaxed);
+  if(m_owners.back().first_event == first)
+  {
+    // The last owner recorded nothing more, so it needs no entry
+    m_owners.back().tid = tid;
+  }
+  else
+  {
+    m_owners.push_back(Owner{first, tid});
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Profile_thread_buffer::Clear()
+{
+  m_owners.erase(m_owners.begin(), m_owners.end() - 1);
+  m_owners.back().first_event = 0;
+  m_count.store(0, boost::memory_order_relaxed);
+  m_dropped.store(0, boost::memory_order_relaxed);
+  for(boost::atomic<Stats*>& chunk : m_stats)
+  {
+    Stats* stats = chunk.load(boost::memory_order_relaxed);
+    for(size_t i = 0; stats && i < STATS_CHUNK; i++)
+    {
+      stats[i].count.store(0, boost::memory_order_relaxed);
+      stats[i].total.store(0, boost::memory_order_relaxed);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Profile_thread_buffer::Stats*
+so::Profile_thread_buffer::add_chunk(const size_t index)
+{
+  if(index >= MAX_STATS_CHUNKS)
+  {
+    return nullptr;
+  }
+  Stats* chunk = new Stats[STATS_CHUNK];
+  for(size_t i = 0; i < STATS_CHUNK; i++)
+  {
+    chunk[i].count.store(0, boost::memory_order_relaxed);
+    chunk[i].total.store(0, boost::memory_order_relaxed);
+    chunk[i].min.store(0, boost::memory_order_relaxed);
+    chunk[i].max.store(0, boost::memory_order_relaxed);
+  }
+  m_stats[index].store(chunk, boost::memory_order_release);
+  return chunk;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Profile_site::Profile_site(const char* name)
+  :
+    m_id(Profiler::register_site(name))
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Profile_zone::Profile_zone(const char* name)
+  :
+    m_buffer(Profiler::Get_thread_buffer()),
+    m_site([name]()
+           {
+             thread_local std::unordered_map<const char*, uint32_t> sites;
+             auto it = sites.find(name);
+             if(it == sites.end())
+             {
+               it = sites.emplace(name, Profile_site(name).Get_id()).first;
+             }
+             return it->second;
+           }()),
+    m_depth(m_buffer.Enter()),
+    m_begin(Tsc_clock::Now())
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Profiler::Set_buffer_size(const size_t events)
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.buffer_size = std::max<size_t>(events, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<so::Profile_stats> so::Profiler::Get_stats()
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+
+  // Several sites may share a name
+  std::map<std::string, Profile_stats> by_name;
+  std::map<std::string, int64_t> total_ticks;
+  for(uint32_t site = 0; site < s.sites.size(); site++)
+  {
+    for(const std::unique_ptr<Profile_thread_buffer>& buffer : s.buffers)
+    {
+      const Profile_thread_buffer::Stats* stats = buffer->Get_stats(site);
+      if(!stats)
+      {
+        continue;
+      }
+      uint64_t count = stats->count.load(boost::memory_order_acquire);
+      int64_t min = stats->min.load(boost::memory_order_relaxed);
+      int64_t max = stats->max.load(boost::memory_order_relaxed);
+      auto it = by_name.find(s.sites[site]);
+      if(it == by_name.end())
+      {
+        it = by_name.emplace(s.sites[site],
+                             Profile_stats{s.sites[site], 0, 0, min, max}).first;
+      }
+      Profile_stats& total = it->second;
+      total.count += count;
+      total_ticks[total.name] += stats->total.load(boost::memory_order_relaxed);
+      total.min_ns = std::min(total.min_ns, min);
+      total.max_ns = std::max(total.max_ns, max);
+    }
+  }
+
+  std::vector<Profile_stats> result;
+  for(auto& entry : by_name)
+  {
+    Profile_stats stats = entry.second;
+    stats.total_ns = Tsc_clock::To_ns(total_ticks[entry.first]);
+    stats.min_ns = Tsc_clock::To_ns(stats.min_ns);
+    stats.max_ns = Tsc_clock::To_ns(stats.max_ns);
+    result.push_back(stats);
+  }
+  std::sort(result.begin(), result.end(),
+            [](const Profile_stats& a, const Profile_stats& b)
+            {
+              return a.total_ns > b.total_ns;
+            });
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t so::Profiler::Get_dropped()
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  uint64_t dropped = 0;
+  for(const std::unique_ptr<Profile_thread_buffer>& buffer : s.buffers)
+  {
+    dropped += buffer->Get_dropped();
+  }
+  return dropped;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Profiler::Write_chrome_trace(std::ostream& out)
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+
+  // Times are written relative to the earliest zone
+  int64_t epoch = INT64_MAX;
+  for(const std::unique_ptr<Profile_thread_buffer>& buffer : s.buffers)
+  {
+    size_t count;
+    const Profile_event* events = buffer->Get_events(count);
+    for(size_t i = 0; i < count; i++)
+    {
+      epoch = std::min(epoch, events[i].begin);
+    }
+  }
+
+  int pid = static_cast<int>(getpid());
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for(const std::unique_ptr<Profile_thread_buffer>& buffer : s.buffers)
+  {
+    size_t count;
+    const Profile_event* events = buffer->Get_events(count);
+    const std::vector<Profile_thread_buffer::Owner>& owners =
+        buffer->Get_owners();
+    for(size_t o = 0; o < owners.size(); o++)
+    {
+      // Each thread that owned the buffer wrote the events up to the next
+      size_t end = o + 1 < owners.size() ? owners[o + 1].first_event : count;
+      if(owners[o].first_event >= end)
+      {
+        continue;
+      }
+      int64_t tid = owners[o].tid;
+      out << (first ? "\n" : ",\n")
+          << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+          << ",\"tid\":" << tid
+          << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+      first = false;
+      for(size_t i = owners[o].first_event; i < end; i++)
+      {
+        const Profile_event& e = events[i];
+        out << ",\n{\"name\":";
+        write_json_string(out, s.sites[e.site]);
+        out << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+            << ",\"ts\":";
+        write_us(out, Tsc_clock::To_ns(e.begin - epoch));
+        out << ",\"dur\":";
+        write_us(out, Tsc_clock::To_ns(e.end - e.begin));
+        out << ",\"args\":{\"depth\":" << e.depth << "}}";
+      }
+    }
+  }
+  out << "\n]}\n";
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Profiler::Write_chrome_trace(const std::string& filename)
+{
+  std::ofstream out(filename);
+  if(!out)
+  {
+    throw so::Write_error("Could not open profile trace '", filename, "': ",
+                          strerror(errno));
+  }
+  Write_chrome_trace(out);
+  if(!out.flush())
+  {
+    throw so::Write_error("Could not write profile trace '", filename, "'");
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Profiler::Clear()
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  for(const std::unique_ptr<Profile_thread_buffer>& buffer : s.buffers)
+  {
+    buffer->Clear();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Profile_thread_buffer* so::Profiler::register_thread()
+{
+  thread_local Buffer_release release;
+  int64_t tid = syscall(SYS_gettid);
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  for(const std::unique_ptr<Profile_thread_buffer>& buffer : s.buffers)
+  {
+    if(buffer->Get_capacity() == s.buffer_size && buffer->Claim(tid))
+    {
+      release.buffer = buffer.get();
+      return release.buffer;
+    }
+  }
+  s.buffers.emplace_back(new Profile_thread_buffer(s.buffer_size, tid));
+  release.buffer = s.buffers.back().get();
+  return release.buffer;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+uint32_t so::Profiler::register_site(const char* name)
+{
+  State& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.sites.push_back(name);
+  return static_cast<uint32_t>(s.sites.size() - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
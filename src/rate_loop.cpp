@@ -0,0 +1,142 @@
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sno/clock.h>
+#include <sno/rate_loop.h>
+#include <sno/so_exception.h>
+
+namespace
+{
+
+/**
+ * @brief Largest lateness kept to full precision in the histograms
+ */
+const int64_t MAX_LATENESS_NS = 10000000000LL;
+
+/**
+ * @brief Convert a positive hz to a period, throwing if it cannot be one
+ */
+int64_t to_period(const double hz)
+{
+  if(!(hz > 0.0) || !isfinite(hz) || 1e9 / hz < 1.0)
+  {
+    throw so::Invalid_argument("Rate loop frequency must be positive and at"
+                               " most 1 GHz, got ", hz);
+  }
+  return static_cast<int64_t>(llround(1e9 / hz));
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rate_loop::Rate_loop(const double hz,
+                         const Overrun_policy policy,
+                         const std::chrono::nanoseconds spin,
+                         const Stopwatch::Clock_source source)
+  :
+    m_period(to_period(hz)),
+    m_policy(policy),
+    m_spin(spin.count()),
+    m_clock(source),
+    m_started(false),
+    m_deadline(0),
+    m_iterations(0),
+    m_overruns(0),
+    m_skipped(0),
+    m_jitter(MAX_LATENESS_NS),
+    m_overrun_times(MAX_LATENESS_NS)
+{
+  if(m_spin < 0)
+  {
+    throw so::Invalid_argument("Rate loop spin time must not be negative, got ",
+                               m_spin, " ns");
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Rate_loop::Start()
+{
+  m_clock.Reset();
+  m_clock.Start();
+  m_deadline = 0;
+  m_started = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool so::Rate_loop::Wait()
+{
+  if(!m_started)
+  {
+    Start();
+  }
+  m_deadline += m_period;
+  m_iterations++;
+
+  int64_t now = m_clock.Get_time_ns();
+  if(now <= m_deadline)
+  {
+    m_jitter.Record(wait_until(m_deadline) - m_deadline);
+    return true;
+  }
+
+  m_overruns++;
+  m_overrun_times.Record(now - m_deadline);
+  if(m_policy == Skip)
+  {
+    // Drop every deadline that has passed and keep to the original schedule
+    int64_t missed = (now - m_deadline) / m_period + 1;
+    m_skipped += missed;
+    m_deadline += missed * m_period;
+    wait_until(m_deadline);
+  }
+  return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Rate_loop::Reset_statistics()
+{
+  m_iterations = 0;
+  m_overruns = 0;
+  m_skipped = 0;
+  m_jitter.Reset();
+  m_overrun_times.Reset();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Rate_loop::wait_until(const int64_t deadline)
+{
+  if(Clock::Get_current())
+  {
+    // The replay moves the installed clock, so waiting for it could only
+    // hold the replay up
+    return deadline;
+  }
+  // The stopwatch may read the TSC, so the wake-up time is placed on
+  // CLOCK_MONOTONIC from the time left rather than from the schedule's start,
+  // which keeps the two clocks from drifting apart over a long run
+  int64_t now = m_clock.Get_time_ns();
+  if(deadline - m_spin > now)
+  {
+    int64_t wake = Clock::Real_monotonic_ns() + (deadline - m_spin - now);
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(wake / 1000000000);
+    ts.tv_nsec = static_cast<long>(wake % 1000000000);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+    {
+    }
+  }
+
+  now = m_clock.Get_time_ns();
+  while(now < deadline)
+  {
+    now = m_clock.Get_time_ns();
+  }
+  return now;
+}
+
+//////////////////////////////////////////////////////////////////////////////
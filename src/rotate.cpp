@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cmath>
 #include <constants.h>
 #include <sno/rotate.h>
+#include <sno/so_exception.h>
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -65,8 +67,248 @@ Eigen::Matrix3d so::Rotate::rot_z(double theta)
 
 //////////////////////////////////////////////////////////////////////////////
 
+void so::Rotate::body_2_earth(double& x,
+                              double& y,
+                              double& z,
+                              const double phi,
+                              const double theta,
+                              const double psi)
+{
+  Eigen::Vector3d p = body_2_earth(Eigen::Vector3d(x, y, z),
+                                   Eigen::Vector3d(phi, theta, psi));
+  x = p(0);
+  y = p(1);
+  z = p(2);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Rotate::body_2_earth(const Eigen::Vector3d& position,
+                                         const Eigen::Vector3d& attitude)
+{
+  return (rot_x(attitude(0)) * rot_y(attitude(1)) * rot_z(attitude(2))).transpose()
+      * position;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Rotate::earth_2_body(const Eigen::Vector3d& position,
+                                         const Eigen::Vector3d& attitude)
+{
+  return rot_x(attitude(0)) * rot_y(attitude(1)) * rot_z(attitude(2))
+      * position;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Rotate::body_2_earth(const Eigen::Vector3d& position,
+                                         const Eigen::Quaterniond& attitude)
+{
+  return attitude.normalized() * position;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Rotate::body_2_earth(const Eigen::Matrix3Xd& positions,
+                                          const Eigen::Quaterniond& attitude)
+{
+  return quat_2_dcm(attitude) * positions;
+}
+
+//////////////////////////////////////////////////////////////////////////////
 
+Eigen::Vector3d so::Rotate::earth_2_body(const Eigen::Vector3d& position,
+                                         const Eigen::Quaterniond& attitude)
+{
+  return attitude.normalized().conjugate() * position;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Rotate::earth_2_body(const Eigen::Matrix3Xd& positions,
+                                          const Eigen::Quaterniond& attitude)
+{
+  return quat_2_dcm(attitude).transpose() * positions;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/**
+ * @brief Apply a rotation matrix to points held as separate coordinate
+ * arrays. Each output row is a sum of whole arrays, which Eigen vectorizes
+ */
+void rotate_soa(const Eigen::Matrix3d& m,
+                const double* a,
+                const double* b,
+                const double* c,
+                const size_t n,
+                double* a_out,
+                double* b_out,
+                double* c_out)
+{
+  typedef Eigen::Map<const Eigen::ArrayXd> In;
+  typedef Eigen::Map<Eigen::ArrayXd> Out;
+  Eigen::Index size = static_cast<Eigen::Index>(n);
+  In in_a(a, size);
+  In in_b(b, size);
+  In in_c(c, size);
+  Out(a_out, size) = m(0, 0) * in_a + m(0, 1) * in_b + m(0, 2) * in_c;
+  Out(b_out, size) = m(1, 0) * in_a + m(1, 1) * in_b + m(1, 2) * in_c;
+  Out(c_out, size) = m(2, 0) * in_a + m(2, 1) * in_b + m(2, 2) * in_c;
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Rotate::body_2_earth(const double* x,
+                              const double* y,
+                              const double* z,
+                              const size_t n,
+                              const Eigen::Quaterniond& attitude,
+                              double* north,
+                              double* east,
+                              double* down)
+{
+  rotate_soa(quat_2_dcm(attitude), x, y, z, n, north, east, down);
+}
 
 //////////////////////////////////////////////////////////////////////////////
 
+void so::Rotate::earth_2_body(const double* north,
+                              const double* east,
+                              const double* down,
+                              const size_t n,
+                              const Eigen::Quaterniond& attitude,
+                              double* x,
+                              double* y,
+                              double* z)
+{
+  rotate_soa(quat_2_dcm(attitude).transpose(), north, east, down, n, x, y, z);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Quaterniond so::Rotate::euler_2_quat(const Eigen::Vector3d& attitude)
+{
+  // Heading, then pitch, then roll (3-2-1 sequence)
+  double cr = std::cos(attitude(0) * DEG_TO_RAD / 2);
+  double sr = std::sin(attitude(0) * DEG_TO_RAD / 2);
+  double cp = std::cos(attitude(1) * DEG_TO_RAD / 2);
+  double sp = std::sin(attitude(1) * DEG_TO_RAD / 2);
+  double cy = std::cos(attitude(2) * DEG_TO_RAD / 2);
+  double sy = std::sin(attitude(2) * DEG_TO_RAD / 2);
+  return Eigen::Quaterniond(cr * cp * cy + sr * sp * sy,
+                            sr * cp * cy - cr * sp * sy,
+                            cr * sp * cy + sr * cp * sy,
+                            cr * cp * sy - sr * sp * cy);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Rotate::quat_2_euler(const Eigen::Quaterniond& q)
+{
+  Eigen::Quaterniond unit = q.normalized();
+  double w = unit.w();
+  double x = unit.x();
+  double y = unit.y();
+  double z = unit.z();
+  double sin_pitch = std::max(-1.0, std::min(1.0, 2 * (w * y - z * x)));
+  return Eigen::Vector3d(
+        std::atan2(2 * (w * x + y * z), 1 - 2 * (x * x + y * y)) * RAD_TO_DEG,
+        std::asin(sin_pitch) * RAD_TO_DEG,
+        std::atan2(2 * (w * z + x * y), 1 - 2 * (y * y + z * z)) * RAD_TO_DEG);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3d so::Rotate::quat_2_dcm(const Eigen::Quaterniond& q)
+{
+  return q.normalized().toRotationMatrix();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Quaterniond so::Rotate::dcm_2_quat(const Eigen::Matrix3d& dcm)
+{
+  return Eigen::Quaterniond(dcm).normalized();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Quaterniond so::Rotate::quat_compose(const Eigen::Quaterniond& q_ab,
+                                            const Eigen::Quaterniond& q_bc)
+{
+  return (q_ab * q_bc).normalized();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Quaterniond so::Rotate::quat_inverse(const Eigen::Quaterniond& q)
+{
+  return q.conjugate();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix4Xd so::Rotate::euler_2_quat(const Eigen::Matrix3Xd& attitudes)
+{
+  // Work on whole rows so the trigonometry is evaluated as array expressions
+  Eigen::Array<double, 3, Eigen::Dynamic> half = attitudes.array() * (DEG_TO_RAD / 2);
+  Eigen::Array<double, 3, Eigen::Dynamic> c = half.cos();
+  Eigen::Array<double, 3, Eigen::Dynamic> s = half.sin();
+  Eigen::Matrix4Xd q(4, attitudes.cols());
+  q.row(0) = c.row(0) * c.row(1) * c.row(2) + s.row(0) * s.row(1) * s.row(2);
+  q.row(1) = s.row(0) * c.row(1) * c.row(2) - c.row(0) * s.row(1) * s.row(2);
+  q.row(2) = c.row(0) * s.row(1) * c.row(2) + s.row(0) * c.row(1) * s.row(2);
+  q.row(3) = c.row(0) * c.row(1) * s.row(2) - s.row(0) * s.row(1) * c.row(2);
+  return q;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Rotate::quat_2_euler(const Eigen::Matrix4Xd& q)
+{
+  Eigen::Matrix3Xd attitudes(3, q.cols());
+  for(Eigen::Index i = 0; i < q.cols(); i++)
+  {
+    attitudes.col(i) = quat_2_euler(Eigen::Quaterniond(q(0, i),
+                                                       q(1, i),
+                                                       q(2, i),
+                                                       q(3, i)));
+  }
+  return attitudes;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Rotate::body_2_earth(const Eigen::Matrix3Xd& positions,
+                                          const Eigen::Matrix4Xd& attitudes)
+{
+  if(positions.cols() != attitudes.cols())
+  {
+    throw so::Invalid_argument("Number of points (",
+                               positions.cols(),
+                               ") does not match the number of attitudes (",
+                               attitudes.cols(),
+                               ")");
+  }
+
+  // v' = v + 2w(u x v) + 2u x (u x v), u = [x, y, z], for the normalized
+  // quaternion
+  Eigen::Matrix3Xd earth(3, positions.cols());
+  for(Eigen::Index i = 0; i < positions.cols(); i++)
+  {
+    double scale = 1 / attitudes.col(i).norm();
+    Eigen::Vector3d u = attitudes.block<3, 1>(1, i) * scale;
+    Eigen::Vector3d v = positions.col(i);
+    Eigen::Vector3d t = 2 * u.cross(v);
+    earth.col(i) = v + attitudes(0, i) * scale * t + u.cross(t);
+  }
+  return earth;
+}
+
 //////////////////////////////////////////////////////////////////////////////
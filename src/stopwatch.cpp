@@ -1,11 +1,12 @@
 #include <stopwatch_impl.h>
+#include <sno/latency_histogram.h>
 #include <sno/stopwatch.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 
-so::Stopwatch::Stopwatch()
+so::Stopwatch::Stopwatch(const Clock_source source)
   :
-    m_pimpl(new Stopwatch_impl())
+    m_pimpl(new Stopwatch_impl(source))
 {
 
 }
@@ -48,14 +49,41 @@ void so::Stopwatch::Start()
 
 double so::Stopwatch::Stop()
 {
-  return m_pimpl->Stop();
+  return m_pimpl->Stop_ns() * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Stopwatch::Stop_ns()
+{
+  return m_pimpl->Stop_ns();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 double so::Stopwatch::Split()
 {
-  return m_pimpl->Split();
+  return m_pimpl->Split_ns() * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Stopwatch::Split_ns()
+{
+  return m_pimpl->Split_ns();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Stopwatch::Split_ns(Latency_histogram& histogram)
+{
+  if(!m_pimpl->Is_running())
+  {
+    return 0;
+  }
+  int64_t split = m_pimpl->Split_ns();
+  histogram.Record(split);
+  return split;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -69,7 +97,14 @@ void so::Stopwatch::Reset()
 
 double so::Stopwatch::Get_time()
 {
-  return m_pimpl->Get_time();
+  return m_pimpl->Get_time_ns() * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Stopwatch::Get_time_ns()
+{
+  return m_pimpl->Get_time_ns();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
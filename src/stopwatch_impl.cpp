@@ -1,7 +1,7 @@
+#include <chrono>
 
-#include <boost/numeric/conversion/cast.hpp>
-
-#include <sno/so_exception.h>
+#include <sno/clock.h>
+#include <sno/tsc_clock.h>
 #include <stopwatch_impl.h>
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -9,9 +9,10 @@
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 
-so::Stopwatch_impl::Stopwatch_impl()
+so::Stopwatch_impl::Stopwatch_impl(const Stopwatch::Clock_source source)
   :
-    m_start_time(),
+    m_source(source),
+    m_start_time(0),
     m_last_split(m_start_time),
     m_elapsed_time(0),
     m_running(false)
@@ -33,50 +34,80 @@ void so::Stopwatch_impl::Start()
 
 //////////////////////////////////////////////////////////////////////////////
 
-double so::Stopwatch_impl::Stop()
+int64_t so::Stopwatch_impl::Stop_ns()
 {
   update_elapsed_time();
   m_running = false;
-  return m_elapsed_time;
+  return to_ns(m_elapsed_time);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
-double so::Stopwatch_impl::Split()
+int64_t so::Stopwatch_impl::Split_ns()
 {
   if(!m_running)
   {
     return 0;
   }
-  std::chrono::time_point<Clock_type> now = Clock_type::now();
-  auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - m_last_split).count();
+  int64_t now = now_serialized();
+  int64_t split = now - m_last_split;
   m_last_split = now;
-  try
+  return to_ns(split);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Stopwatch_impl::Reset()
+{
+  m_start_time = now();
+  m_last_split = m_start_time;
+  m_elapsed_time = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Stopwatch_impl::Get_time_ns()
+{
+  update_elapsed_time();
+  return to_ns(m_elapsed_time);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+int64_t so::Stopwatch_impl::now() const
+{
+  const Clock* clock = Clock::Get_current();
+  if(clock)
   {
-    double seconds = boost::numeric_cast<double>(us) / 1.0e6;
-    return seconds;
+    return clock->Monotonic_ns();
   }
-  catch(const boost::bad_numeric_cast& e)
+  if(m_source == Stopwatch::Tsc)
   {
-    throw so::Invalid_argument(e.what());
+    return Tsc_clock::Now();
   }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
-void so::Stopwatch_impl::Reset()
+int64_t so::Stopwatch_impl::now_serialized() const
 {
-  m_start_time = Clock_type::now();
-  m_last_split = Clock_type::now();
-  m_elapsed_time = 0;
+  return uses_tsc() ? Tsc_clock::Now_serialized() : now();
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
-double so::Stopwatch_impl::Get_time()
+int64_t so::Stopwatch_impl::to_ns(const int64_t ticks) const
 {
-  update_elapsed_time();
-  return m_elapsed_time;
+  return uses_tsc() ? Tsc_clock::To_ns(ticks) : ticks;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool so::Stopwatch_impl::uses_tsc() const
+{
+  return m_source == Stopwatch::Tsc && !Clock::Get_current();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -85,18 +116,6 @@ void so::Stopwatch_impl::update_elapsed_time()
 {
   if(m_running)
   {
-    auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock_type::now() - m_start_time).count();
-    try
-    {
-      double seconds = boost::numeric_cast<double>(us) / 1.0e6;
-      m_elapsed_time = seconds;
-    }
-    catch(const boost::bad_numeric_cast& e)
-    {
-      throw so::Invalid_argument("Failed to convert ",
-                                 us,
-                                 " microseconds to seconds: ",
-                                 e.what());
-    }
+    m_elapsed_time = now_serialized() - m_start_time;
   }
 }
@@ -0,0 +1,136 @@
+#include <cmath>
+#include <sno/rotate.h>
+#include <sno/so_exception.h>
+#include <sno/strapdown.h>
+
+namespace
+{
+
+/**
+ * @brief Convert a rotation vector to a quaternion
+ * @param phi Rotation vector, rad
+ * @return Quaternion for a rotation of |phi| about phi
+ */
+Eigen::Quaterniond rotation_vector_2_quat(const Eigen::Vector3d& phi)
+{
+  double angle_sq = phi.squaredNorm();
+  double c;
+  double s;
+  if(angle_sq < 1e-12)
+  {
+    // Taylor series, avoids dividing by a vanishing angle
+    c = 1 - angle_sq / 8;
+    s = 0.5 - angle_sq / 48;
+  }
+  else
+  {
+    double angle = std::sqrt(angle_sq);
+    c = std::cos(angle / 2);
+    s = std::sin(angle / 2) / angle;
+  }
+  return Eigen::Quaterniond(c, s * phi(0), s * phi(1), s * phi(2));
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Strapdown::Strapdown(const Eigen::Vector3d& attitude,
+                         const Eigen::Vector3d& velocity,
+                         const double gravity)
+  :
+    m_q(so::Rotate::euler_2_quat(attitude)),
+    m_v(velocity),
+    m_gravity(0, 0, gravity),
+    m_prev_dtheta(Eigen::Vector3d::Zero()),
+    m_prev_dv(Eigen::Vector3d::Zero())
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Strapdown::Integrate(const Eigen::Matrix3Xd& gyro,
+                              const Eigen::Matrix3Xd& accel,
+                              const double dt)
+{
+  Integrate_increments(gyro * dt, accel * dt, dt);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Strapdown::Integrate_increments(const Eigen::Matrix3Xd& delta_theta,
+                                         const Eigen::Matrix3Xd& delta_v,
+                                         const double dt)
+{
+  if(delta_theta.cols() != delta_v.cols())
+  {
+    throw so::Invalid_argument("Number of angle increments (",
+                               delta_theta.cols(),
+                               ") does not match the number of velocity increments (",
+                               delta_v.cols(),
+                               ")");
+  }
+  if(!(dt > 0))
+  {
+    throw so::Invalid_argument("Sample interval must be positive, got ", dt);
+  }
+
+  Eigen::Vector3d gravity_dv = m_gravity * dt;
+  for(Eigen::Index i = 0; i < delta_theta.cols(); i++)
+  {
+    Eigen::Vector3d alpha = delta_theta.col(i);
+    Eigen::Vector3d dv = delta_v.col(i);
+
+    // Coning correction to the rotation vector
+    Eigen::Vector3d phi = alpha + m_prev_dtheta.cross(alpha) / 12;
+
+    // Rotation and sculling corrections to the velocity increment
+    Eigen::Vector3d dv_body = dv
+        + alpha.cross(dv) / 2
+        + (m_prev_dtheta.cross(dv) + m_prev_dv.cross(alpha)) / 12;
+
+    m_v += m_q * dv_body + gravity_dv;
+    m_q = m_q * rotation_vector_2_quat(phi);
+
+    m_prev_dtheta = alpha;
+    m_prev_dv = dv;
+  }
+
+  // Once per block is enough to keep rounding error from accumulating
+  m_q.normalize();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Strapdown::Reset(const Eigen::Vector3d& attitude,
+                          const Eigen::Vector3d& velocity)
+{
+  m_q = so::Rotate::euler_2_quat(attitude);
+  m_v = velocity;
+  m_prev_dtheta.setZero();
+  m_prev_dv.setZero();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Strapdown::Get_attitude() const
+{
+  return so::Rotate::quat_2_euler(m_q);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+const Eigen::Quaterniond& so::Strapdown::Get_quaternion() const
+{
+  return m_q;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+const Eigen::Vector3d& so::Strapdown::Get_velocity() const
+{
+  return m_v;
+}
+
+//////////////////////////////////////////////////////////////////////////////
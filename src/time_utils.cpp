@@ -1,26 +1,147 @@
-#include <boost/numeric/conversion/cast.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <sno/time_utils.h>
-#include <sno/so_exception.h>
 
-double so::Time_utils::Unix_time()
+namespace
+{
+
+/**
+ * @brief Background thread of the cached clock
+ */
+struct Cached_clock
 {
-  auto unix_timestamp = std::chrono::seconds(std::time(nullptr));
-  ssize_t unix_us = std::chrono::microseconds(unix_timestamp).count();
-  double sec = 0;
-  try
+  Cached_clock()
+    :
+      mutex(),
+      wake(),
+      thread(),
+      running(false),
+      generation(0),
+      period(100)
+  {
+  }
+
+  /**
+   * @brief Destructor, stops the thread so that exiting with the cached clock
+   * running is safe
+   */
+  ~Cached_clock()
+  {
+    stop();
+  }
+
+  /**
+   * @brief Store the time every period until stopped
+   * @param id Generation the thread was started for. A thread still
+   * finishing after a restart must not touch the new thread's value
+   */
+  void run(const uint64_t id)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(running && generation == id)
+    {
+      store();
+      wake.wait_for(lock, period);
+    }
+    if(generation == id)
+    {
+      so::Time_utils::Cached_time_value().store(0, boost::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Store the real time, unless a so::Clock is installed. If
+   * Clock::Set_current() installs one after the check, either its clearing
+   * store comes after ours, or the fence makes the second check see the
+   * clock and we clear the value ourselves
+   */
+  static void store()
   {
-    sec = boost::numeric_cast<double>(unix_us) / 1.0e6;
-  }catch(const boost::bad_numeric_cast& e)
+    boost::atomic<int64_t>& value = so::Time_utils::Cached_time_value();
+    if(so::Clock::Get_current())
+    {
+      return;
+    }
+    value.store(so::Clock::Real_unix_ns(), boost::memory_order_seq_cst);
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if(so::Clock::Get_current())
+    {
+      value.store(0, boost::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Stop the thread and wait for it. The join happens outside the
+   * lock, which the thread needs to finish
+   */
+  void stop()
   {
-    throw so::Invalid_argument(e.what());
+    std::thread finished;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+      finished.swap(thread);
+    }
+    wake.notify_all();
+    if(finished.joinable())
+    {
+      finished.join();
+    }
   }
-  return sec;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::thread thread;
+  bool running;
+  uint64_t generation;
+  std::chrono::microseconds period;
+};
+
+Cached_clock& cached_clock()
+{
+  static Cached_clock c;
+  return c;
 }
 
+} // Anonymous namespace
+
 //////////////////////////////////////////////////////////////////////////////
 
+double so::Time_utils::Unix_time()
+{
+  const Clock* clock = Clock::Get_current();
+  if(clock)
+  {
+    return clock->Unix_ns() * 1e-9;
+  }
+  return Clock::Real_unix_ns() * 1e-9;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
+void so::Time_utils::Start_cached_time(const std::chrono::microseconds period)
+{
+  Cached_clock& c = cached_clock();
+  std::lock_guard<std::mutex> lock(c.mutex);
+  c.period = period;
+  if(c.running)
+  {
+    c.wake.notify_all();
+    return;
+  }
+  // Readers see a valid time as soon as this returns
+  Cached_clock::store();
+  c.running = true;
+  c.generation++;
+  c.thread = std::thread(&Cached_clock::run, &c, c.generation);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
+void so::Time_utils::Stop_cached_time()
+{
+  cached_clock().stop();
+}
+
 //////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,145 @@
+#include <sno/rotate.h>
+#include <transform_graph_impl.h>
+#include <sno/transform_graph.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform::Rigid_transform()
+  :
+    m_rotation(Eigen::Quaterniond::Identity()),
+    m_translation(Eigen::Vector3d::Zero())
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform::Rigid_transform(const Eigen::Quaterniond& rotation,
+                                     const Eigen::Vector3d& translation)
+  :
+    m_rotation(rotation.normalized()),
+    m_translation(translation)
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform::Rigid_transform(const Eigen::Vector3d& attitude,
+                                     const Eigen::Vector3d& translation)
+  :
+    m_rotation(so::Rotate::euler_2_quat(attitude)),
+    m_translation(translation)
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+const Eigen::Quaterniond& so::Rigid_transform::Get_rotation() const
+{
+  return m_rotation;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+const Eigen::Vector3d& so::Rigid_transform::Get_translation() const
+{
+  return m_translation;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Vector3d so::Rigid_transform::Apply(const Eigen::Vector3d& p) const
+{
+  return m_rotation * p + m_translation;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+Eigen::Matrix3Xd so::Rigid_transform::Apply(const Eigen::Matrix3Xd& p) const
+{
+  return so::Rotate::body_2_earth(p, m_rotation).colwise() + m_translation;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform so::Rigid_transform::Inverse() const
+{
+  Eigen::Quaterniond inv = m_rotation.conjugate();
+  return Rigid_transform(inv, -(inv * m_translation));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform so::Rigid_transform::operator*(
+    const Rigid_transform& other) const
+{
+  return Rigid_transform(m_rotation * other.m_rotation,
+                         m_rotation * other.m_translation + m_translation);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Transform_graph::Transform_graph()
+  :
+    m_pimpl(new Transform_graph_impl())
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Transform_graph::~Transform_graph() = default;
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Transform_graph::Transform_graph(Transform_graph&& other) = default;
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Transform_graph& so::Transform_graph::operator=(Transform_graph&& other) = default;
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Transform_graph::Add_static_edge(const std::string& child,
+                                          const std::string& parent,
+                                          const Rigid_transform& child_2_parent)
+{
+  m_pimpl->Add_static_edge(child, parent, child_2_parent);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Transform_graph::Edge_id so::Transform_graph::Add_dynamic_edge(
+    const std::string& child,
+    const std::string& parent)
+{
+  return m_pimpl->Add_dynamic_edge(child, parent);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Transform_graph::Chain_id so::Transform_graph::Add_chain(
+    const std::string& source,
+    const std::string& target)
+{
+  return m_pimpl->Add_chain(source, target);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Transform_graph::Update_edge(const Edge_id edge,
+                                      const Rigid_transform& child_2_parent)
+{
+  m_pimpl->Update_edge(edge, child_2_parent);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform so::Transform_graph::Lookup(const Chain_id chain) const
+{
+  return m_pimpl->Lookup(chain);
+}
+
+//////////////////////////////////////////////////////////////////////////////
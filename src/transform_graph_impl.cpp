@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <array>
+#include <sno/so_exception.h>
+#include <transform_graph_impl.h>
+
+namespace
+{
+/**
+ * @brief Maximum number of dynamic edges along a chain. Lookups keep their
+ * stamps on the stack so they never allocate
+ */
+const size_t MAX_DYNAMIC_SEGMENTS = 32;
+
+typedef std::array<uint64_t, MAX_DYNAMIC_SEGMENTS> Stamps;
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Seqlock_transform::Seqlock_transform()
+  :
+    m_seq(0),
+    m_values(),
+    m_stamps(),
+    m_num_stamps(0)
+{
+  Rigid_transform identity;
+  Store(identity);
+  m_seq.store(0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Seqlock_transform::Store(const Rigid_transform& t,
+                                  const uint64_t* stamps,
+                                  const size_t num_stamps)
+{
+  uint64_t seq = m_seq.load(std::memory_order_relaxed);
+  m_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const Eigen::Quaterniond& q = t.Get_rotation();
+  const Eigen::Vector3d& p = t.Get_translation();
+  m_values[0].store(q.w(), std::memory_order_relaxed);
+  m_values[1].store(q.x(), std::memory_order_relaxed);
+  m_values[2].store(q.y(), std::memory_order_relaxed);
+  m_values[3].store(q.z(), std::memory_order_relaxed);
+  m_values[4].store(p(0), std::memory_order_relaxed);
+  m_values[5].store(p(1), std::memory_order_relaxed);
+  m_values[6].store(p(2), std::memory_order_relaxed);
+  for(size_t i = 0; i < num_stamps; i++)
+  {
+    m_stamps[i].store(stamps[i], std::memory_order_relaxed);
+  }
+
+  m_seq.store(seq + 2, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t so::Seqlock_transform::Load(Rigid_transform& t,
+                                     uint64_t* stamps) const
+{
+  double v[7];
+  while(true)
+  {
+    uint64_t before = m_seq.load(std::memory_order_acquire);
+    if(before & 1)
+    {
+      continue;
+    }
+    for(size_t i = 0; i < 7; i++)
+    {
+      v[i] = m_values[i].load(std::memory_order_relaxed);
+    }
+    if(stamps)
+    {
+      for(size_t i = 0; i < m_num_stamps; i++)
+      {
+        stamps[i] = m_stamps[i].load(std::memory_order_relaxed);
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(m_seq.load(std::memory_order_relaxed) == before)
+    {
+      t = Rigid_transform(Eigen::Quaterniond(v[0], v[1], v[2], v[3]),
+                          Eigen::Vector3d(v[4], v[5], v[6]));
+      return before;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t so::Seqlock_transform::Get_sequence() const
+{
+  return m_seq.load(std::memory_order_acquire);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Seqlock_transform::Resize_stamps(const size_t num_stamps)
+{
+  m_stamps.reset(new std::atomic<uint64_t>[num_stamps]);
+  for(size_t i = 0; i < num_stamps; i++)
+  {
+    m_stamps[i].store(0);
+  }
+  m_num_stamps = num_stamps;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Transform_graph_impl::Transform_graph_impl()
+  :
+    m_frame_ids(),
+    m_frames(),
+    m_dynamic_edges(),
+    m_chains()
+{
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Transform_graph_impl::Add_static_edge(
+    const std::string& child,
+    const std::string& parent,
+    const Rigid_transform& child_2_parent)
+{
+  size_t c = link(child, parent);
+  m_frames[c].is_static = true;
+  m_frames[c].static_transform = child_2_parent;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Transform_graph_impl::Add_dynamic_edge(const std::string& child,
+                                                  const std::string& parent)
+{
+  size_t c = link(child, parent);
+  m_frames[c].is_static = false;
+  m_frames[c].dynamic_edge = m_dynamic_edges.size();
+  m_dynamic_edges.emplace_back(new Seqlock_transform());
+  return m_frames[c].dynamic_edge;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Transform_graph_impl::Add_chain(const std::string& source,
+                                           const std::string& target)
+{
+  size_t s = get_frame(source);
+  size_t t = get_frame(target);
+
+  // Walk from each end to its root, then find the lowest common ancestor
+  std::vector<size_t> source_path;
+  for(long f = s; f >= 0; f = m_frames[f].parent)
+  {
+    source_path.push_back(f);
+  }
+  std::vector<size_t> target_path;
+  for(long f = t; f >= 0; f = m_frames[f].parent)
+  {
+    target_path.push_back(f);
+  }
+  auto target_lca = std::find_first_of(target_path.begin(), target_path.end(),
+                                       source_path.begin(), source_path.end());
+  if(target_lca == target_path.end())
+  {
+    throw so::Invalid_argument("Frames '", source, "' and '", target,
+                               "' are not connected");
+  }
+  auto source_lca = std::find(source_path.begin(), source_path.end(),
+                              *target_lca);
+
+  // Edges in application order: up from the source, then down to the target
+  std::vector<std::pair<size_t, bool> > steps;
+  for(auto it = source_path.begin(); it != source_lca; ++it)
+  {
+    steps.emplace_back(*it, false);
+  }
+  for(auto it = std::reverse_iterator<std::vector<size_t>::iterator>(target_lca);
+      it != target_path.rend();
+      ++it)
+  {
+    steps.emplace_back(*it, true);
+  }
+
+  // Fold runs of static edges into a single constant segment
+  std::unique_ptr<Chain> chain(new Chain());
+  chain->num_dynamic = 0;
+  Rigid_transform run;
+  bool in_run = false;
+  for(const std::pair<size_t, bool>& step : steps)
+  {
+    const Frame& frame = m_frames[step.first];
+    if(frame.is_static)
+    {
+      const Rigid_transform& e = frame.static_transform;
+      run = (step.second ? e.Inverse() : e) * run;
+      in_run = true;
+      continue;
+    }
+    if(in_run)
+    {
+      chain->segments.push_back(Segment{nullptr, false, run});
+      run = Rigid_transform();
+      in_run = false;
+    }
+    chain->segments.push_back(
+          Segment{m_dynamic_edges[frame.dynamic_edge].get(),
+                  step.second,
+                  Rigid_transform()});
+    chain->num_dynamic++;
+  }
+  if(in_run || chain->segments.empty())
+  {
+    chain->segments.push_back(Segment{nullptr, false, run});
+  }
+
+  if(chain->num_dynamic > MAX_DYNAMIC_SEGMENTS)
+  {
+    throw so::Invalid_argument("Chain from '", source, "' to '", target,
+                               "' has ", chain->num_dynamic,
+                               " dynamic edges, at most ",
+                               MAX_DYNAMIC_SEGMENTS, " are supported");
+  }
+
+  chain->refreshing.clear();
+  chain->cache.Resize_stamps(chain->num_dynamic);
+  Stamps stamps;
+  chain->cache.Store(compose(*chain, stamps.data()),
+                     stamps.data(),
+                     chain->num_dynamic);
+
+  m_chains.push_back(std::move(chain));
+  return m_chains.size() - 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void so::Transform_graph_impl::Update_edge(const size_t edge,
+                                           const Rigid_transform& child_2_parent)
+{
+  if(edge >= m_dynamic_edges.size())
+  {
+    throw so::Invalid_argument("Invalid dynamic edge handle: ", edge);
+  }
+  m_dynamic_edges[edge]->Store(child_2_parent);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform so::Transform_graph_impl::Lookup(const size_t chain) const
+{
+  if(chain >= m_chains.size())
+  {
+    throw so::Invalid_argument("Invalid chain handle: ", chain);
+  }
+  const Chain& c = *m_chains[chain];
+
+  Stamps current;
+  size_t d = 0;
+  for(const Segment& segment : c.segments)
+  {
+    if(segment.edge)
+    {
+      current[d++] = segment.edge->Get_sequence();
+    }
+  }
+
+  Rigid_transform t;
+  Stamps cached;
+  c.cache.Load(t, cached.data());
+  if(std::equal(current.begin(), current.begin() + d, cached.begin()))
+  {
+    return t;
+  }
+
+  // Stale: recompute, and publish unless another reader is already doing so
+  t = compose(c, current.data());
+  if(!c.refreshing.test_and_set(std::memory_order_acquire))
+  {
+    c.cache.Store(t, current.data(), c.num_dynamic);
+    c.refreshing.clear(std::memory_order_release);
+  }
+  return t;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Transform_graph_impl::get_or_add_frame(const std::string& name)
+{
+  auto it = m_frame_ids.find(name);
+  if(it != m_frame_ids.end())
+  {
+    return it->second;
+  }
+  Frame frame;
+  frame.parent = -1;
+  frame.is_static = true;
+  frame.dynamic_edge = 0;
+  m_frames.push_back(frame);
+  m_frame_ids[name] = m_frames.size() - 1;
+  return m_frames.size() - 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Transform_graph_impl::get_frame(const std::string& name) const
+{
+  auto it = m_frame_ids.find(name);
+  if(it == m_frame_ids.end())
+  {
+    throw so::Invalid_argument("Unknown frame '", name, "'");
+  }
+  return it->second;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+size_t so::Transform_graph_impl::link(const std::string& child,
+                                      const std::string& parent)
+{
+  size_t c = get_or_add_frame(child);
+  size_t p = get_or_add_frame(parent);
+  if(m_frames[c].parent >= 0)
+  {
+    throw so::Invalid_argument("Frame '", child, "' already has a parent");
+  }
+  for(long f = p; f >= 0; f = m_frames[f].parent)
+  {
+    if(static_cast<size_t>(f) == c)
+    {
+      throw so::Invalid_argument("Edge from '", child, "' to '", parent,
+                                 "' would create a cycle");
+    }
+  }
+  m_frames[c].parent = static_cast<long>(p);
+  return c;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Rigid_transform so::Transform_graph_impl::compose(const Chain& chain,
+                                                      uint64_t* stamps) const
+{
+  Rigid_transform result;
+  size_t d = 0;
+  for(const Segment& segment : chain.segments)
+  {
+    if(!segment.edge)
+    {
+      result = segment.constant * result;
+      continue;
+    }
+    Rigid_transform e;
+    stamps[d++] = segment.edge->Load(e);
+    result = (segment.inverse ? e.Inverse() : e) * result;
+  }
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////
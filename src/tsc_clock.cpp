@@ -0,0 +1,80 @@
+#include <chrono>
+#include <thread>
+#include <sno/tsc_clock.h>
+#ifdef SO_TSC_CLOCK_X86
+#include <cpuid.h>
+#endif
+
+namespace
+{
+
+#ifdef SO_TSC_CLOCK_X86
+/**
+ * @brief Check the CPUID invariant TSC flag
+ */
+bool has_invariant_tsc()
+{
+  unsigned int eax, ebx, ecx, edx;
+  if(!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+  {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1u << 8)) != 0;
+}
+
+/**
+ * @brief Read the steady clock together with the counter. The read with the
+ * fewest ticks between the counter readings either side of it is kept, and
+ * the counter is taken to be halfway between them
+ */
+void read_both(int64_t& ticks, int64_t& ns)
+{
+  int64_t best = INT64_MAX;
+  for(int i = 0; i < 16; i++)
+  {
+    int64_t before = static_cast<int64_t>(__rdtsc());
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t after = static_cast<int64_t>(__rdtsc());
+    if(after - before < best)
+    {
+      best = after - before;
+      ticks = before + best / 2;
+      ns = now;
+    }
+  }
+}
+#endif
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+so::Tsc_clock::Calibration so::Tsc_clock::calibrate()
+{
+  Calibration c;
+  c.tsc = false;
+  c.ticks_per_second = 1e9;
+  c.ns_per_tick_q32 = static_cast<int64_t>(1) << 32;
+
+#ifdef SO_TSC_CLOCK_X86
+  if(has_invariant_tsc())
+  {
+    int64_t ticks0 = 0, ns0 = 0, ticks1 = 0, ns1 = 0;
+    read_both(ticks0, ns0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    read_both(ticks1, ns1);
+    if(ticks1 > ticks0 && ns1 > ns0)
+    {
+      c.tsc = true;
+      c.ticks_per_second = (ticks1 - ticks0) * 1e9 / (ns1 - ns0);
+      c.ns_per_tick_q32 = static_cast<int64_t>(
+            1e9 / c.ticks_per_second * 4294967296.0 + 0.5);
+    }
+  }
+#endif
+  return c;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/clock_mapper.h>
+#include <sno/so_exception.h>
+#include <sno/time_utils.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Both sources map the current time to within a millisecond of the wall
+// clock, one stamp at a time or in a batch
+TEST(ClockMapperTests, sources)
+{
+  for(so::Time_utils::Clock_mapper::Source source :
+      {so::Time_utils::Clock_mapper::Monotonic,
+       so::Time_utils::Clock_mapper::Tsc})
+  {
+    so::Time_utils::Clock_mapper mapper(source);
+    mapper.Start(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_NEAR(mapper.Now_unix_ns(), so::Time_utils::Unix_time_ns(), 1000000);
+    mapper.Stop();
+
+    std::vector<int64_t> raw;
+    for(int i = 0; i < 16; i++)
+    {
+      raw.push_back(mapper.Now_raw());
+    }
+    std::vector<int64_t> unix_ns(raw.size());
+    mapper.To_unix_ns(raw.data(), unix_ns.data(), raw.size());
+    for(size_t i = 0; i < raw.size(); i++)
+    {
+      EXPECT_EQ(unix_ns[i], mapper.To_unix_ns(raw[i]));
+      EXPECT_DOUBLE_EQ(mapper.To_unix_time(raw[i]), unix_ns[i] * 1e-9);
+    }
+    EXPECT_NEAR(unix_ns.back(), so::Time_utils::Unix_time_ns(), 1000000);
+  }
+
+  EXPECT_THROW(so::Time_utils::Clock_mapper(
+                 so::Time_utils::Clock_mapper::Monotonic, 0),
+               so::Invalid_argument);
+  EXPECT_THROW(so::Time_utils::Clock_mapper(
+                 so::Time_utils::Clock_mapper::Monotonic, 1000000, 0.0),
+               so::Invalid_argument);
+}
+
+// A wall clock running 200 ppm fast is followed without converted times
+// going backwards, and a step is applied at once
+TEST(ClockMapperTests, slewAndStep)
+{
+  const int64_t PERIOD_NS = 100000000;
+  so::Time_utils::Clock_mapper mapper;
+  int64_t raw0 = mapper.Now_raw();
+  int64_t unix0 = mapper.To_unix_ns(raw0);
+
+  int64_t previous = unix0;
+  for(int64_t k = 1; k <= 200; k++)
+  {
+    int64_t raw = raw0 + k * PERIOD_NS;
+    mapper.Update(raw, unix0 + k * PERIOD_NS + k * PERIOD_NS / 5000);
+    int64_t mapped = mapper.To_unix_ns(raw);
+    EXPECT_GT(mapped, previous);
+    previous = mapped;
+  }
+  EXPECT_LT(std::abs(mapper.Get_last_error_ns()), 1000);
+  EXPECT_EQ(mapper.Get_step_count(), 0u);
+
+  // Half a period later, the model runs at the wall clock's rate
+  int64_t raw = raw0 + 200 * PERIOD_NS;
+  int64_t expected = unix0 + 200 * PERIOD_NS + 200 * PERIOD_NS / 5000 +
+                     PERIOD_NS / 2 + PERIOD_NS / 2 / 5000;
+  EXPECT_NEAR(mapper.To_unix_ns(raw + PERIOD_NS / 2), expected, 1000);
+
+  // The wall clock steps forward one second
+  raw += PERIOD_NS;
+  int64_t stepped = unix0 + 201 * PERIOD_NS + 201 * PERIOD_NS / 5000 +
+                    1000000000;
+  mapper.Update(raw, stepped);
+  EXPECT_EQ(mapper.Get_step_count(), 1u);
+  EXPECT_EQ(mapper.To_unix_ns(raw), stepped);
+}
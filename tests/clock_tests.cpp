@@ -0,0 +1,107 @@
+#include <string>
+#include <gtest/gtest.h>
+#include <sno/clock.h>
+#include <sno/log_clock.h>
+#include <sno/log_limiter.h>
+#include <sno/rate_loop.h>
+#include <sno/so_exception.h>
+#include <sno/stopwatch.h>
+#include <sno/time_utils.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+class ClockTests : public ::testing::Test
+{
+protected:
+  void TearDown() override
+  {
+    so::Clock::Set_current(nullptr);
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+// With a virtual clock installed, a day of replayed timestamps gives the same
+// timings as the data, however fast the replay runs
+TEST_F(ClockTests, virtualClock)
+{
+  const int64_t START = 1000000000000000000LL;
+  so::Virtual_clock clock(START);
+  so::Clock::Set_current(&clock);
+  EXPECT_EQ(so::Clock::Get_current(), &clock);
+
+  so::Stopwatch steady;
+  so::Stopwatch tsc(so::Stopwatch::Tsc);
+  steady.Start();
+  tsc.Start();
+  for(int64_t second = 1; second <= 86400; second++)
+  {
+    clock.Set_unix_ns(START + second * 1000000000);
+    ASSERT_EQ(steady.Split_ns(), 1000000000);
+  }
+  EXPECT_EQ(tsc.Stop_ns(), 86400 * 1000000000LL);
+  EXPECT_DOUBLE_EQ(steady.Get_time(), 86400.0);
+
+  int64_t now = START + 86400 * 1000000000LL;
+  EXPECT_EQ(so::Time_utils::Unix_time_ns(), now);
+  EXPECT_EQ(so::Time_utils::Unix_time_us(), now / 1000);
+  EXPECT_DOUBLE_EQ(so::Time_utils::Unix_time(), now * 1e-9);
+  EXPECT_EQ(so::Time_utils::Cached_unix_time_ns(), now);
+  EXPECT_EQ(so::Log_clock::Now(so::Log_clock::Wall_coarse), now);
+  EXPECT_EQ(so::Log_clock::Now(so::Log_clock::Monotonic), 86400 * 1000000000LL);
+
+  char text[so::Log_clock::MAX_TEXT];
+  size_t len = so::Log_clock::Format(so::Log_clock::Wall,
+                                     so::Log_clock::Now(so::Log_clock::Wall),
+                                     text);
+  EXPECT_EQ(std::string(text, len), "2001-09-10 01:46:40.000000000 ");
+
+  clock.Advance_ns(500);
+  EXPECT_EQ(so::Time_utils::Unix_time_ns(), now + 500);
+  EXPECT_THROW(clock.Set_unix_ns(now), so::Invalid_argument);
+  EXPECT_THROW(clock.Advance_ns(-1), so::Invalid_argument);
+
+  // The real clocks are back once the clock is removed
+  so::Clock::Set_current(nullptr);
+  EXPECT_GT(so::Time_utils::Unix_time_ns(), now + 500);
+}
+
+// Rate limits follow the installed clock
+TEST_F(ClockTests, rateLimit)
+{
+  so::Virtual_clock clock(0);
+  clock.Advance_ns(5000000000LL);
+  so::Clock::Set_current(&clock);
+  so::Log_limiter limiter(so::Log_limiter::Rate, 1);
+  uint64_t suppressed = 0;
+  EXPECT_TRUE(limiter.Allow(suppressed));
+  EXPECT_FALSE(limiter.Allow(suppressed));
+  EXPECT_FALSE(limiter.Allow(suppressed));
+  clock.Advance_ns(1000000000);
+  EXPECT_TRUE(limiter.Allow(suppressed));
+  EXPECT_EQ(suppressed, 2u);
+}
+
+// A rate loop follows the installed clock without sleeping, and the cached
+// clock stands down while it is installed
+TEST_F(ClockTests, replayRateLoop)
+{
+  so::Time_utils::Start_cached_time(std::chrono::microseconds(100));
+  so::Virtual_clock clock(1000000000000000000LL);
+  so::Clock::Set_current(&clock);
+  EXPECT_EQ(so::Time_utils::Cached_unix_time_ns(), clock.Unix_ns());
+
+  int64_t real_start = so::Clock::Real_monotonic_ns();
+  so::Rate_loop loop(1.0);
+  loop.Start();
+  for(int i = 0; i < 3600; i++)
+  {
+    EXPECT_TRUE(loop.Wait());
+    clock.Advance_ns(1000000000);
+  }
+  EXPECT_EQ(loop.Get_jitter().Get_max(), 0);
+  EXPECT_EQ(so::Time_utils::Cached_unix_time_ns(), clock.Unix_ns());
+  so::Clock::Set_current(nullptr);
+  EXPECT_LT(so::Clock::Real_monotonic_ns() - real_start, 1000000000);
+  so::Time_utils::Stop_cached_time();
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <signal.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/flight_recorder.h>
+
+namespace
+{
+
+/**
+ * @brief Read every line of a file
+ */
+std::vector<std::string> read_lines(const std::string& filename)
+{
+  std::ifstream in(filename);
+  std::vector<std::string> lines;
+  std::string line;
+  while(std::getline(in, line))
+  {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+/**
+ * @brief Record numbered messages from the calling thread
+ */
+void record(so::Flight_recorder& recorder, const std::string& name, int n)
+{
+  for(int i = 0; i < n; i++)
+  {
+    std::string text = name + " " + std::to_string(i);
+    recorder.Record(text.data(), text.size());
+  }
+}
+
+// Each thread's newest messages survive and the oldest are overwritten, and
+// only whole lines are dumped
+TEST(FlightRecorderTests, keepsNewest)
+{
+  so::Flight_recorder recorder(4096);
+  record(recorder, "main", 1000);
+  std::thread a(record, std::ref(recorder), "a", 1000);
+  a.join();
+  std::thread b(record, std::ref(recorder), "b", 10);
+  b.join();
+
+  std::string filename = testing::TempDir() + "sno_flight_recorder.dump";
+  recorder.Dump(filename);
+  std::vector<std::string> lines = read_lines(filename);
+  std::remove(filename.c_str());
+
+  // Thread b reuses thread a's ring, so there are two rings
+  size_t headers = 0;
+  std::vector<std::string> messages;
+  for(const std::string& line : lines)
+  {
+    if(line.find("==== so::Flight_recorder thread") == 0)
+    {
+      headers++;
+      continue;
+    }
+    // 'YYYY-MM-DD HH:MM:SS.nnnnnnnnn '
+    ASSERT_GT(line.size(), 30u) << line;
+    ASSERT_EQ(line.find("20"), 0u) << line;
+    ASSERT_EQ(line[19], '.') << line;
+    ASSERT_EQ(line[29], ' ') << line;
+    messages.push_back(line.substr(30));
+  }
+  EXPECT_EQ(headers, 2u);
+  EXPECT_LT(messages.size(), 2010u);
+  EXPECT_NE(std::find(messages.begin(), messages.end(), "main 999"),
+            messages.end());
+  EXPECT_NE(std::find(messages.begin(), messages.end(), "b 9"),
+            messages.end());
+  EXPECT_NE(std::find(messages.begin(), messages.end(), "a 999"),
+            messages.end());
+  EXPECT_EQ(std::find(messages.begin(), messages.end(), "main 0"),
+            messages.end());
+}
+
+// Wide messages are stored as UTF-8, including characters outside the basic
+// multilingual plane
+TEST(FlightRecorderTests, wideMessages)
+{
+  so::Flight_recorder recorder(4096);
+  std::wstring text = L"wide \u00e9 \u20ac \U0001F600";
+  recorder.Record(text.data(), text.size());
+
+  std::string filename = testing::TempDir() + "sno_flight_recorder_wide.dump";
+  recorder.Dump(filename);
+  std::vector<std::string> lines = read_lines(filename);
+  std::remove(filename.c_str());
+  ASSERT_EQ(lines.size(), 2u);
+  ASSERT_GT(lines[1].size(), 30u) << lines[1];
+  EXPECT_EQ(lines[1].substr(30),
+            "wide \xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80");
+}
+
+// A fatal signal dumps the recorder before the process dies
+TEST(FlightRecorderTests, crashDump)
+{
+  std::string filename = testing::TempDir() + "sno_flight_recorder_crash.dump";
+  std::remove(filename.c_str());
+  ASSERT_DEATH(
+  {
+    so::Flight_recorder recorder(4096);
+    recorder.Install_crash_handler(filename);
+    record(recorder, "before crash", 3);
+    raise(SIGABRT);
+  }, "");
+
+  std::vector<std::string> lines = read_lines(filename);
+  std::remove(filename.c_str());
+  ASSERT_EQ(lines.size(), 4u);
+  EXPECT_NE(lines[3].find(" before crash 2"), std::string::npos) << lines[3];
+}
+
+}
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include <sno/geodetic.h>
+
+namespace
+{
+
+// LLA -> ECEF -> LLA should return the original coordinates
+TEST(GeodeticTests, llaEcefRoundTrip)
+{
+  Eigen::Matrix3Xd lla(3, 4);
+  lla << 0, 45.5, -33.9, 89.9,
+         0, -122.7, 151.2, 10,
+         0, 120, -20, 5000;
+  Eigen::Matrix3Xd ecef = so::Geodetic::lla_2_ecef(lla);
+  EXPECT_NEAR(ecef(0, 0), so::Geodetic::WGS84_A, 1e-6);
+
+  Eigen::Matrix3Xd back = so::Geodetic::ecef_2_lla(ecef);
+  for(Eigen::Index i = 0; i < lla.cols(); i++)
+  {
+    Eigen::Vector3d single = so::Geodetic::ecef_2_lla(
+          so::Geodetic::lla_2_ecef(Eigen::Vector3d(lla.col(i))));
+    EXPECT_NEAR(back(0, i), lla(0, i), 1e-9);
+    EXPECT_NEAR(back(1, i), lla(1, i), 1e-9);
+    EXPECT_NEAR(back(2, i), lla(2, i), 1e-4);
+    EXPECT_TRUE(single.isApprox(Eigen::Vector3d(back.col(i)), 1e-12));
+  }
+}
+
+// Points offset along the local axes should map to the expected NED/ENU
+TEST(GeodeticTests, localFrame)
+{
+  so::Geodetic::Local_frame frame(Eigen::Vector3d(45, 7, 100));
+  Eigen::Vector3d ned(100, -50, 10);
+  Eigen::Vector3d ecef = frame.Ned_2_ecef(ned);
+
+  EXPECT_TRUE(frame.Ecef_2_ned(ecef).isApprox(ned, 1e-9));
+  EXPECT_TRUE(frame.Ecef_2_enu(ecef).isApprox(Eigen::Vector3d(-50, 100, -10),
+                                              1e-9));
+  EXPECT_TRUE(frame.Lla_2_ned(frame.Ned_2_lla(ned)).isApprox(ned, 1e-6));
+  EXPECT_NEAR(frame.Ned_2_lla(Eigen::Vector3d(0, 0, 0))(2), 100, 1e-6);
+}
+
+}
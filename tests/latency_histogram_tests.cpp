@@ -0,0 +1,120 @@
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/fast_stopwatch.h>
+#include <sno/latency_histogram.h>
+#include <sno/so_exception.h>
+#include <sno/stopwatch.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Percentiles of a uniform distribution are within the requested precision
+TEST(LatencyHistogramTests, percentiles)
+{
+  so::Latency_histogram histogram(10000000000LL, 3);
+  EXPECT_EQ(histogram.Get_count(), 0u);
+  EXPECT_EQ(histogram.Get_percentile(99.0), 0);
+
+  for(int64_t ns = 1; ns <= 1000000; ns++)
+  {
+    histogram.Record(ns * 1000);
+  }
+  EXPECT_EQ(histogram.Get_count(), 1000000u);
+  EXPECT_EQ(histogram.Get_min(), 1000);
+  EXPECT_EQ(histogram.Get_max(), 1000000000);
+  EXPECT_NEAR(histogram.Get_percentile(50.0), 500000000, 500000);
+  EXPECT_NEAR(histogram.Get_percentile(99.0), 990000000, 990000);
+  EXPECT_NEAR(histogram.Get_percentile(99.9), 999000000, 999000);
+  EXPECT_EQ(histogram.Get_percentile(100.0), 1000000000);
+  EXPECT_EQ(histogram.Get_percentile(0.0), 1000);
+  EXPECT_NEAR(histogram.Get_mean(), 500000500.0, 500000.0);
+
+  // Small values are exact
+  so::Latency_histogram small;
+  small.Record(0);
+  small.Record(7, 3);
+  EXPECT_EQ(small.Get_count(), 4u);
+  EXPECT_EQ(small.Get_percentile(25.0), 0);
+  EXPECT_EQ(small.Get_percentile(26.0), 7);
+
+  // Values out of range are counted at the top of the range
+  small.Record(-5);
+  small.Record(small.Get_max_trackable() * 2);
+  EXPECT_EQ(small.Get_count(), 6u);
+  EXPECT_EQ(small.Get_min(), 0);
+  EXPECT_EQ(small.Get_max(), small.Get_max_trackable() * 2);
+
+  small.Reset();
+  EXPECT_EQ(small.Get_count(), 0u);
+  EXPECT_EQ(small.Get_max(), 0);
+
+  EXPECT_THROW(so::Latency_histogram(1), so::Invalid_argument);
+  EXPECT_THROW(so::Latency_histogram(1000, 6), so::Invalid_argument);
+}
+
+// Threads recording into one histogram lose no counts, and per-thread
+// histograms merge into the same result
+TEST(LatencyHistogramTests, concurrentAndMerge)
+{
+  const int THREADS = 4;
+  const int64_t PER_THREAD = 100000;
+  so::Latency_histogram shared;
+  std::vector<std::unique_ptr<so::Latency_histogram> > own;
+  std::vector<std::thread> threads;
+  for(int t = 0; t < THREADS; t++)
+  {
+    own.emplace_back(new so::Latency_histogram());
+    so::Latency_histogram& mine = *own.back();
+    threads.emplace_back([&shared, &mine, t]()
+                         {
+                           for(int64_t i = 0; i < PER_THREAD; i++)
+                           {
+                             shared.Record(i + t);
+                             mine.Record(i + t);
+                           }
+                         });
+  }
+  for(std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  so::Latency_histogram merged;
+  for(const std::unique_ptr<so::Latency_histogram>& histogram : own)
+  {
+    merged.Merge(*histogram);
+  }
+  EXPECT_EQ(shared.Get_count(), static_cast<uint64_t>(THREADS * PER_THREAD));
+  EXPECT_EQ(merged.Get_count(), shared.Get_count());
+  EXPECT_EQ(merged.Get_min(), 0);
+  EXPECT_EQ(merged.Get_max(), PER_THREAD - 1 + THREADS - 1);
+  for(double p : {50.0, 99.0, 99.9})
+  {
+    EXPECT_EQ(merged.Get_percentile(p), shared.Get_percentile(p));
+  }
+
+  so::Latency_histogram other(1000000, 2);
+  EXPECT_THROW(merged.Merge(other), so::Invalid_argument);
+}
+
+// Stopwatch splits can be recorded directly
+TEST(LatencyHistogramTests, stopwatchSplits)
+{
+  so::Latency_histogram histogram;
+  so::Stopwatch sw;
+  so::Fast_tsc_stopwatch fast;
+  EXPECT_EQ(sw.Split_ns(histogram), 0);
+  EXPECT_EQ(fast.Split_ns(histogram), 0);
+  EXPECT_EQ(histogram.Get_count(), 0u);
+
+  sw.Start();
+  fast.Start();
+  int64_t largest = 0;
+  for(int i = 0; i < 100; i++)
+  {
+    largest = std::max(largest, sw.Split_ns(histogram));
+    largest = std::max(largest, fast.Split_ns(histogram));
+  }
+  EXPECT_EQ(histogram.Get_count(), 200u);
+  EXPECT_EQ(histogram.Get_max(), largest);
+}
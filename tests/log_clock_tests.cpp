@@ -0,0 +1,52 @@
+#include <string>
+#include <gtest/gtest.h>
+#include <sno/log_clock.h>
+
+namespace
+{
+
+using so::Log_clock;
+
+/**
+ * @brief Format a reading as a string
+ */
+std::string format(const Log_clock::Source source, const int64_t ns)
+{
+  char text[Log_clock::MAX_TEXT];
+  size_t len = Log_clock::Format(source, ns, text);
+  return std::string(text, len);
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Wall clock readings are dates in UTC, monotonic ones plain seconds, and the
+// cached second is replaced when the second or the kind of clock changes
+TEST(LogClockTests, format)
+{
+  EXPECT_EQ(format(Log_clock::Wall, 1700000000123456789),
+            "2023-11-14 22:13:20.123456789 ");
+  EXPECT_EQ(format(Log_clock::Wall_coarse, 1700000000000000007),
+            "2023-11-14 22:13:20.000000007 ");
+  EXPECT_EQ(format(Log_clock::Wall, 1700000001999999999),
+            "2023-11-14 22:13:21.999999999 ");
+  EXPECT_EQ(format(Log_clock::Monotonic, 1700000001000000000),
+            "1700000001.000000000 ");
+  EXPECT_EQ(format(Log_clock::Monotonic_coarse, 12000000005),
+            "12.000000005 ");
+  EXPECT_EQ(format(Log_clock::Wall, -1), "1969-12-31 23:59:59.999999999 ");
+}
+
+// Every clock moves forward
+TEST(LogClockTests, now)
+{
+  for(Log_clock::Source source : {Log_clock::Wall, Log_clock::Wall_coarse,
+                                  Log_clock::Monotonic, Log_clock::Monotonic_coarse})
+  {
+    int64_t first = Log_clock::Now(source);
+    EXPECT_GT(first, 0);
+    EXPECT_GE(Log_clock::Now(source), first);
+  }
+  EXPECT_GT(Log_clock::Now(Log_clock::Wall), 1600000000000000000);
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/log_limiter.h>
+
+namespace
+{
+
+using so::Log_limiter;
+
+/**
+ * @brief Offer a number of messages to a limiter
+ * @return Indices of the messages let through
+ */
+std::vector<int> offer(Log_limiter& limiter, int n)
+{
+  std::vector<int> allowed;
+  for(int i = 0; i < n; i++)
+  {
+    uint64_t suppressed = 0;
+    if(limiter.Allow(suppressed))
+    {
+      allowed.push_back(i);
+    }
+  }
+  return allowed;
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+// One message in n gets through, starting with the first, and each one
+// carries the count held back before it
+TEST(LogLimiterTests, everyN)
+{
+  Log_limiter limiter(Log_limiter::Every_n, 3);
+  EXPECT_EQ(offer(limiter, 10), std::vector<int>({0, 3, 6, 9}));
+
+  uint64_t suppressed = 0;
+  EXPECT_FALSE(limiter.Allow(suppressed));
+  EXPECT_FALSE(limiter.Allow(suppressed));
+  EXPECT_TRUE(limiter.Allow(suppressed));
+  EXPECT_EQ(suppressed, 2u);
+}
+
+// The first n messages get through, then one in m
+TEST(LogLimiterTests, firstN)
+{
+  Log_limiter limiter(Log_limiter::First_n, 3, 4);
+  EXPECT_EQ(offer(limiter, 16), std::vector<int>({0, 1, 2, 6, 10, 14}));
+
+  Log_limiter none(Log_limiter::First_n, 0, 5);
+  EXPECT_EQ(offer(none, 10), std::vector<int>({4, 9}));
+}
+
+// A burst gets through at once, after which messages get through at the rate
+TEST(LogLimiterTests, rate)
+{
+  Log_limiter limiter(Log_limiter::Rate, 20, 5);
+  EXPECT_EQ(offer(limiter, 100).size(), 5u);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(120));
+  uint64_t suppressed = 0;
+  EXPECT_TRUE(limiter.Allow(suppressed));
+  EXPECT_EQ(suppressed, 95u);
+  EXPECT_LT(offer(limiter, 100).size(), 5u);
+}
+
+// No message is lost or counted twice when many threads share a limiter
+TEST(LogLimiterTests, concurrentCounts)
+{
+  Log_limiter limiter(Log_limiter::Every_n, 7);
+  const int threads = 4;
+  const int per_thread = 100000;
+  std::vector<uint64_t> allowed(threads, 0);
+  std::vector<uint64_t> reported(threads, 0);
+  std::vector<std::thread> workers;
+  for(int t = 0; t < threads; t++)
+  {
+    workers.emplace_back([&, t]()
+    {
+      for(int i = 0; i < per_thread; i++)
+      {
+        uint64_t suppressed = 0;
+        if(limiter.Allow(suppressed))
+        {
+          allowed[t]++;
+          reported[t] += suppressed;
+        }
+      }
+    });
+  }
+  for(std::thread& worker : workers)
+  {
+    worker.join();
+  }
+
+  uint64_t total_allowed = 0;
+  uint64_t total_reported = 0;
+  for(int t = 0; t < threads; t++)
+  {
+    total_allowed += allowed[t];
+    total_reported += reported[t];
+  }
+  uint64_t total = threads * per_thread;
+  EXPECT_EQ(total_allowed, (total + 6) / 7);
+
+  // Messages held back after the last one let through are still pending
+  uint64_t suppressed = 0;
+  uint64_t extra = 0;
+  while(!limiter.Allow(suppressed))
+  {
+    extra++;
+  }
+  EXPECT_EQ(total_reported + suppressed, total - total_allowed + extra);
+}
+
+// Threads let through at the same moment by the rate limiter share out the
+// messages held back between them, with none lost or counted twice
+TEST(LogLimiterTests, concurrentRate)
+{
+  Log_limiter limiter(Log_limiter::Rate, 100000, 4);
+  const int threads = 4;
+  const int per_thread = 200000;
+  std::vector<uint64_t> held_back(threads, 0);
+  std::vector<uint64_t> reported(threads, 0);
+  std::vector<uint64_t> largest(threads, 0);
+  std::vector<std::thread> workers;
+  for(int t = 0; t < threads; t++)
+  {
+    workers.emplace_back([&, t]()
+    {
+      for(int i = 0; i < per_thread; i++)
+      {
+        uint64_t suppressed = 0;
+        if(limiter.Allow(suppressed))
+        {
+          reported[t] += suppressed;
+          largest[t] = std::max(largest[t], suppressed);
+        }
+        else
+        {
+          held_back[t]++;
+        }
+      }
+    });
+  }
+  for(std::thread& worker : workers)
+  {
+    worker.join();
+  }
+
+  uint64_t total_held_back = 0;
+  uint64_t total_reported = 0;
+  for(int t = 0; t < threads; t++)
+  {
+    total_held_back += held_back[t];
+    total_reported += reported[t];
+  }
+
+  // Messages held back after the last one let through are still pending
+  uint64_t suppressed = 0;
+  while(!limiter.Allow(suppressed))
+  {
+    total_held_back++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(total_reported + suppressed, total_held_back);
+  for(int t = 0; t < threads; t++)
+  {
+    EXPECT_LE(largest[t], total_held_back);
+  }
+}
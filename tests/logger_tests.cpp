@@ -0,0 +1,538 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/logger.h>
+
+namespace
+{
+
+using so::Logger;
+
+/**
+ * @brief Read every line of a file
+ */
+std::vector<std::string> read_lines(const std::string& filename)
+{
+  std::ifstream in(filename);
+  std::vector<std::string> lines;
+  std::string line;
+  while(std::getline(in, line))
+  {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+/**
+ * @brief Send the log to a fresh temporary file and restore the defaults
+ * afterwards
+ */
+class LoggerTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_filename = testing::TempDir() + "sno_logger_test.log";
+    std::remove(m_filename.c_str());
+    Logger::Set_log_file(m_filename);
+    Logger::Set_logging_level(Logger::Debug);
+  }
+
+  void TearDown() override
+  {
+    Logger::Stop_async();
+    Logger::Remove_all_sinks();
+    Logger::Set_flight_recorder(nullptr);
+    Logger::Set_timestamp(false);
+    Logger::Set_flush_policy(Logger::Flush_always);
+    Logger::Set_logging_level(Logger::Debug);
+    std::remove(m_filename.c_str());
+  }
+
+  std::string m_filename;
+};
+
+// Messages are written one per line, with the prefix, and masked levels are
+// not written at all
+TEST_F(LoggerTests, syncWrite)
+{
+  Log_msg(Logger::Warning) << "value " << 42;
+  Logger::Set_logging_level(Logger::Warning);
+  Log_msg(Logger::Debug_3) << "hidden";
+  Logger::Flush();
+
+  std::vector<std::string> lines = read_lines(m_filename);
+  ASSERT_EQ(lines.size(), 1u);
+  EXPECT_EQ(lines[0].find("WARNING--["), 0u) << lines[0];
+  EXPECT_NE(lines[0].find("LoggerTests_syncWrite_Test::TestBody] value 42"),
+            std::string::npos) << lines[0];
+}
+
+// Arguments of a disabled statement are never evaluated
+TEST_F(LoggerTests, disabledLevelSkipsArguments)
+{
+  int evaluated = 0;
+  auto count = [&evaluated]() { return ++evaluated; };
+  Logger::Set_logging_level(Logger::Info);
+  Log_msg(Logger::Debug_0) << count();
+  EXPECT_EQ(evaluated, 0);
+  EXPECT_FALSE(Logger::Is_enabled(Logger::Debug_0));
+
+  Log_msg(Logger::Info) << count();
+  EXPECT_EQ(evaluated, 1);
+
+  // Statements nest correctly inside unbraced if/else
+  if(evaluated == 0)
+    Log_msg(Logger::Info) << count();
+  else
+    evaluated = 10;
+  EXPECT_EQ(evaluated, 10);
+}
+
+// Timestamps start the prefix when enabled
+TEST_F(LoggerTests, timestamp)
+{
+  Logger::Set_timestamp(true);
+  Log_msg(Logger::Info) << "wall";
+  Logger::Set_timestamp(true, so::Log_clock::Monotonic_coarse);
+  Log_msg(Logger::Info) << "monotonic";
+  Logger::Set_timestamp(false);
+  Log_msg(Logger::Info) << "none";
+
+  std::vector<std::string> lines = read_lines(m_filename);
+  ASSERT_EQ(lines.size(), 3u);
+  // 'YYYY-MM-DD HH:MM:SS.nnnnnnnnn INFO--'
+  EXPECT_EQ(lines[0].find("20"), 0u) << lines[0];
+  EXPECT_EQ(lines[0].find(" INFO--["), 29u) << lines[0];
+  // 'seconds.nnnnnnnnn INFO--'
+  size_t dot = lines[1].find('.');
+  ASSERT_NE(dot, std::string::npos);
+  EXPECT_EQ(lines[1].find_first_not_of("0123456789"), dot) << lines[1];
+  EXPECT_EQ(lines[1].find(" INFO--["), dot + 10) << lines[1];
+  EXPECT_EQ(lines[2].find("INFO--["), 0u) << lines[2];
+}
+
+// Buffered messages only reach the file when the flush policy says so
+TEST_F(LoggerTests, flushPolicy)
+{
+  Logger::Set_flush_policy(Logger::Flush_every_n, 10);
+  for(int i = 0; i < 9; i++)
+  {
+    Log_msg(Logger::Info) << i;
+  }
+  EXPECT_TRUE(read_lines(m_filename).empty());
+  Log_msg(Logger::Info) << 9;
+  EXPECT_EQ(read_lines(m_filename).size(), 10u);
+
+  Logger::Set_flush_policy(Logger::Flush_on_severity);
+  Log_msg(Logger::Info) << "buffered";
+  EXPECT_EQ(read_lines(m_filename).size(), 10u);
+  Log_msg(Logger::Warning) << "flushes";
+  EXPECT_EQ(read_lines(m_filename).size(), 12u);
+
+  Logger::Set_flush_policy(Logger::Flush_explicit);
+  Log_msg(Logger::Fatal) << "buffered";
+  EXPECT_EQ(read_lines(m_filename).size(), 12u);
+  Logger::Flush();
+  EXPECT_EQ(read_lines(m_filename).size(), 13u);
+}
+
+// Each stream counts its own messages, and the interval policy flushes the
+// last messages of a burst without waiting for another message
+TEST_F(LoggerTests, flushPerStream)
+{
+  // Alternate files stay open, so each run needs a file of its own
+  static int run = 0;
+  std::string other = m_filename + ".stream" + std::to_string(run++);
+  std::remove(other.c_str());
+  Logger::Set_flush_policy(Logger::Flush_every_n, 2);
+  Log_msg(Logger::Info) << "main";
+  Log_msg(Logger::Info, other) << "other";
+  EXPECT_TRUE(read_lines(m_filename).empty());
+  EXPECT_TRUE(read_lines(other).empty());
+  Log_msg(Logger::Info, other) << "other";
+  EXPECT_EQ(read_lines(other).size(), 2u);
+  EXPECT_TRUE(read_lines(m_filename).empty());
+
+  Logger::Set_flush_policy(Logger::Flush_interval, 64,
+                           std::chrono::milliseconds(10));
+  Log_msg(Logger::Info) << "tail";
+  for(int i = 0; i < 500 && read_lines(m_filename).size() < 2; i++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_EQ(read_lines(m_filename).size(), 2u);
+  std::remove(other.c_str());
+}
+
+// The rotating file keeps the newest segments, and lines are never split
+// between segments
+TEST_F(LoggerTests, rotatingFile)
+{
+  std::string path = m_filename + ".seg";
+  Logger::Set_rotating_log_file(path, 4096, 2);
+  for(int i = 0; i < 1000; i++)
+  {
+    Log_msg(Logger::Info) << "line " << i;
+  }
+  Logger::Set_log_file(m_filename);
+
+  std::vector<std::string> lines;
+  size_t num_segments = 0;
+  for(int s = 0; s < 100; s++)
+  {
+    std::string segment = path + "." + std::to_string(s);
+    if(!std::ifstream(segment))
+    {
+      continue;
+    }
+    num_segments++;
+    std::vector<std::string> segment_lines = read_lines(segment);
+    lines.insert(lines.end(), segment_lines.begin(), segment_lines.end());
+    std::remove(segment.c_str());
+  }
+  EXPECT_EQ(num_segments, 3u);
+  ASSERT_FALSE(lines.empty());
+  ASSERT_LT(lines.size(), 1000u);
+  int first = 1000 - static_cast<int>(lines.size());
+  for(size_t i = 0; i < lines.size(); i++)
+  {
+    std::string expected = "] line " + std::to_string(first + i);
+    ASSERT_EQ(lines[i].find("INFO--["), 0u) << lines[i];
+    ASSERT_EQ(lines[i].substr(lines[i].size() - expected.size()), expected);
+  }
+}
+
+// A rotating file that cannot create its next segment drops lines instead of
+// failing, and carries on once segments can be created again
+TEST_F(LoggerTests, rotatingFileRecovers)
+{
+  std::string dir = m_filename + ".dir";
+  std::string path = dir + "/seg";
+  auto remove_segments = [&]()
+  {
+    for(int s = 0; s < 100; s++)
+    {
+      std::remove((path + "." + std::to_string(s)).c_str());
+    }
+  };
+  // Clear whatever an interrupted run left behind
+  remove_segments();
+  rmdir(dir.c_str());
+  ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+  {
+    so::Mmap_log_stream<char> out(path, 4096, 100);
+    out << "first\n";
+    // Segment .1 is already prepared, so the second switch is the one that
+    // fails
+    remove_segments();
+    ASSERT_EQ(rmdir(dir.c_str()), 0);
+    for(int i = 0; i < 1000; i++)
+    {
+      out << "lost line " << i << "\n";
+    }
+    EXPECT_TRUE(out.good());
+    ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+    for(int i = 0; i < 1000; i++)
+    {
+      out << "kept line " << i << "\n";
+    }
+    EXPECT_TRUE(out.good());
+  }
+
+  std::vector<std::string> lines;
+  for(int s = 0; s < 100; s++)
+  {
+    std::vector<std::string> segment_lines =
+        read_lines(path + "." + std::to_string(s));
+    lines.insert(lines.end(), segment_lines.begin(), segment_lines.end());
+  }
+  remove_segments();
+  rmdir(dir.c_str());
+  ASSERT_FALSE(lines.empty());
+  EXPECT_EQ(lines[0].find("["), 0u) << lines[0];
+  EXPECT_NE(lines[0].find(" characters dropped: "), std::string::npos)
+      << lines[0];
+  EXPECT_EQ(lines.back(), "kept line 999");
+}
+
+// Each sink gets the messages its own mask accepts, and nothing goes to the
+// main output while sinks are registered
+TEST_F(LoggerTests, sinks)
+{
+  auto ring = std::make_shared<so::Ring_sink<char> >(2);
+  std::vector<std::string> received;
+  auto callback = std::make_shared<so::Callback_sink<char> >(
+        [&received](const so::Log_record<char>& record)
+        {
+          received.push_back(record.text);
+        },
+        Logger::Warning);
+  Logger::Add_sink(ring);
+  Logger::Add_sink(callback);
+
+  Log_msg(Logger::Info) << "first";
+  Log_msg(Logger::Info) << "second";
+  Log_msg(Logger::Warning) << "third";
+  Logger::Flush();
+
+  std::vector<std::string> records = ring->Get_records();
+  ASSERT_EQ(records.size(), 2u);
+  EXPECT_NE(records[0].find("] second"), std::string::npos) << records[0];
+  EXPECT_NE(records[1].find("] third"), std::string::npos) << records[1];
+  ASSERT_EQ(received.size(), 1u);
+  EXPECT_NE(received[0].find("WARNING--["), std::string::npos) << received[0];
+
+  Logger::Remove_sink(ring);
+  Logger::Remove_sink(callback);
+  Log_msg(Logger::Info) << "main";
+  Logger::Flush();
+  EXPECT_EQ(ring->Get_records().size(), 2u);
+  EXPECT_EQ(received.size(), 1u);
+  EXPECT_EQ(read_lines(m_filename).size(), 1u);
+}
+
+// Messages for an alternate file all arrive, through one cached handle
+TEST_F(LoggerTests, alternateFile)
+{
+  std::string other = m_filename + ".other";
+  std::remove(other.c_str());
+  for(int i = 0; i < 3; i++)
+  {
+    Log_msg(Logger::Info, other) << "line " << i;
+  }
+  Logger::Flush();
+  std::vector<std::string> lines = read_lines(other);
+  std::remove(other.c_str());
+  ASSERT_EQ(lines.size(), 3u);
+  EXPECT_NE(lines[2].find("] line 2"), std::string::npos) << lines[2];
+  EXPECT_TRUE(read_lines(m_filename).empty());
+}
+
+// The flight recorder keeps Debug messages that are not written out
+TEST_F(LoggerTests, flightRecorder)
+{
+  auto recorder = std::make_shared<so::Flight_recorder>(4096);
+  Logger::Set_logging_level(Logger::Warning);
+  Logger::Set_flight_recorder(recorder, Logger::Debug);
+  EXPECT_TRUE(Logger::Is_enabled(Logger::Debug_7));
+  Log_msg(Logger::Debug_7) << "recorded " << 1;
+  Log_msg(Logger::Warning) << "written " << 2;
+  Logger::Flush();
+
+  std::vector<std::string> written = read_lines(m_filename);
+  ASSERT_EQ(written.size(), 1u);
+  EXPECT_NE(written[0].find("] written 2"), std::string::npos) << written[0];
+
+  std::string dump = m_filename + ".dump";
+  recorder->Dump(dump);
+  std::vector<std::string> recorded = read_lines(dump);
+  std::remove(dump.c_str());
+  ASSERT_EQ(recorded.size(), 3u);
+  EXPECT_NE(recorded[1].find(" DEBUG--["), std::string::npos) << recorded[1];
+  EXPECT_NE(recorded[1].find("] recorded 1"), std::string::npos);
+  EXPECT_NE(recorded[2].find("] written 2"), std::string::npos);
+
+  Logger::Set_flight_recorder(nullptr);
+  EXPECT_FALSE(Logger::Is_enabled(Logger::Debug_7));
+}
+
+// Limited statements hold back messages without evaluating their arguments,
+// and the next message through says how many were held back
+TEST_F(LoggerTests, rateLimited)
+{
+  int evaluated = 0;
+  auto count = [&evaluated]() { return ++evaluated; };
+  for(int i = 0; i < 10; i++)
+  {
+    Log_msg_every_n(4, Logger::Warning) << "every " << count();
+  }
+  EXPECT_EQ(evaluated, 3);
+  for(int i = 0; i < 10; i++)
+  {
+    Log_msg_first_n(2, 5, Logger::Info) << "first " << i;
+    Log_msg_rate(1, 1, Logger::Info) << "rate " << i;
+  }
+
+  // Statements nest correctly inside unbraced if/else
+  if(evaluated == 0)
+    Log_msg_every_n(1, Logger::Info) << count();
+  else
+    evaluated = 10;
+  EXPECT_EQ(evaluated, 10);
+  Logger::Flush();
+
+  std::vector<std::string> lines = read_lines(m_filename);
+  ASSERT_EQ(lines.size(), 7u);
+  EXPECT_NE(lines[0].find("] every 1"), std::string::npos) << lines[0];
+  EXPECT_NE(lines[1].find("] [3 suppressed] every 2"), std::string::npos)
+      << lines[1];
+  EXPECT_NE(lines[3].find("] first 0"), std::string::npos) << lines[3];
+  EXPECT_NE(lines[4].find("] rate 0"), std::string::npos) << lines[4];
+  EXPECT_NE(lines[5].find("] first 1"), std::string::npos) << lines[5];
+  EXPECT_NE(lines[6].find("] [4 suppressed] first 6"), std::string::npos)
+      << lines[6];
+}
+
+// The summary reports a flood that has stopped, once
+TEST_F(LoggerTests, limiterSummary)
+{
+  int line = 0;
+  for(int i = 0; i < 10; i++)
+  {
+    line = __LINE__; Log_msg_every_n(10, Logger::Info) << "flood " << i;
+  }
+  Logger::Set_limiter_summary(std::chrono::milliseconds(5), Logger::Info);
+  std::string site = "logger_tests.cpp:" + std::to_string(line) + " 9";
+  std::vector<std::string> lines;
+  for(int i = 0; i < 500 && lines.size() < 2; i++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    lines = read_lines(m_filename);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  Logger::Set_limiter_summary(std::chrono::milliseconds(0));
+  lines = read_lines(m_filename);
+  ASSERT_EQ(lines.size(), 2u);
+  EXPECT_NE(lines[1].find("] Suppressed messages: "), std::string::npos)
+      << lines[1];
+  EXPECT_NE(lines[1].find(site), std::string::npos) << lines[1];
+}
+
+// Every message from every thread is written when the writer is stopped
+TEST_F(LoggerTests, asyncWriteAllThreads)
+{
+  Logger::Start_async(64);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; t++)
+  {
+    threads.emplace_back([t]()
+    {
+      for(int i = 0; i < 500; i++)
+      {
+        Log_msg(Logger::Info) << "thread " << t << " message " << i;
+      }
+    });
+  }
+  for(std::thread& t : threads)
+  {
+    t.join();
+  }
+  Logger::Stop_async();
+
+  EXPECT_EQ(read_lines(m_filename).size(), 2000u);
+}
+
+// With the drop policy a full queue discards messages and reports how many
+TEST_F(LoggerTests, asyncDrop)
+{
+  Logger::Start_async(2, so::Log_writer<char>::Drop);
+  for(int i = 0; i < 1000; i++)
+  {
+    Log_msg(Logger::Info) << i;
+  }
+  uint64_t dropped = Logger::Get_dropped_count();
+  Logger::Stop_async();
+
+  std::vector<std::string> lines = read_lines(m_filename);
+  EXPECT_GE(lines.size(), 1000 - dropped);
+  if(dropped > 0)
+  {
+    EXPECT_NE(lines.back().find("dropped"), std::string::npos);
+  }
+}
+
+// A binary log decodes to the same text the logger would have written, with
+// the messages of all threads in timestamp order
+TEST_F(LoggerTests, binaryRoundTrip)
+{
+  std::string binary = m_filename + ".bin";
+  Logger::Set_binary_file(binary, 256);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 2; t++)
+  {
+    threads.emplace_back([t]()
+    {
+      for(int i = 0; i < 200; i++)
+      {
+        Log_msg(Logger::Info) << "thread " << t << " message " << i;
+      }
+    });
+  }
+  for(std::thread& t : threads)
+  {
+    t.join();
+  }
+  Log_msg(Logger::Severe) << 'c' << ' ' << 1.5 << ' ' << -7L << ' ' << 3u
+                          << ' ' << std::string("str") << ' ' << true;
+  Logger("Scope::function(int)", Logger::Info) << "explicit scope";
+  Log_wmsg(so::WLogger::Info) << L"wide " << 2;
+  Logger::Close_binary_file();
+
+  std::ifstream in(binary, std::ios_base::binary);
+  std::stringstream text;
+  so::Binary_log::Decode(in, text);
+  std::remove(binary.c_str());
+
+  std::vector<std::string> lines;
+  std::string line;
+  while(std::getline(text, line))
+  {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(lines.size(), 403u);
+  EXPECT_TRUE(read_lines(m_filename).empty());
+  for(size_t i = 0; i < 400; i++)
+  {
+    EXPECT_NE(lines[i].find(" INFO--["), std::string::npos) << lines[i];
+    EXPECT_NE(lines[i].find("] thread "),
+              std::string::npos) << lines[i];
+  }
+  EXPECT_NE(lines[400].find(" SEVERE--["), std::string::npos) << lines[400];
+  EXPECT_NE(lines[400].find(
+              "LoggerTests_binaryRoundTrip_Test::TestBody] c 1.5 -7 3 str 1"),
+            std::string::npos) << lines[400];
+  EXPECT_NE(lines[401].find("INFO--[Scope::function] explicit scope"),
+            std::string::npos) << lines[401];
+  EXPECT_NE(lines[402].find("] wide 2"), std::string::npos) << lines[402];
+
+  // A record committed after the file is closed is counted as dropped
+  uint64_t dropped = so::Binary_log::Get_dropped();
+  std::vector<char> record;
+  so::Binary_log::Begin_message(record, 0, Logger::Info, 0);
+  so::Binary_log::Commit(record);
+  EXPECT_EQ(so::Binary_log::Get_dropped(), dropped + 1);
+}
+
+// Registered sinks still receive messages written to the binary log
+TEST_F(LoggerTests, binarySinks)
+{
+  std::string binary = m_filename + ".bin";
+  auto ring = std::make_shared<so::Ring_sink<char> >(4);
+  Logger::Add_sink(ring);
+  Logger::Set_binary_file(binary, 256);
+  Log_msg(Logger::Info) << "to both " << 1;
+  Logger::Flush();
+  Logger::Close_binary_file();
+
+  std::ifstream in(binary, std::ios_base::binary);
+  std::stringstream text;
+  so::Binary_log::Decode(in, text);
+  std::remove(binary.c_str());
+
+  EXPECT_NE(text.str().find("] to both 1"), std::string::npos) << text.str();
+  std::vector<std::string> records = ring->Get_records();
+  ASSERT_EQ(records.size(), 1u);
+  EXPECT_NE(records[0].find("INFO--["), std::string::npos) << records[0];
+  EXPECT_NE(records[0].find("] to both 1"), std::string::npos) << records[0];
+  EXPECT_TRUE(read_lines(m_filename).empty());
+}
+
+}
@@ -0,0 +1,82 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/perf_counters.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+const so::Perf_scope_stats* find(const std::vector<so::Perf_scope_stats>& stats,
+                                 const std::string& name)
+{
+  for(const so::Perf_scope_stats& s : stats)
+  {
+    if(s.name == name)
+    {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Scopes record their time on any system; counters are either unavailable
+// or count the work done
+TEST(PerfCountersTests, scopes)
+{
+  so::Perf_counters::Clear();
+  std::vector<char> memory;
+  for(int i = 0; i < 3; i++)
+  {
+    so::Perf_scope scope("touch");
+    memory.assign(4 << 20, static_cast<char>(i));
+    EXPECT_GE(scope.Get_values().elapsed_ns, 0);
+  }
+  std::thread([]()
+              {
+                so::Perf_scope scope("touch");
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+              }).join();
+
+  std::vector<so::Perf_scope_stats> stats = so::Perf_counters::Get_stats();
+  const so::Perf_scope_stats* touch = find(stats, "touch");
+  ASSERT_NE(touch, nullptr);
+  EXPECT_EQ(touch->count, 4u);
+  EXPECT_GE(touch->totals.elapsed_ns, 2000000);
+  for(size_t i = 0; i < so::Perf_values::NUM_EVENTS; i++)
+  {
+    so::Perf_values::Event event = static_cast<so::Perf_values::Event>(i);
+    if(so::Perf_counters::Is_available(event))
+    {
+      EXPECT_GE(touch->totals.counts[i], 0) << so::Perf_counters::Get_event_name(event);
+    }
+    else
+    {
+      EXPECT_EQ(touch->totals.counts[i], -1) << so::Perf_counters::Get_event_name(event);
+    }
+  }
+  if(so::Perf_counters::Is_available(so::Perf_values::Instructions))
+  {
+    EXPECT_GT(touch->totals.counts[so::Perf_values::Instructions], 1000000);
+  }
+  // The sleeping thread switched out at least once
+  if(so::Perf_counters::Is_available(so::Perf_values::Context_switches))
+  {
+    EXPECT_GE(touch->totals.counts[so::Perf_values::Context_switches], 1);
+  }
+
+  std::ostringstream report;
+  so::Perf_counters::Write_report(report);
+  EXPECT_NE(report.str().find("touch"), std::string::npos);
+  EXPECT_NE(report.str().find("page-faults"), std::string::npos);
+
+  so::Perf_counters::Clear();
+  EXPECT_EQ(find(so::Perf_counters::Get_stats(), "touch"), nullptr);
+}
@@ -0,0 +1,155 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/profiler.h>
+
+namespace
+{
+
+/**
+ * @brief Find the statistics of a zone
+ */
+const so::Profile_stats* find(const std::vector<so::Profile_stats>& stats,
+                              const std::string& name)
+{
+  for(const so::Profile_stats& s : stats)
+  {
+    if(s.name == name)
+    {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Spin for about a number of microseconds
+ */
+void busy_wait_us(const int us)
+{
+  int64_t end = so::Tsc_clock::Now() + static_cast<int64_t>(
+        so::Tsc_clock::Get_ticks_per_second() * us * 1e-6);
+  while(so::Tsc_clock::Now() < end)
+  {
+  }
+}
+
+/**
+ * @brief Clear the profiler before each test
+ */
+class ProfilerTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    so::Profiler::Clear();
+  }
+};
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Statistics are aggregated by name over every thread, and nested zones are
+// contained in their parents
+TEST_F(ProfilerTests, nestedZones)
+{
+  auto work = []()
+  {
+    for(int i = 0; i < 10; i++)
+    {
+      SO_PROFILE_ZONE("outer");
+      busy_wait_us(5);
+      {
+        SO_PROFILE_ZONE("inner");
+        busy_wait_us(20);
+      }
+      so::Profile_zone by_name("inner");
+    }
+  };
+  work();
+  std::thread other(work);
+  other.join();
+
+  std::vector<so::Profile_stats> stats = so::Profiler::Get_stats();
+  const so::Profile_stats* outer = find(stats, "outer");
+  const so::Profile_stats* inner = find(stats, "inner");
+  ASSERT_TRUE(outer);
+  ASSERT_TRUE(inner);
+  EXPECT_EQ(outer->count, 20u);
+  EXPECT_EQ(inner->count, 40u);
+  EXPECT_GE(inner->max_ns, 20000);
+  EXPECT_GE(outer->min_ns, 25000);
+  EXPECT_GE(outer->total_ns, inner->total_ns);
+  EXPECT_LE(inner->min_ns, inner->max_ns);
+  EXPECT_EQ(stats[0].name, "outer");
+  EXPECT_EQ(so::Profiler::Get_dropped(), 0u);
+}
+
+// The trace holds one complete event per zone, with its nesting depth
+TEST_F(ProfilerTests, chromeTrace)
+{
+  {
+    SO_PROFILE_ZONE("trace \"outer\"");
+    SO_PROFILE_ZONE("trace inner");
+  }
+  std::ostringstream ss;
+  so::Profiler::Write_chrome_trace(ss);
+  std::string trace = ss.str();
+  EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+  EXPECT_NE(trace.find("\"name\":\"trace \\\"outer\\\"\",\"ph\":\"X\""),
+            std::string::npos) << trace;
+  size_t inner = trace.find("\"name\":\"trace inner\"");
+  ASSERT_NE(inner, std::string::npos);
+  EXPECT_NE(trace.find("\"args\":{\"depth\":1}", inner), std::string::npos);
+  EXPECT_NE(trace.find("\"ph\":\"M\""), std::string::npos);
+  EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
+
+// Events beyond the buffer are dropped, but still counted in the statistics
+TEST_F(ProfilerTests, fullBuffer)
+{
+  so::Profiler::Set_buffer_size(4);
+  std::thread t([]()
+  {
+    for(int i = 0; i < 10; i++)
+    {
+      SO_PROFILE_ZONE("full");
+    }
+  });
+  t.join();
+  so::Profiler::Set_buffer_size(1 << 16);
+
+  EXPECT_EQ(so::Profiler::Get_dropped(), 6u);
+  std::vector<so::Profile_stats> stats = so::Profiler::Get_stats();
+  const so::Profile_stats* full = find(stats, "full");
+  ASSERT_TRUE(full);
+  EXPECT_EQ(full->count, 10u);
+}
+
+// A new thread takes over the buffer of one that has exited, keeping its
+// events
+TEST_F(ProfilerTests, reuseBuffer)
+{
+  so::Profiler::Set_buffer_size(5);
+  for(int t = 0; t < 2; t++)
+  {
+    std::thread thread([]()
+    {
+      for(int i = 0; i < 3; i++)
+      {
+        SO_PROFILE_ZONE("reuse");
+      }
+    });
+    thread.join();
+  }
+  so::Profiler::Set_buffer_size(1 << 16);
+
+  EXPECT_EQ(so::Profiler::Get_dropped(), 1u);
+  std::vector<so::Profile_stats> stats = so::Profiler::Get_stats();
+  const so::Profile_stats* reuse = find(stats, "reuse");
+  ASSERT_TRUE(reuse);
+  EXPECT_EQ(reuse->count, 6u);
+}
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <gtest/gtest.h>
+#include <sno/clock.h>
+#include <sno/rate_loop.h>
+#include <sno/so_exception.h>
+#include <sno/stopwatch.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+// A 500 Hz loop keeps its schedule and records the lateness of every wake-up
+TEST(RateLoopTests, fixedRate)
+{
+  for(so::Stopwatch::Clock_source source : {so::Stopwatch::Steady,
+                                            so::Stopwatch::Tsc})
+  {
+    so::Rate_loop loop(500.0, so::Rate_loop::Skip,
+                       std::chrono::microseconds(50), source);
+    EXPECT_EQ(loop.Get_period_ns(), 2000000);
+    so::Stopwatch sw;
+    sw.Start();
+    loop.Start();
+    for(int i = 0; i < 50; i++)
+    {
+      // Deadlines stay on the schedule however late the thread runs
+      loop.Wait();
+      EXPECT_EQ(loop.Get_deadline_ns() % 2000000, 0);
+    }
+    EXPECT_EQ(loop.Get_deadline_ns(),
+              2000000 * static_cast<int64_t>(50 + loop.Get_skipped_count()));
+    // Every deadline met was waited for in full
+    EXPECT_GE(loop.Get_jitter().Get_min(), 0);
+    EXPECT_GE(sw.Stop_ns(), 100000000 - 1000000);
+    EXPECT_EQ(loop.Get_iteration_count(), 50u);
+    EXPECT_EQ(loop.Get_jitter().Get_count() + loop.Get_overrun_count(), 50u);
+  }
+
+  so::Rate_loop loop(500.0);
+  loop.Wait();
+  loop.Reset_statistics();
+  EXPECT_EQ(loop.Get_iteration_count(), 0u);
+  EXPECT_EQ(loop.Get_jitter().Get_count(), 0u);
+
+  EXPECT_THROW(so::Rate_loop(0.0), so::Invalid_argument);
+  EXPECT_THROW(so::Rate_loop(100.0, so::Rate_loop::Skip,
+                             std::chrono::nanoseconds(-1)),
+               so::Invalid_argument);
+}
+
+// After a body takes 2.5 periods, Catch_up runs the missed iterations at once
+// and Skip drops them. A virtual clock makes the timings exact
+TEST(RateLoopTests, overrunPolicies)
+{
+  for(so::Rate_loop::Overrun_policy policy : {so::Rate_loop::Catch_up,
+                                              so::Rate_loop::Skip})
+  {
+    so::Virtual_clock clock;
+    so::Clock::Set_current(&clock);
+    so::Rate_loop loop(50.0, policy);
+    EXPECT_TRUE(loop.Wait());
+    int64_t first = loop.Get_deadline_ns();
+    clock.Advance_ns(first + 50000000);
+    EXPECT_FALSE(loop.Wait());
+    EXPECT_EQ(loop.Get_overrun_count(), 1u);
+    EXPECT_EQ(loop.Get_overruns().Get_count(), 1u);
+    EXPECT_GE(loop.Get_overruns().Get_max(), 10000000);
+
+    if(policy == so::Rate_loop::Catch_up)
+    {
+      EXPECT_EQ(loop.Get_deadline_ns(), first + 20000000);
+      EXPECT_FALSE(loop.Wait());
+      EXPECT_EQ(loop.Get_deadline_ns(), first + 40000000);
+      EXPECT_EQ(loop.Get_skipped_count(), 0u);
+    }
+    else
+    {
+      EXPECT_EQ(loop.Get_deadline_ns(), first + 60000000);
+      EXPECT_EQ(loop.Get_skipped_count(), 2u);
+    }
+    EXPECT_TRUE(loop.Wait());
+    EXPECT_EQ((loop.Get_deadline_ns() - first) % 20000000, 0);
+    so::Clock::Set_current(nullptr);
+  }
+}
@@ -1,13 +1,201 @@
+#include <cmath>
 #include <gtest/gtest.h>
 #include <sno/rotate.h>
 
 namespace
 {
 
+/**
+ * @brief Attitudes covering each axis, large angles and the neighbourhood of
+ * gimbal lock, one per column [roll, pitch, heading]
+ */
+Eigen::Matrix3Xd test_attitudes()
+{
+  Eigen::Matrix3Xd a(3, 9);
+  a << 0, 30, 0, 0, 179, -45, 10, -120, 33,
+       0, 0, 30, 0, -60, 89.999, -89.999, 45, 12,
+       0, 0, 0, 30, 359, 170, -10, -179, 271;
+  return a;
+}
+
 // Test no rotation in the body 2 earth class
 TEST(RotateTests, rotXNoRotation)
 {
+  Eigen::Vector3d p(1, 2, 3);
+  EXPECT_TRUE(so::Rotate::rot_x(0).isIdentity());
+  EXPECT_TRUE(so::Rotate::body_2_earth(p, Eigen::Vector3d::Zero()).isApprox(p));
+  EXPECT_TRUE(so::Rotate::earth_2_body(p, Eigen::Vector3d::Zero()).isApprox(p));
+}
+
+// Known transforms: nose north/east, right wing down
+TEST(RotateTests, knownValues)
+{
+  Eigen::Vector3d forward(1, 0, 0);
+  Eigen::Vector3d right(0, 1, 0);
+  EXPECT_TRUE(so::Rotate::body_2_earth(forward, Eigen::Vector3d(0, 0, 90))
+              .isApprox(Eigen::Vector3d(0, 1, 0), 1e-12));
+  EXPECT_TRUE(so::Rotate::body_2_earth(forward, Eigen::Vector3d(0, 30, 0))
+              .isApprox(Eigen::Vector3d(std::sqrt(3) / 2, 0, -0.5), 1e-12));
+  EXPECT_TRUE(so::Rotate::body_2_earth(right, Eigen::Vector3d(90, 0, 0))
+              .isApprox(Eigen::Vector3d(0, 0, 1), 1e-12));
+}
+
+// earth_2_body should undo body_2_earth for every path
+TEST(RotateTests, roundTrip)
+{
+  Eigen::Matrix3Xd attitudes = test_attitudes();
+  Eigen::Vector3d p(12.5, -3, 0.25);
+  for(Eigen::Index i = 0; i < attitudes.cols(); i++)
+  {
+    Eigen::Vector3d a = attitudes.col(i);
+    Eigen::Quaterniond q = so::Rotate::euler_2_quat(a);
+    EXPECT_TRUE(so::Rotate::earth_2_body(so::Rotate::body_2_earth(p, a), a)
+                .isApprox(p, 1e-12)) << a.transpose();
+    EXPECT_TRUE(so::Rotate::earth_2_body(so::Rotate::body_2_earth(p, q), q)
+                .isApprox(p, 1e-12)) << a.transpose();
+    EXPECT_TRUE(so::Rotate::body_2_earth(so::Rotate::earth_2_body(p, q), q)
+                .isApprox(p, 1e-12)) << a.transpose();
+  }
+}
+
+// All rotation paths should agree with the Euler angle matrix path
+TEST(RotateTests, pathsAgree)
+{
+  Eigen::Matrix3Xd attitudes = test_attitudes();
+  Eigen::Matrix3Xd points = Eigen::Matrix3Xd::Random(3, 16) * 100;
+  for(Eigen::Index i = 0; i < attitudes.cols(); i++)
+  {
+    Eigen::Vector3d a = attitudes.col(i);
+    Eigen::Quaterniond q = so::Rotate::euler_2_quat(a);
+    Eigen::Matrix3Xd batch = so::Rotate::body_2_earth(points, q);
+    Eigen::Matrix3Xd batch_inv = so::Rotate::earth_2_body(batch, q);
+    Eigen::Matrix3Xd dcm_path = so::Rotate::quat_2_dcm(
+          so::Rotate::dcm_2_quat(so::Rotate::quat_2_dcm(q))) * points;
+    for(Eigen::Index j = 0; j < points.cols(); j++)
+    {
+      Eigen::Vector3d p = points.col(j);
+      Eigen::Vector3d expected = so::Rotate::body_2_earth(p, a);
+      double x = p(0);
+      double y = p(1);
+      double z = p(2);
+      so::Rotate::body_2_earth(x, y, z, a(0), a(1), a(2));
+      EXPECT_TRUE(Eigen::Vector3d(x, y, z).isApprox(expected, 1e-12));
+      EXPECT_TRUE(so::Rotate::body_2_earth(p, q).isApprox(expected, 1e-12));
+      EXPECT_TRUE(Eigen::Vector3d(batch.col(j)).isApprox(expected, 1e-12));
+      EXPECT_TRUE(Eigen::Vector3d(dcm_path.col(j)).isApprox(expected, 1e-12));
+      EXPECT_TRUE(Eigen::Vector3d(batch_inv.col(j)).isApprox(p, 1e-12));
+    }
+  }
+}
+
+// Composing quaternions should match multiplying the matrices, and the
+// inverse should cancel
+TEST(RotateTests, quatCompose)
+{
+  Eigen::Matrix3Xd attitudes = test_attitudes();
+  for(Eigen::Index i = 1; i < attitudes.cols(); i++)
+  {
+    Eigen::Quaterniond q_ab = so::Rotate::euler_2_quat(
+          Eigen::Vector3d(attitudes.col(i - 1)));
+    Eigen::Quaterniond q_bc = so::Rotate::euler_2_quat(
+          Eigen::Vector3d(attitudes.col(i)));
+    Eigen::Quaterniond q_ac = so::Rotate::quat_compose(q_ab, q_bc);
+    EXPECT_TRUE(so::Rotate::quat_2_dcm(q_ac).isApprox(
+                  so::Rotate::quat_2_dcm(q_ab) * so::Rotate::quat_2_dcm(q_bc),
+                  1e-12));
+    EXPECT_TRUE(so::Rotate::quat_compose(q_ac, so::Rotate::quat_inverse(q_bc))
+                .isApprox(q_ab, 1e-12));
+  }
+}
+
+// Quaternion and Euler angle paths should produce the same transform
+TEST(RotateTests, quatMatchesEuler)
+{
+  Eigen::Vector3d attitude(10, -20, 135);
+  Eigen::Vector3d p(1, 2, 3);
+  Eigen::Quaterniond q = so::Rotate::euler_2_quat(attitude);
+
+  EXPECT_TRUE(so::Rotate::body_2_earth(p, q).isApprox(
+                so::Rotate::body_2_earth(p, attitude), 1e-12));
+  EXPECT_TRUE(so::Rotate::earth_2_body(p, q).isApprox(
+                so::Rotate::earth_2_body(p, attitude), 1e-12));
+  EXPECT_TRUE(so::Rotate::quat_2_euler(q).isApprox(attitude, 1e-12));
+  EXPECT_TRUE(so::Rotate::dcm_2_quat(so::Rotate::quat_2_dcm(q))
+              .isApprox(q, 1e-12));
+}
+
+// Batched conversions should match the single attitude conversions
+TEST(RotateTests, quatBatchMatchesSingle)
+{
+  Eigen::Matrix3Xd attitudes(3, 3);
+  attitudes << 0, 45, -170,
+               0, 30, 80,
+               0, -90, 10;
+  Eigen::Matrix3Xd points = Eigen::Matrix3Xd::Random(3, 3);
+  Eigen::Matrix4Xd q = so::Rotate::euler_2_quat(attitudes);
+  Eigen::Matrix3Xd earth = so::Rotate::body_2_earth(points, q);
+
+  for(Eigen::Index i = 0; i < attitudes.cols(); i++)
+  {
+    Eigen::Quaterniond qi = so::Rotate::euler_2_quat(
+          Eigen::Vector3d(attitudes.col(i)));
+    EXPECT_TRUE(Eigen::Vector4d(q.col(i)).isApprox(
+                  Eigen::Vector4d(qi.w(), qi.x(), qi.y(), qi.z()), 1e-12));
+    EXPECT_TRUE(Eigen::Vector3d(earth.col(i)).isApprox(
+                  so::Rotate::body_2_earth(Eigen::Vector3d(points.col(i)),
+                                           Eigen::Vector3d(attitudes.col(i))),
+                  1e-12));
+  }
+}
+
+// A quaternion that is not of unit length should give the same transform on
+// every path as its normalized form
+TEST(RotateTests, quatNormalizedOnEveryPath)
+{
+  Eigen::Vector3d attitude(10, -20, 135);
+  Eigen::Vector3d p(1, 2, 3);
+  Eigen::Quaterniond unit = so::Rotate::euler_2_quat(attitude);
+  Eigen::Quaterniond q(unit.coeffs() * 1.01);
+  Eigen::Matrix3Xd points = p;
+  Eigen::Matrix4Xd q_batch(4, 1);
+  q_batch << q.w(), q.x(), q.y(), q.z();
+
+  Eigen::Vector3d earth = so::Rotate::body_2_earth(p, attitude);
+  EXPECT_TRUE(so::Rotate::body_2_earth(p, q).isApprox(earth, 1e-12));
+  EXPECT_TRUE(Eigen::Vector3d(so::Rotate::body_2_earth(points, q))
+              .isApprox(earth, 1e-12));
+  EXPECT_TRUE(Eigen::Vector3d(so::Rotate::body_2_earth(points, q_batch))
+              .isApprox(earth, 1e-12));
+  EXPECT_TRUE((so::Rotate::quat_2_dcm(q) * p).isApprox(earth, 1e-12));
+
+  Eigen::Vector3d body = so::Rotate::earth_2_body(p, attitude);
+  EXPECT_TRUE(so::Rotate::earth_2_body(p, q).isApprox(body, 1e-12));
+  EXPECT_TRUE(Eigen::Vector3d(so::Rotate::earth_2_body(points, q))
+              .isApprox(body, 1e-12));
+  EXPECT_TRUE(so::Rotate::quat_2_euler(q).isApprox(attitude, 1e-12));
+}
+
+// Points held as separate coordinate arrays should transform as the same
+// points held as columns
+TEST(RotateTests, soaMatchesAos)
+{
+  Eigen::Quaterniond q = so::Rotate::euler_2_quat(Eigen::Vector3d(10, -20, 135));
+  Eigen::Matrix3Xd points = Eigen::Matrix3Xd::Random(3, 37);
+  Eigen::Matrix<double, Eigen::Dynamic, 3> soa = points.transpose();
+  Eigen::Matrix<double, Eigen::Dynamic, 3> earth(points.cols(), 3);
+  Eigen::Matrix<double, Eigen::Dynamic, 3> body(points.cols(), 3);
 
+  so::Rotate::body_2_earth(soa.col(0).data(), soa.col(1).data(),
+                           soa.col(2).data(), points.cols(), q,
+                           earth.col(0).data(), earth.col(1).data(),
+                           earth.col(2).data());
+  EXPECT_TRUE(earth.transpose().isApprox(so::Rotate::body_2_earth(points, q),
+                                         1e-12));
+  so::Rotate::earth_2_body(earth.col(0).data(), earth.col(1).data(),
+                           earth.col(2).data(), points.cols(), q,
+                           body.col(0).data(), body.col(1).data(),
+                           body.col(2).data());
+  EXPECT_TRUE(body.isApprox(soa, 1e-12));
 }
 
 }
@@ -0,0 +1,71 @@
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <sno/fast_stopwatch.h>
+#include <sno/stopwatch.h>
+#include <sno/tsc_clock.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Both clock sources measure a sleep to within a few milliseconds, in seconds
+// and in nanoseconds
+TEST(StopwatchTests, sources)
+{
+  for(so::Stopwatch::Clock_source source : {so::Stopwatch::Steady,
+                                            so::Stopwatch::Tsc})
+  {
+    so::Stopwatch sw(source);
+    EXPECT_EQ(sw.Split_ns(), 0);
+    sw.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int64_t split = sw.Split_ns();
+    EXPECT_GE(split, 20000000);
+    EXPECT_LT(split, 60000000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    double seconds = sw.Stop();
+    EXPECT_GE(seconds, 0.030);
+    EXPECT_LT(seconds, 0.090);
+    EXPECT_NEAR(sw.Get_time_ns() * 1e-9, seconds, 1e-9);
+    EXPECT_GE(sw.Get_time_ns() - split, 10000000);
+  }
+}
+
+// The calibrated counter keeps time with the steady clock
+TEST(StopwatchTests, tscCalibration)
+{
+  EXPECT_GT(so::Tsc_clock::Get_ticks_per_second(), 1e6);
+  auto steady_start = std::chrono::steady_clock::now();
+  int64_t start = so::Tsc_clock::Now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  int64_t ticks = so::Tsc_clock::Now_serialized() - start;
+  int64_t steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - steady_start).count();
+  EXPECT_NEAR(so::Tsc_clock::To_ns(ticks), steady_ns, steady_ns * 0.001 + 20000);
+  EXPECT_NEAR(so::Tsc_clock::To_seconds(ticks), steady_ns * 1e-9, 1e-4);
+
+  // Tick conversion rounds down and does not overflow on long intervals
+  EXPECT_EQ(so::Mul_q32(3, INT64_C(1) << 31), 1);
+  EXPECT_EQ(so::Mul_q32(-3, INT64_C(1) << 31), -2);
+  EXPECT_EQ(so::Mul_q32(INT64_C(1) << 50, INT64_C(3) << 31), INT64_C(3) << 49);
+}
+
+// The header-only stopwatches behave like the pimpl one and are plain values
+TEST(StopwatchTests, fastStopwatch)
+{
+  static_assert(sizeof(so::Fast_stopwatch) <= 4 * sizeof(int64_t),
+                "Fast_stopwatch should hold only its readings");
+  so::Fast_stopwatch steady;
+  so::Fast_tsc_stopwatch tsc;
+  EXPECT_EQ(steady.Split_ns(), 0);
+  steady.Start();
+  tsc.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  so::Fast_tsc_stopwatch copy = tsc;
+  int64_t split = steady.Split_ns();
+  EXPECT_GE(split, 20000000);
+  EXPECT_LT(split, 60000000);
+  EXPECT_GE(tsc.Stop_ns(), 20000000);
+  EXPECT_GE(copy.Get_time(), 0.020);
+  EXPECT_GE(steady.Stop(), 0.020);
+  EXPECT_EQ(tsc.Get_time_ns(), tsc.Get_time_ns());
+}
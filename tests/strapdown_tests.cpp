@@ -0,0 +1,116 @@
+#include <cmath>
+#include <gtest/gtest.h>
+#include <sno/strapdown.h>
+
+namespace
+{
+
+const double PI = 3.141592653589793;
+
+/**
+ * @brief Bessel function of the first kind of order one, from its series
+ */
+double bessel_j1(const double x)
+{
+  double term = x / 2;
+  double sum = term;
+  for(int k = 1; k < 20; k++)
+  {
+    term *= -(x / 2) * (x / 2) / (k * (k + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+// A constant yaw rate should turn the heading and leave a stationary,
+// level vehicle at rest
+TEST(StrapdownTests, constantYawRate)
+{
+  const double dt = 0.001;
+  const Eigen::Index n = 1000;
+  Eigen::Matrix3Xd gyro(3, n);
+  Eigen::Matrix3Xd accel(3, n);
+  gyro.colwise() = Eigen::Vector3d(0, 0, 3.141592653589793 / 4);
+  accel.colwise() = Eigen::Vector3d(0, 0, -9.80665);
+
+  so::Strapdown strapdown(Eigen::Vector3d(0, 0, 10));
+  strapdown.Integrate(gyro.leftCols(n / 2), accel.leftCols(n / 2), dt);
+  strapdown.Integrate(gyro.rightCols(n / 2), accel.rightCols(n / 2), dt);
+
+  Eigen::Vector3d attitude = strapdown.Get_attitude();
+  EXPECT_NEAR(attitude(0), 0, 1e-9);
+  EXPECT_NEAR(attitude(1), 0, 1e-9);
+  EXPECT_NEAR(attitude(2), 55, 1e-9);
+  EXPECT_NEAR(strapdown.Get_velocity().norm(), 0, 1e-9);
+}
+
+// Classic coning: the body z axis sweeps a cone of half angle beta at rate
+// w, with attitude q(t) = [cos(beta/2), sin(beta/2) cos(wt),
+// sin(beta/2) sin(wt), 0]. Its body rate is [-w sin(beta) sin(wt),
+// w sin(beta) cos(wt), -2 w sin^2(beta/2)], which integrates exactly into
+// the angle increments. Without the coning correction the attitude drifts
+// about z by more than a degree over this run
+TEST(StrapdownTests, coningMotion)
+{
+  const double beta = 10 * PI / 180;
+  const double w = 2 * PI * 5;
+  const double dt = 0.005;
+  const Eigen::Index n = 2000;
+  Eigen::Matrix3Xd delta_theta(3, n);
+  for(Eigen::Index i = 0; i < n; i++)
+  {
+    double t0 = i * dt;
+    double t1 = t0 + dt;
+    delta_theta.col(i) << std::sin(beta) * (std::cos(w * t1) - std::cos(w * t0)),
+                          std::sin(beta) * (std::sin(w * t1) - std::sin(w * t0)),
+                          -2 * w * std::pow(std::sin(beta / 2), 2) * dt;
+  }
+
+  so::Strapdown strapdown(Eigen::Vector3d(beta * 180 / PI, 0, 0),
+                          Eigen::Vector3d::Zero(),
+                          0);
+  strapdown.Integrate_increments(delta_theta, Eigen::Matrix3Xd::Zero(3, n), dt);
+
+  double t = n * dt;
+  Eigen::Quaterniond truth(std::cos(beta / 2),
+                           std::sin(beta / 2) * std::cos(w * t),
+                           std::sin(beta / 2) * std::sin(w * t),
+                           0);
+  EXPECT_LT(strapdown.Get_quaternion().angularDistance(truth), 5e-4);
+  EXPECT_NEAR(strapdown.Get_quaternion().norm(), 1, 1e-12);
+}
+
+// Classic sculling: roll oscillates as a sin(wt) while the body y specific
+// force is b sin(wt). Neither averages to anything on its own, but together
+// they rectify into a steady earth down velocity. Over whole periods the
+// down velocity is exactly b t J1(a) and the east velocity returns to zero.
+// Without the sculling correction the down velocity is 2 mm/s short
+TEST(StrapdownTests, scullingMotion)
+{
+  const double a = 0.1;
+  const double b = 1.0;
+  const double w = 2 * PI * 5;
+  const double dt = 0.005;
+  const Eigen::Index n = 2000;
+  Eigen::Matrix3Xd delta_theta(3, n);
+  Eigen::Matrix3Xd delta_v(3, n);
+  for(Eigen::Index i = 0; i < n; i++)
+  {
+    double t0 = i * dt;
+    double t1 = t0 + dt;
+    delta_theta.col(i) << a * (std::sin(w * t1) - std::sin(w * t0)), 0, 0;
+    delta_v.col(i) << 0, b / w * (std::cos(w * t0) - std::cos(w * t1)), 0;
+  }
+
+  so::Strapdown strapdown(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), 0);
+  strapdown.Integrate_increments(delta_theta, delta_v, dt);
+
+  double t = n * dt;
+  Eigen::Vector3d velocity = strapdown.Get_velocity();
+  EXPECT_NEAR(velocity(0), 0, 1e-12);
+  EXPECT_NEAR(velocity(1), 0, 1e-6);
+  EXPECT_NEAR(velocity(2), b * t * bessel_j1(a), 5e-5);
+  EXPECT_NEAR(strapdown.Get_attitude()(0), 0, 1e-9);
+}
+
+}
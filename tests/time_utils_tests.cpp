@@ -0,0 +1,71 @@
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <sno/time_utils.h>
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+int64_t system_clock_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // Anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Every function agrees with the system clock, with sub-second resolution
+TEST(TimeUtilsTests, unixTime)
+{
+  int64_t before = system_clock_ns();
+  double seconds = so::Time_utils::Unix_time();
+  int64_t us = so::Time_utils::Unix_time_us();
+  int64_t ns = so::Time_utils::Unix_time_ns();
+  int64_t after = system_clock_ns();
+
+  EXPECT_GE(seconds, before * 1e-9 - 1e-6);
+  EXPECT_LE(seconds, after * 1e-9 + 1e-6);
+  EXPECT_GE(us, before / 1000);
+  EXPECT_LE(us, after / 1000);
+  EXPECT_GE(ns, before);
+  EXPECT_LE(ns, after);
+
+  // Successive calls a millisecond apart differ by about a millisecond
+  double first = so::Time_utils::Unix_time();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  double second = so::Time_utils::Unix_time();
+  EXPECT_GT(second - first, 0.0009);
+  EXPECT_LT(second - first, 0.1);
+}
+
+// The cached clock follows the real clock to within its period and falls
+// back to reading the clock once stopped
+TEST(TimeUtilsTests, cachedTime)
+{
+  so::Time_utils::Start_cached_time(std::chrono::microseconds(200));
+  int64_t start = so::Time_utils::Cached_unix_time_ns();
+  EXPECT_NEAR(start, so::Time_utils::Unix_time_ns(), 50000000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  int64_t later = so::Time_utils::Cached_unix_time_ns();
+  EXPECT_GT(later, start);
+  EXPECT_NEAR(later, so::Time_utils::Unix_time_ns(), 50000000);
+  EXPECT_EQ(so::Time_utils::Cached_unix_time_us() / 1000,
+            so::Time_utils::Cached_time_value().load() / 1000000);
+
+  // Restarting only changes the period
+  so::Time_utils::Start_cached_time(std::chrono::microseconds(100));
+  so::Time_utils::Stop_cached_time();
+  EXPECT_EQ(so::Time_utils::Cached_time_value().load(), 0);
+  int64_t before = so::Time_utils::Unix_time_ns();
+  int64_t direct = so::Time_utils::Cached_unix_time_ns();
+  EXPECT_GE(direct, before);
+  EXPECT_LE(direct, so::Time_utils::Unix_time_ns());
+
+  so::Time_utils::Start_cached_time();
+  EXPECT_NE(so::Time_utils::Cached_time_value().load(), 0);
+  so::Time_utils::Stop_cached_time();
+}
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sno/transform_graph.h>
+
+namespace
+{
+
+/**
+ * @brief Graph with sensor->body (static), body->earth (dynamic) and
+ * earth->map (static) edges, plus a second sensor on the body
+ */
+so::Transform_graph make_graph(so::Transform_graph::Edge_id& body_edge)
+{
+  so::Transform_graph graph;
+  graph.Add_static_edge("sensor", "body",
+                        so::Rigid_transform(Eigen::Vector3d(0, -90, 0),
+                                            Eigen::Vector3d(1, 0, 0.5)));
+  graph.Add_static_edge("sensor2", "body",
+                        so::Rigid_transform(Eigen::Vector3d(0, 0, 180)));
+  body_edge = graph.Add_dynamic_edge("body", "earth");
+  graph.Add_static_edge("earth", "map",
+                        so::Rigid_transform(Eigen::Vector3d(0, 0, 45),
+                                            Eigen::Vector3d(100, 200, 0)));
+  return graph;
+}
+
+// Chains should match composing the edges by hand, before and after updates
+TEST(TransformGraphTests, composition)
+{
+  so::Transform_graph::Edge_id body_edge;
+  so::Transform_graph graph = make_graph(body_edge);
+  so::Transform_graph::Chain_id sensor_map = graph.Add_chain("sensor", "map");
+  so::Transform_graph::Chain_id map_sensor = graph.Add_chain("map", "sensor");
+  so::Transform_graph::Chain_id sensors = graph.Add_chain("sensor", "sensor2");
+
+  so::Rigid_transform sensor_body(Eigen::Vector3d(0, -90, 0),
+                                  Eigen::Vector3d(1, 0, 0.5));
+  so::Rigid_transform sensor2_body(Eigen::Vector3d(0, 0, 180));
+  so::Rigid_transform earth_map(Eigen::Vector3d(0, 0, 45),
+                                Eigen::Vector3d(100, 200, 0));
+  Eigen::Vector3d p(3, -4, 5);
+
+  for(double heading : {0.0, 30.0, 30.0, -100.0})
+  {
+    so::Rigid_transform body_earth(Eigen::Vector3d(5, 2, heading),
+                                   Eigen::Vector3d(10, 20, -30));
+    graph.Update_edge(body_edge, body_earth);
+
+    Eigen::Vector3d expected = earth_map.Apply(body_earth.Apply(
+                                                 sensor_body.Apply(p)));
+    EXPECT_TRUE(graph.Lookup(sensor_map).Apply(p).isApprox(expected, 1e-12));
+    // Second lookup is served from the cache
+    EXPECT_TRUE(graph.Lookup(sensor_map).Apply(p).isApprox(expected, 1e-12));
+    EXPECT_TRUE(graph.Lookup(map_sensor).Apply(expected).isApprox(p, 1e-12));
+  }
+  EXPECT_TRUE(graph.Lookup(sensors).Apply(p).isApprox(
+                sensor2_body.Inverse().Apply(sensor_body.Apply(p)), 1e-12));
+}
+
+// Invalid topology and handles should throw
+TEST(TransformGraphTests, invalidEdges)
+{
+  so::Transform_graph::Edge_id body_edge;
+  so::Transform_graph graph = make_graph(body_edge);
+  graph.Add_static_edge("a", "b", so::Rigid_transform());
+  EXPECT_ANY_THROW(graph.Add_static_edge("sensor", "map", so::Rigid_transform()));
+  EXPECT_ANY_THROW(graph.Add_dynamic_edge("map", "sensor"));
+  EXPECT_ANY_THROW(graph.Add_chain("sensor", "a"));
+  EXPECT_ANY_THROW(graph.Add_chain("sensor", "missing"));
+  EXPECT_ANY_THROW(graph.Lookup(5));
+}
+
+// Readers running alongside a writer should always see a valid transform
+TEST(TransformGraphTests, concurrentLookup)
+{
+  so::Transform_graph::Edge_id body_edge;
+  so::Transform_graph graph = make_graph(body_edge);
+  so::Transform_graph::Chain_id chain = graph.Add_chain("sensor", "earth");
+  std::atomic<bool> done(false);
+  std::atomic<size_t> bad(0);
+
+  std::vector<std::thread> readers;
+  for(int i = 0; i < 4; i++)
+  {
+    readers.emplace_back([&]()
+    {
+      while(!done)
+      {
+        // Body is only ever translated along z, so x should stay at 1
+        so::Rigid_transform t = graph.Lookup(chain);
+        if(std::abs(t.Get_translation()(0) - 1) > 1e-9)
+        {
+          bad++;
+        }
+      }
+    });
+  }
+  for(int i = 0; i < 20000; i++)
+  {
+    graph.Update_edge(body_edge,
+                      so::Rigid_transform(Eigen::Quaterniond::Identity(),
+                                          Eigen::Vector3d(0, 0, i)));
+  }
+  done = true;
+  for(std::thread& t : readers)
+  {
+    t.join();
+  }
+  EXPECT_EQ(bad, 0u);
+}
+
+}
@@ -0,0 +1,44 @@
+/**
+ * Convert a binary log written by so::Basic_logger::Set_binary_file() to
+ * text. Usage: sno_log_decode <binary log> [output file]
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sno/binary_log.h>
+#include <sno/so_exception.h>
+
+int main(int argc, char** argv)
+{
+  if(argc < 2 || argc > 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <binary log> [output file]"
+              << std::endl;
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios_base::binary);
+  if(!in)
+  {
+    std::cerr << "Could not open '" << argv[1] << "'" << std::endl;
+    return 1;
+  }
+
+  try
+  {
+    if(argc == 3)
+    {
+      std::ofstream out(argv[2]);
+      so::Binary_log::Decode(in, out);
+    }
+    else
+    {
+      so::Binary_log::Decode(in, std::cout);
+    }
+  }catch(const so::Exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}